@@ -0,0 +1,478 @@
+#include "./BuildMapBenchmark.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <unordered_map>
+
+#include <MapProjection.h>
+#include <GeoCoordinate.h>
+#include <Projections.h>
+
+#include "../DEMData.h"
+#include "../VFS/VFS.h"
+
+//result of measured loops is written here, so compiler can not remove them
+static volatile double benchmarkSink = 0;
+
+#ifdef BUILD_MAP_BENCHMARK_COUNT_ALLOCS
+
+static std::atomic<uint64_t> allocationsCount(0);
+
+void * operator new(size_t size)
+{
+	allocationsCount++;
+	void * p = malloc((size == 0) ? 1 : size);
+	if (p == nullptr)
+	{
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void * operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void * p) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void * p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void * p, size_t) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void * p, size_t) noexcept
+{
+	free(p);
+}
+
+#endif
+
+/// <summary>
+/// ctor
+/// </summary>
+/// <param name="settings">benchmark settings</param>
+BuildMapBenchmark::BuildMapBenchmark(const BuildMapBenchmarkSettings & settings) :
+	settings(settings)
+{
+	if (this->settings.workDir.GetLastChar() != '/')
+	{
+		this->settings.workDir += '/';
+	}
+
+	if (this->settings.repeats < 1)
+	{
+		this->settings.repeats = 1;
+	}
+
+	this->settings.dataset.outputDir = this->settings.workDir;
+	this->settings.dataset.zipMode = SyntheticDEMSettings::NONE;
+}
+
+/// <summary>
+/// Generate dataset and run all cases for all
+/// height types and projections
+/// </summary>
+/// <returns>results of all cases</returns>
+std::vector<BuildMapBenchmarkResult> BuildMapBenchmark::Run()
+{
+	std::vector<BuildMapBenchmarkResult> results;
+
+	SyntheticDEM dem(this->settings.dataset);
+	if (dem.Generate().empty())
+	{
+		printf("Failed to generate dataset in %s\n", this->settings.workDir.c_str());
+		return results;
+	}
+
+	if ((this->settings.hardwareCounters) && (PerfCounters::GetThreadInstance().IsAvailable() == false))
+	{
+		printf("Hardware performance counters are not available, only time is measured\n");
+	}
+
+	this->RunType<uint8_t, Projections::Equirectangular>("uint8", "equirectangular", results);
+	this->RunType<uint16_t, Projections::Equirectangular>("uint16", "equirectangular", results);
+	this->RunType<short, Projections::Equirectangular>("short", "equirectangular", results);
+
+	this->RunType<uint8_t, Projections::Mercator>("uint8", "mercator", results);
+	this->RunType<uint16_t, Projections::Mercator>("uint16", "mercator", results);
+	this->RunType<short, Projections::Mercator>("short", "mercator", results);
+
+	VFS::Destroy();
+
+	return results;
+}
+
+/// <summary>
+/// Run all cases for single DEMData type
+/// </summary>
+/// <param name="heightName">name of height type</param>
+/// <param name="projName">name of projection</param>
+/// <param name="results">output results</param>
+template <typename HeightType, typename ProjType>
+void BuildMapBenchmark::RunType(const char * heightName, const char * projName,
+	std::vector<BuildMapBenchmarkResult> & results)
+{
+	//DEMData re-initializes VFS singleton
+	VFS::Destroy();
+
+	MyStringAnsi dir = this->settings.workDir.SubString(0, this->settings.workDir.length() - 1);
+	DEMData<HeightType, ProjType> data({ dir });
+
+	const SyntheticDEMSettings & ds = this->settings.dataset;
+
+	Projections::Coordinate min, max;
+	min.lat = GeoCoordinate::deg(ds.minLat);
+	min.lon = GeoCoordinate::deg(ds.minLon);
+	max.lat = GeoCoordinate::deg(ds.maxLat);
+	max.lon = GeoCoordinate::deg(ds.maxLon);
+
+	DEMRequestContext<ProjType> ctx;
+
+	for (int size : this->settings.sizes)
+	{
+		printf("%s / %s / %dx%d\n", heightName, projName, size, size);
+
+		ctx.projection->SetFrame(min, max, size, size, false);
+
+		results.push_back(this->Measure("projection", heightName, projName, size, [&]() {
+			double sum = 0;
+			for (int y = 0; y < size; y++)
+			{
+				for (int x = 0; x < size; x++)
+				{
+					sum += ctx.projection->ProjectInverse({ x, y }).lat.rad();
+				}
+			}
+			benchmarkSink = sum;
+		}));
+
+		data.CreatePixelsPlan(ctx, size, size);
+
+		results.push_back(this->Measure("get_tile", heightName, projName, size, [&]() {
+			size_t found = 0;
+			for (const Projections::Coordinate & c : ctx.coords)
+			{
+				found += (data.GetTile(c) != nullptr) ? 1 : 0;
+			}
+			benchmarkSink = static_cast<double>(found);
+		}));
+
+		results.push_back(this->Measure("plan", heightName, projName, size, [&]() {
+			data.CreatePixelsPlan(ctx, size, size);
+		}));
+
+		//all tiles of frame are loaded before the case, only sampling is measured
+		std::vector<DEMTileData> tilesData;
+		tilesData.reserve(ctx.tilePixels.size());
+		for (auto & it : ctx.tilePixels)
+		{
+			tilesData.emplace_back(data.tilesCache, data.tilesPool.get());
+			tilesData.back().SetTileInfo(it.first);
+			tilesData.back().LoadTileData();
+		}
+
+		results.push_back(this->Measure("get_value", heightName, projName, size, [&]() {
+			double sum = 0;
+			size_t t = 0;
+			for (auto & it : ctx.tilePixels)
+			{
+				DEMTileData & td = tilesData[t++];
+				for (size_t index : it.second)
+				{
+					sum += td.GetValue(ctx.coords[index]);
+				}
+			}
+			benchmarkSink = sum;
+		}));
+
+		for (DEMTileData & td : tilesData)
+		{
+			td.ReleaseData();
+		}
+		tilesData.clear();
+
+		results.push_back(this->Measure("build_map", heightName, projName, size, [&]() {
+			HeightType * heightMap = data.BuildMap(size, size, min, max, false);
+			benchmarkSink = (heightMap) ? heightMap[0] : 0;
+			delete[] heightMap;
+		}));
+	}
+}
+
+/// <summary>
+/// Run case repeatedly and measure the fastest run
+/// </summary>
+/// <param name="benchCase">case name</param>
+/// <param name="heightName">name of height type</param>
+/// <param name="projName">name of projection</param>
+/// <param name="size">size of frame</param>
+/// <param name="run">single run of case (one frame)</param>
+/// <returns>case result</returns>
+BuildMapBenchmarkResult BuildMapBenchmark::Measure(const char * benchCase, const char * heightName, const char * projName,
+	int size, std::function<void()> run)
+{
+	double bestTime = 0;
+	uint64_t allocs = 0;
+	PerfCounterValues bestHw;
+
+	PerfCounters & counters = PerfCounters::GetThreadInstance();
+
+	for (int i = 0; i < this->settings.repeats; i++)
+	{
+		PerfCounterValues hwStart;
+		if (this->settings.hardwareCounters)
+		{
+			hwStart = counters.ReadValues();
+		}
+
+		uint64_t allocsStart = GetAllocationsCount();
+		auto start = std::chrono::steady_clock::now();
+
+		run();
+
+		auto end = std::chrono::steady_clock::now();
+		allocs += GetAllocationsCount() - allocsStart;
+
+		PerfCounterValues hw;
+		if (this->settings.hardwareCounters)
+		{
+			hw = counters.ReadValues().Sub(hwStart);
+		}
+
+		double t = std::chrono::duration<double>(end - start).count();
+		if ((i == 0) || (t < bestTime))
+		{
+			bestTime = t;
+			bestHw = hw;
+		}
+	}
+
+	BuildMapBenchmarkResult r;
+	r.benchCase = benchCase;
+	r.heightType = heightName;
+	r.projection = projName;
+	r.size = size;
+	r.hw = bestHw;
+	r.pixelsPerSec = (bestTime > 0) ? (static_cast<double>(size) * size) / bestTime : 0;
+
+#ifdef BUILD_MAP_BENCHMARK_COUNT_ALLOCS
+	r.allocsPerFrame = static_cast<double>(allocs) / this->settings.repeats;
+#else
+	r.allocsPerFrame = -1;
+#endif
+
+	return r;
+}
+
+uint64_t BuildMapBenchmark::GetAllocationsCount()
+{
+#ifdef BUILD_MAP_BENCHMARK_COUNT_ALLOCS
+	return allocationsCount.load();
+#else
+	return 0;
+#endif
+}
+
+/// <summary>
+/// Print results, hardware counters are printed per pixel
+/// </summary>
+/// <param name="results">benchmark results</param>
+void BuildMapBenchmark::PrintResults(const std::vector<BuildMapBenchmarkResult> & results)
+{
+	printf("%-12s %-8s %-16s %6s %14s %14s %8s %10s %10s %10s %10s\n",
+		"case", "height", "projection", "size", "Mpixels/s", "allocs/frame",
+		"IPC", "cycles/px", "LLC/px", "dTLB/px", "br.miss/px");
+
+	for (const auto & r : results)
+	{
+		printf("%-12s %-8s %-16s %6d %14.2f %14.1f",
+			r.benchCase.c_str(), r.heightType.c_str(), r.projection.c_str(), r.size,
+			r.pixelsPerSec / 1000000.0, r.allocsPerFrame);
+
+		if (r.hw.IsAvailable())
+		{
+			double pixels = static_cast<double>(r.size) * r.size;
+			printf(" %8.2f %10.2f %10.4f %10.4f %10.4f",
+				r.hw.GetIPC(),
+				r.hw.values[PerfCounterValues::CYCLES] / pixels,
+				r.hw.values[PerfCounterValues::LLC_MISSES] / pixels,
+				r.hw.values[PerfCounterValues::DTLB_MISSES] / pixels,
+				r.hw.values[PerfCounterValues::BRANCH_MISSES] / pixels);
+		}
+		printf("\n");
+	}
+}
+
+bool BuildMapBenchmark::SaveCSV(const std::vector<BuildMapBenchmarkResult> & results, const MyStringAnsi & fileName)
+{
+	FILE * f = nullptr;
+	my_fopen(&f, fileName.c_str(), "w");
+	if (f == nullptr)
+	{
+		printf("Failed to open file %s\n", fileName.c_str());
+		return false;
+	}
+
+	fprintf(f, "case;height_type;projection;size;pixels_per_sec;allocs_per_frame");
+	for (int i = 0; i < PerfCounterValues::EVENTS_COUNT; i++)
+	{
+		fprintf(f, ";%s", PerfCounterValues::GetName(static_cast<PerfCounterValues::EVENT>(i)));
+	}
+	fprintf(f, "\n");
+
+	for (const auto & r : results)
+	{
+		fprintf(f, "%s;%s;%s;%d;%f;%f",
+			r.benchCase.c_str(), r.heightType.c_str(), r.projection.c_str(), r.size,
+			r.pixelsPerSec, r.allocsPerFrame);
+
+		//not available counters are stored as -1
+		for (int i = 0; i < PerfCounterValues::EVENTS_COUNT; i++)
+		{
+			fprintf(f, ";%lld", (r.hw.available[i]) ? static_cast<long long>(r.hw.values[i]) : -1LL);
+		}
+		fprintf(f, "\n");
+	}
+
+	fclose(f);
+	return true;
+}
+
+/// <summary>
+/// Load results saved with SaveCSV
+/// </summary>
+/// <param name="fileName">CSV file</param>
+/// <returns>loaded results (empty if file can not be read)</returns>
+std::vector<BuildMapBenchmarkResult> BuildMapBenchmark::LoadCSV(const MyStringAnsi & fileName)
+{
+	std::vector<BuildMapBenchmarkResult> results;
+
+	FILE * f = nullptr;
+	my_fopen(&f, fileName.c_str(), "r");
+	if (f == nullptr)
+	{
+		printf("Failed to open file %s\n", fileName.c_str());
+		return results;
+	}
+
+	char line[512];
+
+	//header
+	if (fgets(line, sizeof(line), f) == nullptr)
+	{
+		fclose(f);
+		return results;
+	}
+
+	while (fgets(line, sizeof(line), f))
+	{
+		char benchCase[64];
+		char heightType[64];
+		char projection[64];
+		BuildMapBenchmarkResult r;
+
+		if (sscanf(line, "%63[^;];%63[^;];%63[^;];%d;%lf;%lf",
+			benchCase, heightType, projection, &r.size, &r.pixelsPerSec, &r.allocsPerFrame) != 6)
+		{
+			continue;
+		}
+
+		r.benchCase = benchCase;
+		r.heightType = heightType;
+		r.projection = projection;
+
+		//hardware counters are optional (older baselines do not have them)
+		long long hw[PerfCounterValues::EVENTS_COUNT];
+		if (sscanf(line, "%*[^;];%*[^;];%*[^;];%*d;%*f;%*f;%lld;%lld;%lld;%lld;%lld",
+			&hw[0], &hw[1], &hw[2], &hw[3], &hw[4]) == PerfCounterValues::EVENTS_COUNT)
+		{
+			for (int i = 0; i < PerfCounterValues::EVENTS_COUNT; i++)
+			{
+				r.hw.available[i] = (hw[i] >= 0);
+				r.hw.values[i] = (hw[i] >= 0) ? static_cast<uint64_t>(hw[i]) : 0;
+			}
+		}
+
+		results.push_back(r);
+	}
+
+	fclose(f);
+	return results;
+}
+
+/// <summary>
+/// Print relative change of results against baseline.
+/// Case is regression if its throughput dropped by more than threshold
+/// or if it allocates more per frame than in baseline
+/// </summary>
+/// <param name="results">current results</param>
+/// <param name="baseline">stored results (LoadCSV)</param>
+/// <param name="threshold">allowed relative slowdown (0.1 = 10%)</param>
+/// <returns>number of regressions</returns>
+int BuildMapBenchmark::CompareBaseline(const std::vector<BuildMapBenchmarkResult> & results,
+	const std::vector<BuildMapBenchmarkResult> & baseline, double threshold)
+{
+	auto getKey = [](const BuildMapBenchmarkResult & r) -> std::string {
+		char key[256];
+		snprintf(key, sizeof(key), "%s/%s/%s/%d",
+			r.benchCase.c_str(), r.heightType.c_str(), r.projection.c_str(), r.size);
+		return key;
+	};
+
+	std::unordered_map<std::string, const BuildMapBenchmarkResult *> base;
+	for (const auto & r : baseline)
+	{
+		base[getKey(r)] = &r;
+	}
+
+	int regressions = 0;
+
+	printf("%-44s %12s %12s %9s %14s\n", "case", "base Mpx/s", "Mpx/s", "change", "allocs");
+	for (const auto & r : results)
+	{
+		std::string key = getKey(r);
+
+		auto it = base.find(key);
+		if (it == base.end())
+		{
+			printf("%-44s %12s %12.2f %9s\n", key.c_str(), "-", r.pixelsPerSec / 1000000.0, "new");
+			continue;
+		}
+
+		const BuildMapBenchmarkResult * b = it->second;
+		double change = (b->pixelsPerSec > 0) ? (r.pixelsPerSec - b->pixelsPerSec) / b->pixelsPerSec : 0;
+
+		bool slower = (change < -threshold);
+		bool moreAllocs = (r.allocsPerFrame >= 0) && (b->allocsPerFrame >= 0) &&
+			(r.allocsPerFrame > b->allocsPerFrame);
+
+		printf("%-44s %12.2f %12.2f %+8.1f%% %6.0f -> %-6.0f%s\n", key.c_str(),
+			b->pixelsPerSec / 1000000.0, r.pixelsPerSec / 1000000.0, change * 100.0,
+			b->allocsPerFrame, r.allocsPerFrame,
+			(slower || moreAllocs) ? " REGRESSION" : "");
+
+		if (slower || moreAllocs)
+		{
+			regressions++;
+		}
+	}
+
+	printf("Regressions: %d\n", regressions);
+
+	return regressions;
+}
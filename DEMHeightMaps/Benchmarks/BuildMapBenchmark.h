@@ -0,0 +1,93 @@
+#ifndef BUILD_MAP_BENCHMARK_H
+#define BUILD_MAP_BENCHMARK_H
+
+#include <cstdint>
+#include <vector>
+#include <functional>
+
+#include "./SyntheticDEM.h"
+#include "../Utils/PerfCounters.h"
+#include "../Strings/MyString.h"
+
+//Define to count heap allocations (replaces global operator new / delete
+//in BuildMapBenchmark.cpp). Without it, allocations are reported as -1
+//#define BUILD_MAP_BENCHMARK_COUNT_ALLOCS
+
+/// <summary>
+/// Benchmark settings
+/// </summary>
+typedef struct BuildMapBenchmarkSettings
+{
+	MyStringAnsi workDir;			//directory with generated dataset
+	SyntheticDEMSettings dataset;	//generated tiles (outputDir is set to workDir)
+	std::vector<int> sizes;			//square output sizes
+	int repeats;					//each case is run repeats times, the fastest run is reported
+	bool hardwareCounters;			//read PerfCounters of benchmark thread in each run
+
+	BuildMapBenchmarkSettings() :
+		workDir("./build_map_benchmark/"),
+		sizes({ 64, 256, 1024, 4096, 8192 }),
+		repeats(3),
+		hardwareCounters(false)
+	{
+		dataset.minLat = 10;
+		dataset.maxLat = 14;
+		dataset.minLon = 10;
+		dataset.maxLon = 14;
+	}
+
+} BuildMapBenchmarkSettings;
+
+/// <summary>
+/// Result of single case
+/// </summary>
+typedef struct BuildMapBenchmarkResult
+{
+	MyStringAnsi benchCase;		//projection, get_tile, plan, get_value, build_map
+	MyStringAnsi heightType;
+	MyStringAnsi projection;
+	int size;
+
+	double pixelsPerSec;
+	double allocsPerFrame;		//heap allocations per single run, -1 if not counted
+	PerfCounterValues hw;		//hardware counters of the fastest run (benchmark thread only)
+
+} BuildMapBenchmarkResult;
+
+/// <summary>
+/// Benchmark of BuildMap and of its individual steps:
+/// inverse projection, GetTile lookup, plan construction (coords + tilePixels),
+/// per-sample DEMTileData::GetValue and end-to-end BuildMap.
+/// All cases run for every size, both projections and all height types
+/// on synthetic tiles (SyntheticDEM) covering the whole frame.
+///
+/// Results can be saved as CSV and later used as baseline -
+/// CompareBaseline prints relative change of each case and reports regressions
+/// </summary>
+class BuildMapBenchmark
+{
+public:
+	BuildMapBenchmark(const BuildMapBenchmarkSettings & settings);
+	~BuildMapBenchmark() = default;
+
+	std::vector<BuildMapBenchmarkResult> Run();
+
+	static void PrintResults(const std::vector<BuildMapBenchmarkResult> & results);
+	static bool SaveCSV(const std::vector<BuildMapBenchmarkResult> & results, const MyStringAnsi & fileName);
+	static std::vector<BuildMapBenchmarkResult> LoadCSV(const MyStringAnsi & fileName);
+	static int CompareBaseline(const std::vector<BuildMapBenchmarkResult> & results,
+		const std::vector<BuildMapBenchmarkResult> & baseline, double threshold = 0.1);
+
+private:
+	BuildMapBenchmarkSettings settings;
+
+	template <typename HeightType, typename ProjType>
+	void RunType(const char * heightName, const char * projName, std::vector<BuildMapBenchmarkResult> & results);
+
+	BuildMapBenchmarkResult Measure(const char * benchCase, const char * heightName, const char * projName,
+		int size, std::function<void()> run);
+
+	static uint64_t GetAllocationsCount();
+};
+
+#endif
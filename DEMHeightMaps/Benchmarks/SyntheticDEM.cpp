@@ -0,0 +1,327 @@
+#include "./SyntheticDEM.h"
+
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+#include "../VFS/VFS.h"
+#include "../VFS/minizip/zip.h"
+
+#ifdef _WIN32
+	#include <direct.h>
+#else
+	#include <sys/stat.h>
+#endif
+
+/// <summary>
+/// Add single file to opened zip archive
+/// </summary>
+/// <param name="zf">opened archive</param>
+/// <param name="name">file name in archive</param>
+/// <param name="data">file data</param>
+/// <param name="deflate">compress data, otherwise they are stored</param>
+/// <returns>true if file was added</returns>
+static bool AddZipEntry(zipFile zf, const MyStringAnsi & name, const std::vector<uint8_t> & data, bool deflate)
+{
+	zip_fileinfo zi;
+	memset(&zi, 0, sizeof(zip_fileinfo));
+
+	bool ok = (zipOpenNewFileInZip(zf, name.c_str(), &zi, NULL, 0, NULL, 0, NULL,
+		(deflate) ? Z_DEFLATED : 0, (deflate) ? Z_DEFAULT_COMPRESSION : 0) == ZIP_OK);
+	ok = ok && (zipWriteInFileInZip(zf, data.data(), static_cast<unsigned>(data.size())) == ZIP_OK);
+	zipCloseFileInZip(zf);
+
+	return ok;
+}
+
+/// <summary>
+/// ctor
+/// </summary>
+/// <param name="settings">dataset settings</param>
+SyntheticDEM::SyntheticDEM(const SyntheticDEMSettings & settings) :
+	settings(settings)
+{
+	if (this->settings.outputDir.GetLastChar() != '/')
+	{
+		this->settings.outputDir += '/';
+	}
+}
+
+/// <summary>
+/// Create directory including all its parents
+/// </summary>
+/// <param name="path">directory path</param>
+void SyntheticDEM::CreatePath(const MyStringAnsi & path)
+{
+	for (size_t i = 1; i <= path.length(); i++)
+	{
+		if ((i < path.length()) && ((path[i] != '/') || (path[i - 1] == ':')))
+		{
+			continue;
+		}
+
+		MyStringAnsi dir = path.SubString(0, i);
+#ifdef _WIN32
+		_mkdir(dir.c_str());
+#else
+		mkdir(dir.c_str(), 0777);
+#endif
+	}
+}
+
+/// <summary>
+/// Write all tiles of region to output directory
+/// </summary>
+/// <returns>OS paths of all written files</returns>
+std::vector<MyStringAnsi> SyntheticDEM::Generate()
+{
+	std::vector<MyStringAnsi> files;
+
+	CreatePath(this->settings.outputDir);
+
+	zipFile archive = nullptr;
+	if (this->settings.zipMode == SyntheticDEMSettings::SINGLE_ARCHIVE)
+	{
+		MyStringAnsi fileName = this->settings.outputDir;
+		fileName += "tiles.zip";
+
+		archive = zipOpen(fileName.c_str(), APPEND_STATUS_CREATE);
+		if (archive == nullptr)
+		{
+			printf("Failed to create archive %s\n", fileName.c_str());
+			return files;
+		}
+		files.push_back(fileName);
+	}
+
+	for (int lat = this->settings.minLat; lat < this->settings.maxLat; lat++)
+	{
+		for (int lon = this->settings.minLon; lon < this->settings.maxLon; lon++)
+		{
+			if (this->IsTileCovered(lat, lon) == false)
+			{
+				continue;
+			}
+
+			MyStringAnsi name = this->GetTileName(lat, lon);
+			std::vector<uint8_t> data = this->CreateTileData(lat, lon);
+
+			if (archive != nullptr)
+			{
+				if (AddZipEntry(archive, name, data, this->settings.zipDeflate) == false)
+				{
+					printf("Failed to add %s to archive\n", name.c_str());
+				}
+				continue;
+			}
+
+			MyStringAnsi fileName = this->settings.outputDir;
+			fileName += name;
+
+			if (this->settings.zipMode == SyntheticDEMSettings::PER_TILE)
+			{
+				fileName += ".zip";
+
+				zipFile zf = zipOpen(fileName.c_str(), APPEND_STATUS_CREATE);
+				bool ok = (zf != nullptr) && (AddZipEntry(zf, name, data, this->settings.zipDeflate));
+				if (zf != nullptr)
+				{
+					zipClose(zf, NULL);
+				}
+
+				if (ok == false)
+				{
+					printf("Failed to create archive %s\n", fileName.c_str());
+					continue;
+				}
+			}
+			else
+			{
+				FILE * f = nullptr;
+				my_fopen(&f, fileName.c_str(), "wb");
+				if (f == nullptr)
+				{
+					printf("Failed to open file %s\n", fileName.c_str());
+					continue;
+				}
+				fwrite(data.data(), sizeof(uint8_t), data.size(), f);
+				fclose(f);
+			}
+
+			files.push_back(fileName);
+		}
+	}
+
+	if (archive != nullptr)
+	{
+		zipClose(archive, NULL);
+	}
+
+	return files;
+}
+
+/// <summary>
+/// Test if tile is part of dataset (deterministic for given seed and coverage)
+/// </summary>
+/// <param name="lat">latitude of SW corner</param>
+/// <param name="lon">longitude of SW corner</param>
+/// <returns>true if tile is generated</returns>
+bool SyntheticDEM::IsTileCovered(int lat, int lon) const
+{
+	if (this->settings.coverage >= 1.0)
+	{
+		return true;
+	}
+
+	double v = this->Hash(lon, lat, -1) / 4294967296.0;
+	return v < this->settings.coverage;
+}
+
+/// <summary>
+/// Get file name of tile in the format expected by LoadTiles
+/// HGT: N35W001.hgt, BIL: N35_W001.bil
+/// </summary>
+/// <param name="lat">latitude of SW corner</param>
+/// <param name="lon">longitude of SW corner</param>
+/// <returns>file name</returns>
+MyStringAnsi SyntheticDEM::GetTileName(int lat, int lon) const
+{
+	char name[32];
+	if (this->settings.format == TileInfo::BIL)
+	{
+		snprintf(name, sizeof(name), "%c%02d_%c%03d.bil",
+			(lat < 0) ? 'S' : 'N', std::abs(lat), (lon < 0) ? 'W' : 'E', std::abs(lon));
+	}
+	else
+	{
+		snprintf(name, sizeof(name), "%c%02d%c%03d.hgt",
+			(lat < 0) ? 'S' : 'N', std::abs(lat), (lon < 0) ? 'W' : 'E', std::abs(lon));
+	}
+	return name;
+}
+
+/// <summary>
+/// Create content of tile file
+/// Rows are stored from north to south, border pixels overlap with neighbor tiles
+/// </summary>
+/// <param name="lat">latitude of SW corner</param>
+/// <param name="lon">longitude of SW corner</param>
+/// <returns>encoded tile</returns>
+std::vector<uint8_t> SyntheticDEM::CreateTileData(int lat, int lon) const
+{
+	int size = this->settings.tileSize;
+	int bpv = (this->settings.bytesPerValue == 1) ? 1 : 2;
+	bool bigEndian = (this->settings.format == TileInfo::HGT);
+
+	std::vector<uint8_t> data(static_cast<size_t>(size) * size * bpv);
+	double step = 1.0 / (size - 1);
+
+	for (int y = 0; y < size; y++)
+	{
+		double pLat = lat + 1.0 - y * step;
+
+		for (int x = 0; x < size; x++)
+		{
+			double h = this->GetHeight(pLat, lon + x * step);
+			size_t i = (static_cast<size_t>(y) * size + x) * bpv;
+
+			if (bpv == 1)
+			{
+				data[i] = static_cast<uint8_t>(std::min(255.0, 255.0 * h / this->settings.maxHeight));
+				continue;
+			}
+
+			uint16_t v = static_cast<uint16_t>(static_cast<int16_t>(h));
+			data[i + ((bigEndian) ? 0 : 1)] = static_cast<uint8_t>(v >> 8);
+			data[i + ((bigEndian) ? 1 : 0)] = static_cast<uint8_t>(v & 0xFF);
+		}
+	}
+
+	return data;
+}
+
+/// <summary>
+/// Get terrain height at geo position
+/// </summary>
+/// <param name="lat">latitude in degrees</param>
+/// <param name="lon">longitude in degrees</param>
+/// <returns>height in meters (0 for sea)</returns>
+double SyntheticDEM::GetHeight(double lat, double lon) const
+{
+	//base wave length is 2 degrees, each octave halves it
+	double freq = 0.5;
+	double amp = 1.0;
+	double sum = 0.0;
+	double ampSum = 0.0;
+
+	for (int o = 0; o < this->settings.octaves; o++)
+	{
+		sum += amp * this->ValueNoise(lon * freq, lat * freq, o);
+		ampSum += amp;
+
+		freq *= 2.0;
+		amp *= 0.5;
+	}
+
+	double n = (ampSum > 0) ? sum / ampSum : 0.0;
+
+	//shift, so about one third of terrain is below sea level
+	double h = (n + 0.3) / 1.3 * this->settings.maxHeight;
+
+	return std::max(0.0, std::min(h, this->settings.maxHeight));
+}
+
+uint32_t SyntheticDEM::Hash(int x, int y, int octave) const
+{
+	uint32_t h = this->settings.seed * 0x9E3779B1u;
+	h ^= static_cast<uint32_t>(x) * 0x85EBCA77u;
+	h = (h << 13) | (h >> 19);
+	h ^= static_cast<uint32_t>(y) * 0xC2B2AE3Du;
+	h = (h << 13) | (h >> 19);
+	h ^= static_cast<uint32_t>(octave) * 0x27D4EB2Fu;
+
+	//murmur3 finalizer
+	h ^= h >> 16;
+	h *= 0x85EBCA6Bu;
+	h ^= h >> 13;
+	h *= 0xC2B2AE35u;
+	h ^= h >> 16;
+
+	return h;
+}
+
+/// <summary>
+/// Smooth value noise - random values in lattice points
+/// bilinearly interpolated with smoothstep
+/// </summary>
+/// <param name="x">x position in lattice units</param>
+/// <param name="y">y position in lattice units</param>
+/// <param name="octave">octave (different octaves have different lattices)</param>
+/// <returns>value in range <-1, 1></returns>
+double SyntheticDEM::ValueNoise(double x, double y, int octave) const
+{
+	double fx = std::floor(x);
+	double fy = std::floor(y);
+	int ix = static_cast<int>(fx);
+	int iy = static_cast<int>(fy);
+
+	double tx = x - fx;
+	double ty = y - fy;
+	tx = tx * tx * (3.0 - 2.0 * tx);
+	ty = ty * ty * (3.0 - 2.0 * ty);
+
+	auto lattice = [&](int px, int py) -> double {
+		return this->Hash(px, py, octave) / 2147483647.5 - 1.0;
+	};
+
+	double v00 = lattice(ix, iy);
+	double v10 = lattice(ix + 1, iy);
+	double v01 = lattice(ix, iy + 1);
+	double v11 = lattice(ix + 1, iy + 1);
+
+	double a = v00 + (v10 - v00) * tx;
+	double b = v01 + (v11 - v01) * tx;
+
+	return a + (b - a) * ty;
+}
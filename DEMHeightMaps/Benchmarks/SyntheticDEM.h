@@ -0,0 +1,84 @@
+#ifndef SYNTHETIC_DEM_H
+#define SYNTHETIC_DEM_H
+
+#include <cstdint>
+#include <vector>
+
+#include "../DEMTile.h"
+#include "../Strings/MyString.h"
+
+/// <summary>
+/// Synthetic dataset settings
+/// Tiles are generated for all SW corners in [minLat, maxLat) x [minLon, maxLon)
+/// </summary>
+typedef struct SyntheticDEMSettings
+{
+	enum ZIP_MODE { NONE = 0, PER_TILE = 1, SINGLE_ARCHIVE = 2 };
+
+	MyStringAnsi outputDir;
+
+	int minLat;
+	int maxLat;
+	int minLon;
+	int maxLon;
+	double coverage;			//<0, 1> - part of region covered by tiles (rest is missing)
+
+	int tileSize;				//1201 (3") or 3601 (1")
+	int bytesPerValue;			//1 or 2
+	TileInfo::SOURCE format;	//HGT (N35W001.hgt, big endian) or BIL (N35_W001.bil, little endian)
+
+	ZIP_MODE zipMode;			//PER_TILE = N35W001.hgt.zip, SINGLE_ARCHIVE = tiles.zip
+	bool zipDeflate;			//compress zipped tiles, otherwise they are stored
+
+	uint32_t seed;
+	int octaves;				//number of fBm octaves
+	double maxHeight;			//max terrain height in meters
+
+	SyntheticDEMSettings() :
+		outputDir("./synthetic_dem/"),
+		minLat(45), maxLat(50),
+		minLon(5), maxLon(15),
+		coverage(1.0),
+		tileSize(1201),
+		bytesPerValue(2),
+		format(TileInfo::HGT),
+		zipMode(NONE),
+		zipDeflate(true),
+		seed(1),
+		octaves(8),
+		maxHeight(4000.0)
+	{}
+
+} SyntheticDEMSettings;
+
+/// <summary>
+/// Generator of deterministic fractal terrain (fBm of value noise)
+/// written as DEM tiles with the same naming and sizes as real data,
+/// so LoadTiles / BuildMap can run without real datasets.
+/// Terrain is continuous in geo coordinates, so neighbor tiles share
+/// their border pixels as real HGT tiles do.
+/// The same settings always produce the same files
+/// </summary>
+class SyntheticDEM
+{
+public:
+	SyntheticDEM(const SyntheticDEMSettings & settings);
+	~SyntheticDEM() = default;
+
+	std::vector<MyStringAnsi> Generate();
+
+	bool IsTileCovered(int lat, int lon) const;
+	MyStringAnsi GetTileName(int lat, int lon) const;
+	std::vector<uint8_t> CreateTileData(int lat, int lon) const;
+	double GetHeight(double lat, double lon) const;
+
+	static void CreatePath(const MyStringAnsi & path);
+
+private:
+	SyntheticDEMSettings settings;
+
+	uint32_t Hash(int x, int y, int octave) const;
+	double ValueNoise(double x, double y, int octave) const;
+};
+
+#endif
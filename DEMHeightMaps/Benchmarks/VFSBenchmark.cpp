@@ -0,0 +1,421 @@
+#include "./VFSBenchmark.h"
+
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <cinttypes>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+
+#ifndef _WIN32
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+/// <summary>
+/// ctor
+/// </summary>
+/// <param name="settings">benchmark settings</param>
+VFSBenchmark::VFSBenchmark(const VFSBenchmarkSettings & settings) :
+	settings(settings),
+	rawBytes(0)
+{
+	if (this->settings.workDir.GetLastChar() != '/')
+	{
+		this->settings.workDir += '/';
+	}
+
+	if (this->settings.threadsCount <= 0)
+	{
+		this->settings.threadsCount = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+	}
+
+	const SyntheticDEMSettings & ds = this->settings.dataset;
+	SyntheticDEM dem(ds);
+	for (int lat = ds.minLat; lat < ds.maxLat; lat++)
+	{
+		for (int lon = ds.minLon; lon < ds.maxLon; lon++)
+		{
+			if (dem.IsTileCovered(lat, lon))
+			{
+				this->tileNames.push_back(dem.GetTileName(lat, lon));
+			}
+		}
+	}
+}
+
+/// <summary>
+/// Create all backends and measure them
+/// </summary>
+/// <returns>results for all backends, single and multi-threaded</returns>
+std::vector<VFSBenchmarkResult> VFSBenchmark::Run()
+{
+	std::vector<VFSBenchmarkResult> results;
+
+	std::vector<Backend> backends(6);
+	backends[0].name = "raw";
+	backends[1].name = "zip_stored";
+	backends[2].name = "zip_deflate";
+	backends[3].name = "packed_stored";
+	backends[4].name = "packed_deflate";
+	backends[5].name = "packed_frames";
+	for (auto & b : backends)
+	{
+		b.dir = this->settings.workDir;
+		b.dir += b.name;
+		b.dir += '/';
+	}
+
+	bool ok = (this->tileNames.empty() == false);
+	ok = ok && this->CreateSyntheticBackend(backends[0], SyntheticDEMSettings::NONE, false);
+	this->rawBytes = GetFilesSize(backends[0]);
+	ok = ok && this->CreateSyntheticBackend(backends[1], SyntheticDEMSettings::SINGLE_ARCHIVE, false);
+	ok = ok && this->CreateSyntheticBackend(backends[2], SyntheticDEMSettings::SINGLE_ARCHIVE, true);
+	ok = ok && this->CreatePackedBackend(backends[0], backends[3], VFS_COMPRESSION::STORED);
+	ok = ok && this->CreatePackedBackend(backends[0], backends[4], VFS_COMPRESSION::DEFLATE);
+	ok = ok && this->CreatePackedBackend(backends[0], backends[5], VFS_COMPRESSION::DEFLATE_FRAMES);
+
+	if (ok == false)
+	{
+		printf("[Benchmark Error] Failed to create backends in %s\n", this->settings.workDir.c_str());
+		VFS::Destroy();
+		return results;
+	}
+
+	for (const auto & b : backends)
+	{
+		results.push_back(this->RunBackend(b, 1));
+		if (this->settings.threadsCount > 1)
+		{
+			results.push_back(this->RunBackend(b, this->settings.threadsCount));
+		}
+	}
+
+	VFS::Destroy();
+
+	return results;
+}
+
+//=======================================================================================
+// Backends
+//=======================================================================================
+
+/// <summary>
+/// Generate synthetic tiles to backend directory
+/// </summary>
+/// <param name="b">created backend</param>
+/// <param name="zipMode">raw tiles or single zip archive</param>
+/// <param name="deflate">compress zipped tiles, otherwise they are stored</param>
+/// <returns>true if all files were created</returns>
+bool VFSBenchmark::CreateSyntheticBackend(Backend & b, SyntheticDEMSettings::ZIP_MODE zipMode, bool deflate)
+{
+	SyntheticDEMSettings ds = this->settings.dataset;
+	ds.outputDir = b.dir;
+	ds.zipMode = zipMode;
+	ds.zipDeflate = deflate;
+
+	SyntheticDEM dem(ds);
+	b.osFiles = dem.Generate();
+
+	if (zipMode == SyntheticDEMSettings::NONE)
+	{
+		return b.osFiles.size() == this->tileNames.size();
+	}
+	return b.osFiles.size() == 1;
+}
+
+/// <summary>
+/// Pack raw backend with VFS::PackStructure
+/// </summary>
+/// <param name="raw">raw backend with tiles</param>
+/// <param name="b">created backend</param>
+/// <param name="compression">compression of packed tiles</param>
+/// <returns>true if packed file was created</returns>
+bool VFSBenchmark::CreatePackedBackend(const Backend & raw, Backend & b, VFS_COMPRESSION compression)
+{
+	SyntheticDEM::CreatePath(b.dir);
+
+	MyStringAnsi fileName = b.dir;
+	fileName += "tiles.pack";
+
+	this->ResetVFS(raw);
+	VFS::GetInstance()->PackStructure(fileName, compression);
+
+	b.osFiles.push_back(fileName);
+	return GetFilesSize(b) > 0;
+}
+
+//=======================================================================================
+// Measurement
+//=======================================================================================
+
+/// <summary>
+/// Create new VFS with single backend
+/// </summary>
+/// <param name="b">backend</param>
+/// <returns>VFS paths of all tiles</returns>
+std::vector<MyStringAnsi> VFSBenchmark::ResetVFS(const Backend & b) const
+{
+	VFS::Destroy();
+	VFS::InitializeEmpty();
+
+	VFS::GetInstance()->AddDirectory(b.dir);
+
+	std::vector<MyStringAnsi> paths;
+	for (const auto & name : this->tileNames)
+	{
+		MyStringAnsi p = "/";
+		p += name;
+		paths.push_back(p);
+	}
+
+	return paths;
+}
+
+/// <summary>
+/// Evict backend files from OS page cache
+/// </summary>
+/// <param name="b">backend</param>
+void VFSBenchmark::DropCache(const Backend & b)
+{
+#if defined(__linux__)
+	for (const auto & f : b.osFiles)
+	{
+		int fd = open(f.c_str(), O_RDONLY);
+		if (fd < 0)
+		{
+			continue;
+		}
+		posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+		close(fd);
+	}
+#endif
+}
+
+uint64_t VFSBenchmark::GetFilesSize(const Backend & b)
+{
+	uint64_t size = 0;
+	for (const auto & fileName : b.osFiles)
+	{
+		FILE * f = nullptr;
+		my_fopen(&f, fileName.c_str(), "rb");
+		if (f == nullptr)
+		{
+			continue;
+		}
+		my_fseek(f, 0, SEEK_END);
+		size += static_cast<uint64_t>(ftell(f));
+		fclose(f);
+	}
+	return size;
+}
+
+/// <summary>
+/// Run task for all indices [0, count) on given number of threads
+/// </summary>
+/// <param name="threads">number of threads</param>
+/// <param name="count">number of tasks</param>
+/// <param name="task">task for index, returns its duration</param>
+/// <returns>durations of all tasks</returns>
+std::vector<double> VFSBenchmark::RunParallel(int threads, size_t count, std::function<double(size_t)> task)
+{
+	std::vector<double> durations(count);
+	std::atomic<size_t> next(0);
+
+	auto worker = [&]() {
+		for (size_t i = next++; i < count; i = next++)
+		{
+			durations[i] = task(i);
+		}
+	};
+
+	std::vector<std::thread> workers;
+	for (int t = 1; t < threads; t++)
+	{
+		workers.emplace_back(worker);
+	}
+	worker();
+
+	for (auto & w : workers)
+	{
+		w.join();
+	}
+
+	return durations;
+}
+
+double VFSBenchmark::GetPercentile(std::vector<double> & values, double p)
+{
+	if (values.empty())
+	{
+		return 0;
+	}
+
+	size_t n = std::min(values.size() - 1, static_cast<size_t>(values.size() * p));
+	std::nth_element(values.begin(), values.begin() + n, values.end());
+	return values[n];
+}
+
+/// <summary>
+/// Measure single backend
+/// </summary>
+/// <param name="b">backend</param>
+/// <param name="threads">number of threads</param>
+/// <returns>measured result</returns>
+VFSBenchmarkResult VFSBenchmark::RunBackend(const Backend & b, int threads)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	auto elapsedUs = [](Clock::time_point start) -> double {
+		return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+	};
+
+	VFSBenchmarkResult res;
+	res.backend = b.name;
+	res.threads = threads;
+	res.storageBytes = GetFilesSize(b);
+	res.rawBytes = this->rawBytes;
+
+	int tileSize = this->settings.dataset.tileSize;
+	int bytesPerValue = this->settings.dataset.bytesPerValue;
+
+	double rawMB = this->rawBytes / (1024.0 * 1024.0);
+
+	//open latency - fresh VFS, nothing cached
+	std::vector<MyStringAnsi> paths = this->ResetVFS(b);
+	DropCache(b);
+
+	std::vector<double> open = RunParallel(threads, paths.size(), [&](size_t i) -> double {
+		auto start = Clock::now();
+		short value = 0;
+		VFS::GetInstance()->ReadAt(paths[i], 0, bytesPerValue, &value);
+		return elapsedUs(start);
+	});
+
+	double sum = 0;
+	for (double d : open)
+	{
+		sum += d;
+	}
+	res.openAvgUs = (open.empty()) ? 0 : sum / open.size();
+	res.openP99Us = GetPercentile(open, 0.99);
+
+	//cold and warm throughput
+	auto readAll = [&]() -> double {
+		auto start = Clock::now();
+		RunParallel(threads, paths.size(), [&](size_t i) -> double {
+			size_t fileSize = 0;
+			delete[] VFS::GetInstance()->GetFileContent(paths[i], &fileSize);
+			return 0;
+		});
+		return elapsedUs(start);
+	};
+
+	paths = this->ResetVFS(b);
+	DropCache(b);
+
+	double coldUs = readAll();
+	double warmUs = readAll();
+
+	res.coldMBs = rawMB / (coldUs / 1000000.0);
+	res.warmMBs = rawMB / (warmUs / 1000000.0);
+
+	//random samples (warm)
+	size_t samplesCount = static_cast<size_t>(std::max(0, this->settings.randomSamples));
+	std::vector<std::pair<size_t, uint64_t>> samples(samplesCount);
+
+	std::mt19937 rnd(this->settings.seed);
+	std::uniform_int_distribution<size_t> tileDist(0, paths.size() - 1);
+	std::uniform_int_distribution<uint64_t> pixelDist(0, static_cast<uint64_t>(tileSize) * tileSize - 1);
+	for (auto & s : samples)
+	{
+		s.first = tileDist(rnd);
+		s.second = pixelDist(rnd);
+	}
+
+	std::vector<double> sampleTimes = RunParallel(threads, samples.size(), [&](size_t i) -> double {
+		auto start = Clock::now();
+		short value = 0;
+		VFS::GetInstance()->ReadAt(paths[samples[i].first], samples[i].second * bytesPerValue, bytesPerValue, &value);
+		return elapsedUs(start);
+	});
+
+	sum = 0;
+	for (double d : sampleTimes)
+	{
+		sum += d;
+	}
+	res.sampleAvgUs = (sampleTimes.empty()) ? 0 : sum / sampleTimes.size();
+	res.sampleP99Us = GetPercentile(sampleTimes, 0.99);
+
+	return res;
+}
+
+//=======================================================================================
+// Output
+//=======================================================================================
+
+void VFSBenchmark::PrintResults(const std::vector<VFSBenchmarkResult> & results)
+{
+	printf("%-16s %7s %10s %10s %10s %10s %10s %10s %10s\n",
+		"backend", "threads", "size MB", "cold MB/s", "warm MB/s", "open us", "open p99", "sample us", "smpl p99");
+
+	for (const auto & r : results)
+	{
+		printf("%-16s %7d %10.2f %10.2f %10.2f %10.2f %10.2f %10.2f %10.2f\n",
+			r.backend.c_str(), r.threads, r.storageBytes / (1024.0 * 1024.0),
+			r.coldMBs, r.warmMBs, r.openAvgUs, r.openP99Us, r.sampleAvgUs, r.sampleP99Us);
+	}
+}
+
+bool VFSBenchmark::SaveCSV(const std::vector<VFSBenchmarkResult> & results, const MyStringAnsi & fileName)
+{
+	FILE * f = nullptr;
+	my_fopen(&f, fileName.c_str(), "w");
+	if (f == nullptr)
+	{
+		printf("Failed to open file %s\n", fileName.c_str());
+		return false;
+	}
+
+	fprintf(f, "backend;threads;storage_bytes;raw_bytes;cold_mbs;warm_mbs;open_avg_us;open_p99_us;sample_avg_us;sample_p99_us\n");
+	for (const auto & r : results)
+	{
+		fprintf(f, "%s;%d;%" PRIu64 ";%" PRIu64 ";%f;%f;%f;%f;%f;%f\n",
+			r.backend.c_str(), r.threads, r.storageBytes, r.rawBytes,
+			r.coldMBs, r.warmMBs, r.openAvgUs, r.openP99Us, r.sampleAvgUs, r.sampleP99Us);
+	}
+
+	fclose(f);
+	return true;
+}
+
+bool VFSBenchmark::SaveJSON(const std::vector<VFSBenchmarkResult> & results, const MyStringAnsi & fileName)
+{
+	FILE * f = nullptr;
+	my_fopen(&f, fileName.c_str(), "w");
+	if (f == nullptr)
+	{
+		printf("Failed to open file %s\n", fileName.c_str());
+		return false;
+	}
+
+	fprintf(f, "[\n");
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const auto & r = results[i];
+		fprintf(f, "  {\"backend\": \"%s\", \"threads\": %d, \"storage_bytes\": %" PRIu64 ", \"raw_bytes\": %" PRIu64 ", "
+			"\"cold_mbs\": %f, \"warm_mbs\": %f, \"open_avg_us\": %f, \"open_p99_us\": %f, "
+			"\"sample_avg_us\": %f, \"sample_p99_us\": %f}%s\n",
+			r.backend.c_str(), r.threads, r.storageBytes, r.rawBytes,
+			r.coldMBs, r.warmMBs, r.openAvgUs, r.openP99Us, r.sampleAvgUs, r.sampleP99Us,
+			(i + 1 < results.size()) ? "," : "");
+	}
+	fprintf(f, "]\n");
+
+	fclose(f);
+	return true;
+}
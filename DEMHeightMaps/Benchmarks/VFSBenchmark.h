@@ -0,0 +1,104 @@
+#ifndef VFS_BENCHMARK_H
+#define VFS_BENCHMARK_H
+
+#include <cstdint>
+#include <vector>
+#include <functional>
+
+#include "./SyntheticDEM.h"
+#include "../VFS/VFS.h"
+#include "../Strings/MyString.h"
+
+/// <summary>
+/// Benchmark settings
+/// </summary>
+typedef struct VFSBenchmarkSettings
+{
+	MyStringAnsi workDir;		//directory where all backends are created
+	SyntheticDEMSettings dataset;	//generated tiles (outputDir and zip settings are ignored)
+	int threadsCount;			//threads for multi-threaded runs, 0 = number of HW threads
+	int randomSamples;			//number of random samples per run
+	uint32_t seed;				//seed of random sample positions
+
+	VFSBenchmarkSettings() :
+		workDir("./vfs_benchmark/"),
+		threadsCount(0),
+		randomSamples(2000),
+		seed(1)
+	{
+		dataset.minLat = 10;
+		dataset.maxLat = 14;
+		dataset.minLon = 10;
+		dataset.maxLon = 14;
+	}
+
+} VFSBenchmarkSettings;
+
+/// <summary>
+/// Result of single backend run with given number of threads
+/// </summary>
+typedef struct VFSBenchmarkResult
+{
+	MyStringAnsi backend;
+	int threads;
+
+	uint64_t storageBytes;		//size of backend files on disk
+	uint64_t rawBytes;			//size of uncompressed tiles
+
+	double coldMBs;				//GetFileContent throughput - first pass after cache drop
+	double warmMBs;				//GetFileContent throughput - second pass
+	double openAvgUs;			//time to open tile and read its first sample
+	double openP99Us;
+	double sampleAvgUs;			//latency of single random sample (ReadAt)
+	double sampleP99Us;
+
+} VFSBenchmarkResult;
+
+/// <summary>
+/// Compare cost of storing the same tiles in different VFS backends
+/// (raw tiles, zip archives and PACKED_FS). Synthetic tiles (SyntheticDEM)
+/// are created in workDir, each backend is then loaded via VFS::AddDirectory
+/// and measured with single thread and with threadsCount threads.
+///
+/// VFS singleton is re-initialized for every run and destroyed at the end.
+/// "Cold" runs evict backend files from OS page cache where possible
+/// (posix_fadvise), on other platforms they only start with fresh VFS
+/// </summary>
+class VFSBenchmark
+{
+public:
+	VFSBenchmark(const VFSBenchmarkSettings & settings);
+	~VFSBenchmark() = default;
+
+	std::vector<VFSBenchmarkResult> Run();
+
+	static void PrintResults(const std::vector<VFSBenchmarkResult> & results);
+	static bool SaveCSV(const std::vector<VFSBenchmarkResult> & results, const MyStringAnsi & fileName);
+	static bool SaveJSON(const std::vector<VFSBenchmarkResult> & results, const MyStringAnsi & fileName);
+
+private:
+	typedef struct Backend
+	{
+		MyStringAnsi name;
+		MyStringAnsi dir;						//VFS root of backend
+		std::vector<MyStringAnsi> osFiles;		//all files of backend
+
+	} Backend;
+
+	VFSBenchmarkSettings settings;
+	std::vector<MyStringAnsi> tileNames;
+	uint64_t rawBytes;
+
+	bool CreateSyntheticBackend(Backend & b, SyntheticDEMSettings::ZIP_MODE zipMode, bool deflate);
+	bool CreatePackedBackend(const Backend & raw, Backend & b, VFS_COMPRESSION compression);
+
+	VFSBenchmarkResult RunBackend(const Backend & b, int threads);
+	std::vector<MyStringAnsi> ResetVFS(const Backend & b) const;
+
+	static void DropCache(const Backend & b);
+	static uint64_t GetFilesSize(const Backend & b);
+	static std::vector<double> RunParallel(int threads, size_t count, std::function<double(size_t)> task);
+	static double GetPercentile(std::vector<double> & values, double p);
+};
+
+#endif
@@ -0,0 +1,147 @@
+#ifndef _BUFFER_POOL_H_
+#define _BUFFER_POOL_H_
+
+#include <unordered_map>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <cstdlib>
+#include <cstdint>
+
+#ifdef _MSC_VER
+	#include <malloc.h>
+#endif
+
+#define BUFFER_POOL_ALIGNMENT 64
+
+//======================================================
+//=========== Pool of aligned buffers ==================
+//======================================================
+
+/// <summary>
+/// Pool of aligned buffers grouped by their size.
+/// Released buffers are kept for reuse up to maxPooledSize bytes,
+/// so repeated tile loads do not hit the allocator
+/// </summary>
+class BufferPool : public std::enable_shared_from_this<BufferPool>
+{
+public:
+	BufferPool(size_t maxPooledSize);
+	~BufferPool();
+
+	std::shared_ptr<void> Acquire(size_t size);
+
+private:
+	size_t maxPooledSize;
+	size_t pooledSize;
+	std::unordered_map<size_t, std::vector<void *>> freeBuffers;
+
+	std::mutex poolLock;
+
+	void Release(void * ptr, size_t size);
+
+	static void * AllocAligned(size_t size);
+	static void FreeAligned(void * ptr);
+};
+
+//======================================================
+//============== Implementation ========================
+//======================================================
+
+/// <summary>
+/// ctor
+/// </summary>
+/// <param name="maxPooledSize">max size of released buffers kept for reuse in bytes</param>
+inline BufferPool::BufferPool(size_t maxPooledSize)
+	: maxPooledSize(maxPooledSize), pooledSize(0)
+{
+}
+
+inline BufferPool::~BufferPool()
+{
+	for (auto & it : this->freeBuffers)
+	{
+		for (void * ptr : it.second)
+		{
+			FreeAligned(ptr);
+		}
+	}
+}
+
+inline void * BufferPool::AllocAligned(size_t size)
+{
+#ifdef _MSC_VER
+	return _aligned_malloc(size, BUFFER_POOL_ALIGNMENT);
+#else
+	void * ptr = nullptr;
+	if (posix_memalign(&ptr, BUFFER_POOL_ALIGNMENT, size) != 0)
+	{
+		return nullptr;
+	}
+	return ptr;
+#endif
+}
+
+inline void BufferPool::FreeAligned(void * ptr)
+{
+#ifdef _MSC_VER
+	_aligned_free(ptr);
+#else
+	free(ptr);
+#endif
+}
+
+/// <summary>
+/// Get buffer of given size. Buffer is returned to the pool,
+/// when the last shared_ptr is released.
+/// Pool must be owned by shared_ptr
+/// </summary>
+/// <param name="size">size of buffer in bytes</param>
+/// <returns>aligned buffer or nullptr</returns>
+inline std::shared_ptr<void> BufferPool::Acquire(size_t size)
+{
+	void * ptr = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(poolLock);
+
+		auto it = this->freeBuffers.find(size);
+		if ((it != this->freeBuffers.end()) && (it->second.empty() == false))
+		{
+			ptr = it->second.back();
+			it->second.pop_back();
+			this->pooledSize -= size;
+		}
+	}
+
+	if (ptr == nullptr)
+	{
+		ptr = AllocAligned(size);
+		if (ptr == nullptr)
+		{
+			return nullptr;
+		}
+	}
+
+	std::shared_ptr<BufferPool> self = this->shared_from_this();
+	return std::shared_ptr<void>(ptr, [self, size](void * p) {
+		self->Release(p, size);
+	});
+}
+
+inline void BufferPool::Release(void * ptr, size_t size)
+{
+	{
+		std::lock_guard<std::mutex> lock(poolLock);
+
+		if (this->pooledSize + size <= this->maxPooledSize)
+		{
+			this->freeBuffers[size].push_back(ptr);
+			this->pooledSize += size;
+			return;
+		}
+	}
+
+	FreeAligned(ptr);
+}
+
+#endif
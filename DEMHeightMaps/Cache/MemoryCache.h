@@ -39,6 +39,7 @@ public:
 	typename MemoryCache<Key, Value, CacheControl>::InsertInfo Insert(const Key & key, const Value & value, size_t valueSize = sizeof(Value));
 	typename MemoryCache<Key, Value, CacheControl>::InsertInfo InsertWithValidTime(const Key & key, const Value & value, uint32_t lifeTimeSeconds, size_t valueSize = sizeof(Value));
 	Value * Get(const Key & key);
+	bool GetCopy(const Key & key, Value & value);
 
 
     bool Remove(const Key & key);
@@ -293,6 +294,33 @@ Value * MemoryCache<Key, Value, CacheControl>::Get(const Key & key)
 	return &(it->second.value);
 }
 
+/// <summary>
+/// Get copy of value from cache by its key and update its "use"
+/// Value is copied under lock, so it can not be removed
+/// by other thread during copying
+/// </summary>
+/// <param name="key"></param>
+/// <param name="value">output value</param>
+/// <returns>true if key was found</returns>
+template <typename Key, typename Value, typename CacheControl>
+bool MemoryCache<Key, Value, CacheControl>::GetCopy(const Key & key, Value & value)
+{
+	std::lock_guard<std::mutex> lock(memCacheLock);
+
+	auto it = this->values.find(key);
+
+	if (it == this->values.end())
+	{
+		return false;
+	}
+
+	this->type.Update(key);
+
+	value = it->second.value;
+
+	return true;
+}
+
 
 
 #endif
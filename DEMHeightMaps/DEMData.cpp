@@ -1,13 +1,20 @@
 #include "./DEMData.h"
 
 #include <algorithm>
+#include <cmath>
+#include <limits>
+#include <list>
+#include <unordered_set>
 
 #include <MapProjection.h>
 #include <GeoCoordinate.h>
 #include <Projections.h>
 
 #include "./VFS/VFS.h"
+#include "./VFS/VFSAsyncReader.h"
 #include "./Utils/Utils.h"
+#include "./Utils/Profiler.h"
+#include "./Utils/WorkStealingPool.h"
 #include "./TinyXML/tinyxml.h"
 
 
@@ -27,6 +34,7 @@ DEMData<HeightType, ProjType>::DEMData(std::initializer_list<MyStringAnsi> dirs)
 	this->maxHeight = 9000;
 	this->elevMapping = false;
 	this->verbose = false;
+	this->skipEmptyTiles = false;
 
 	VFS::InitializeEmpty();
 	for (auto d : dirs)
@@ -37,9 +45,13 @@ DEMData<HeightType, ProjType>::DEMData(std::initializer_list<MyStringAnsi> dirs)
 	this->tilesCache = new MemoryCache<MyStringAnsi, TileRawData, LRUControl<MyStringAnsi>>(
 		CACHE_SIZE_GB(16), LRUControl<MyStringAnsi>()
 		);
+	this->tilesPool = std::make_shared<BufferPool>(CACHE_SIZE_MB(512));
+	this->decodePool = new ThreadPool();
+	this->tilesReader = new VFSAsyncReader();
 
 
 	this->LoadTiles();
+	this->BuildCoverageMask();
 }
 
 template <typename HeightType, typename ProjType>
@@ -54,6 +66,7 @@ DEMData<HeightType, ProjType>::DEMData(std::initializer_list<MyStringAnsi> dirs,
 	this->maxHeight = 9000;
 	this->elevMapping = false;
 	this->verbose = false;
+	this->skipEmptyTiles = false;
 
 	
 	VFS::InitializeEmpty();
@@ -65,19 +78,32 @@ DEMData<HeightType, ProjType>::DEMData(std::initializer_list<MyStringAnsi> dirs,
 	this->tilesCache = new MemoryCache<MyStringAnsi, TileRawData, LRUControl<MyStringAnsi>>(
 		CACHE_SIZE_GB(16), LRUControl<MyStringAnsi>()
 		);
+	this->tilesPool = std::make_shared<BufferPool>(CACHE_SIZE_MB(512));
+	this->decodePool = new ThreadPool();
+	this->tilesReader = new VFSAsyncReader();
 
 	this->ImportTileList(tilesInfoXML);
+	this->BuildCoverageMask();
 }
 
 template <typename HeightType, typename ProjType>
 DEMData<HeightType, ProjType>::~DEMData()
 {
+	delete this->tilesReader;
+	delete this->decodePool;
 	delete this->tilesCache;
 }
 
+/// <summary>
+/// Get projection with frame of the last finished BuildMap
+/// (without explicit context). Returned projection is not changed
+/// by later BuildMap calls
+/// </summary>
+/// <returns></returns>
 template <typename HeightType, typename ProjType>
 std::shared_ptr<ProjType> DEMData<HeightType, ProjType>::GetProjection() const
 {
+	std::lock_guard<std::mutex> lock(this->projectionLock);
 	return this->projection;
 }
 
@@ -100,6 +126,71 @@ void DEMData<HeightType, ProjType>::SetVerboseEnabled(bool val)
 	this->verbose = val;
 }
 
+/// <summary>
+/// If enabled, ProcessTileMap does not call callback for tiles
+/// that have no DEM data (tested with coverage mask)
+/// </summary>
+/// <param name="val"></param>
+template <typename HeightType, typename ProjType>
+void DEMData<HeightType, ProjType>::SetSkipEmptyTilesEnabled(bool val)
+{
+	this->skipEmptyTiles = val;
+}
+
+/// <summary>
+/// Test if area (min, max) can contain DEM data.
+/// Test is conservative (1 degree cells), true does not mean 
+/// that BuildMap of area returns data
+/// </summary>
+/// <param name="min"></param>
+/// <param name="max"></param>
+/// <returns>false if there is no DEM tile in area</returns>
+template <typename HeightType, typename ProjType>
+bool DEMData<HeightType, ProjType>::HasCoverage(const Projections::Coordinate & min, const Projections::Coordinate & max) const
+{
+	return this->coverage.IsEmpty(min.lon.deg(), min.lat.deg(), max.lon.deg(), max.lat.deg()) == false;
+}
+
+/// <summary>
+/// Enable VFS I/O statistics (opens, bytes, latencies per archive / root dir).
+/// Summary is printed at the end of BuildMap in verbose mode or with PrintIOStats
+/// </summary>
+/// <param name="val">enable statistics</param>
+/// <param name="traceFile">optional CSV log with every request, empty = no log</param>
+template <typename HeightType, typename ProjType>
+void DEMData<HeightType, ProjType>::SetIOStatsEnabled(bool val, const MyStringAnsi & traceFile)
+{
+	VFS::GetInstance()->GetStats().SetEnabled(val);
+	VFS::GetInstance()->GetStats().SetTraceFile((val) ? traceFile : MyStringAnsi(""));
+}
+
+template <typename HeightType, typename ProjType>
+void DEMData<HeightType, ProjType>::PrintIOStats() const
+{
+	VFS::GetInstance()->GetStats().PrintSummary();
+}
+
+/// <summary>
+/// Enable phase timers and counters of BuildMap / ProcessTileMap (Profiler).
+/// Summary is printed at the end of BuildMap in verbose mode or with PrintProfile
+/// </summary>
+/// <param name="val">enable profiling</param>
+/// <param name="traceFile">optional Chrome trace JSON, empty = no trace</param>
+/// <param name="hwCounters">read hardware counters (cycles, cache misses...) in each phase (Linux only)</param>
+template <typename HeightType, typename ProjType>
+void DEMData<HeightType, ProjType>::SetProfilingEnabled(bool val, const MyStringAnsi & traceFile, bool hwCounters)
+{
+	Profiler::GetInstance().SetEnabled(val);
+	Profiler::GetInstance().SetHardwareCountersEnabled(val && hwCounters);
+	Profiler::GetInstance().SetTraceFile((val) ? traceFile : MyStringAnsi(""));
+}
+
+template <typename HeightType, typename ProjType>
+void DEMData<HeightType, ProjType>::PrintProfile() const
+{
+	Profiler::GetInstance().PrintSummary();
+}
+
 //=======================================================================================
 // Loading
 //=======================================================================================
@@ -116,11 +207,11 @@ void DEMData<HeightType, ProjType>::LoadTiles()
 	for (const auto & file : tileFiles)
 	{
 		TileInfo::SOURCE src = TileInfo::HGT;		
-		MyStringAnsi fileName = file->name;
+		MyStringAnsi fileName = VFS::GetInstance()->GetFileName(file);
 
 		if (fileName.length() < 7)
 		{
-			printf("Incorrect tile file: %s\n", file->name);
+			printf("Incorrect tile file: %s\n", fileName.c_str());
 			continue;
 		}
 		
@@ -250,6 +341,24 @@ void DEMData<HeightType, ProjType>::ImportTileList(const MyStringAnsi & fileName
 
 }
 
+/// <summary>
+/// Mark 1 degree cells covered by loaded tiles
+/// </summary>
+template <typename HeightType, typename ProjType>
+void DEMData<HeightType, ProjType>::BuildCoverageMask()
+{
+	this->coverage.Clear();
+	for (auto & cell : this->tiles2Dmap)
+	{
+		for (auto & t : cell)
+		{
+			this->coverage.AddArea(t.minLon.deg(), t.minLat.deg(),
+				t.minLon.deg() + t.stepLon.deg(), t.minLat.deg() + t.stepLat.deg());
+		}
+	}
+	this->coverage.Build();
+}
+
 template <typename HeightType, typename ProjType>
 void DEMData<HeightType, ProjType>::AddTile(const DEMTileInfo & ti)
 {
@@ -366,6 +475,43 @@ std::unordered_map<size_t, std::unordered_map<size_t, TileInfo>> DEMData<HeightT
 	return res;
 }
 
+/// <summary>
+/// Same tiles as BuildTileMap, returned in given traversal order
+/// </summary>
+/// <param name="totalW"></param>
+/// <param name="totalH"></param>
+/// <param name="tilesCountX"></param>
+/// <param name="tilesCountY"></param>
+/// <param name="min"></param>
+/// <param name="max"></param>
+/// <param name="order">traversal order</param>
+/// <returns>generated tiles in traversal order</returns>
+template <typename HeightType, typename ProjType>
+std::vector<TileMapItem> DEMData<HeightType, ProjType>::BuildTileList(
+	int totalW, int totalH,
+	int tilesCountX, int tilesCountY,
+	const Projections::Coordinate & min, const Projections::Coordinate & max,
+	TILE_ORDER order)
+{
+	std::vector<TileMapItem> res;
+	res.reserve(static_cast<size_t>(tilesCountX) * tilesCountY);
+
+	this->ProcessTileMap(totalW, totalH,
+		tilesCountX, tilesCountY,
+		min, max,
+		[&](TileInfo & ti, size_t x, size_t y) {
+			TileMapItem item;
+			item.ti = ti;
+			item.x = x;
+			item.y = y;
+			res.push_back(item);
+		},
+		order
+	);
+
+	return res;
+}
+
 /// <summary>
 /// Divide area of size (totalW, totalH) to totalW x totalH tiles
 /// (each tile will have the same resolution).
@@ -379,40 +525,30 @@ std::unordered_map<size_t, std::unordered_map<size_t, TileInfo>> DEMData<HeightT
 /// <param name="min"></param>
 /// <param name="max"></param>
 /// <param name="tileCallback"></param>
+/// <param name="order">traversal order of tiles</param>
 template <typename HeightType, typename ProjType>
 void DEMData<HeightType, ProjType>::ProcessTileMap(
 	int totalW, int totalH,
 	int tilesCountX, int tilesCountY,
 	const Projections::Coordinate & min,
 	const Projections::Coordinate & max,
-	std::function<void(TileInfo & ti, size_t x, size_t y)> tileCallback)
+	std::function<void(TileInfo & ti, size_t x, size_t y)> tileCallback,
+	TILE_ORDER order)
 {
-	this->projection->SetFrame(min, max, totalW, totalH, false);
+	PROFILE_SCOPE("ProcessTileMap");
+
+	ProjType frame;
+	frame.SetFrame(min, max, totalW, totalH, false);
 
 	int tileW = totalW / tilesCountX;
 	int tileH = totalH / tilesCountY;
-	
-	for (int y = 0, ty = 0; y < totalH; y += tileH, ty++)
-	{
-		for (int x = 0, tx = 0; x < totalW; x += tileW, tx++)
-		{
-			Projections::Coordinate tileMin = this->projection->ProjectInverse({ x, y + tileH });
-			Projections::Coordinate tileMax = this->projection->ProjectInverse({ x + tileW, y });
 
-			TileInfo ti;
+	size_t countX = static_cast<size_t>((totalW + tileW - 1) / tileW);
+	size_t countY = static_cast<size_t>((totalH + tileH - 1) / tileH);
 
-			ti.width = tileW;
-			ti.height = tileH;
-			ti.minLon = tileMin.lon;
-			ti.minLat = tileMin.lat;
-			ti.stepLon = GeoCoordinate::rad(tileMax.lon.rad() - tileMin.lon.rad());
-			ti.stepLat = GeoCoordinate::rad(tileMax.lat.rad() - tileMin.lat.rad());
-			ti.pixelStepLat = GeoCoordinate::rad(ti.stepLat.rad() / tileH);
-			ti.pixelStepLon = GeoCoordinate::rad(ti.stepLon.rad() / tileW);
-
-			tileCallback(ti, tx, ty);
-		}
-	}
+	this->ProcessTiles(countX, countY, [&](size_t x, size_t y) {
+		return CreateTileInfo(frame, static_cast<int>(x) * tileW, static_cast<int>(y) * tileH, tileW, tileH);
+	}, tileCallback, order);
 }
 
 
@@ -428,84 +564,439 @@ void DEMData<HeightType, ProjType>::ProcessTileMap(
 /// <param name="max"></param>
 /// <param name="tileStep"></param>
 /// <param name="tileCallback"></param>
+/// <param name="order">traversal order of tiles</param>
 template <typename HeightType, typename ProjType>
 void DEMData<HeightType, ProjType>::ProcessTileMap(
 	int tileW, int tileH,
 	const Projections::Coordinate & min, const Projections::Coordinate & max,
 	const Projections::Coordinate & tileStep,
-	std::function<void(TileInfo & ti, size_t x, size_t y)> tileCallback)
+	std::function<void(TileInfo & ti, size_t x, size_t y)> tileCallback,
+	TILE_ORDER order)
 {
+	PROFILE_SCOPE("ProcessTileMap");
 	
-	size_t y = 0; //file
-	double tileStepLat = tileStep.lat.rad();
+	auto latSteps = CreateTileSteps(min.lat.rad(), max.lat.rad(), tileStep.lat.rad());
+	auto lonSteps = CreateTileSteps(min.lon.rad(), max.lon.rad(), tileStep.lon.rad());
+
+	this->ProcessTiles(lonSteps.size(), latSteps.size(), [&](size_t x, size_t y) {
+		return CreateTileInfo(lonSteps[x], latSteps[y], tileW, tileH);
+	}, tileCallback, order);
+}
+
+/// <summary>
+/// Parallel version of ProcessTileMap (tiles with the same resolution).
+/// Tiles are scheduled on work-stealing pool in traversal order, 
+/// neighbouring tiles in this order are processed by the same worker 
+/// (until work is stolen).
+/// 
+/// tileCallback is called from more threads at once and must be thread-safe.
+/// Each worker has its own request context, that is passed to callback
+/// and can be used for BuildMap(ctx, ...). 
+/// Shared projection of DEMData is not changed
+/// </summary>
+/// <param name="totalW"></param>
+/// <param name="totalH"></param>
+/// <param name="tilesCountX"></param>
+/// <param name="tilesCountY"></param>
+/// <param name="min"></param>
+/// <param name="max"></param>
+/// <param name="tileCallback"></param>
+/// <param name="order">traversal order of tiles</param>
+/// <param name="threadsCount">number of workers, 0 = number of HW threads</param>
+template <typename HeightType, typename ProjType>
+void DEMData<HeightType, ProjType>::ProcessTileMapParallel(
+	int totalW, int totalH,
+	int tilesCountX, int tilesCountY,
+	const Projections::Coordinate & min,
+	const Projections::Coordinate & max,
+	ParallelTileCallback tileCallback, 
+	TILE_ORDER order, size_t threadsCount)
+{
+	PROFILE_SCOPE("ProcessTileMap");
+
+	ProjType frame;
+	frame.SetFrame(min, max, totalW, totalH, false);
+
+	int tileW = totalW / tilesCountX;
+	int tileH = totalH / tilesCountY;
+
+	//same tiles as loops of ProcessTileMap
+	size_t countX = static_cast<size_t>((totalW + tileW - 1) / tileW);
+	size_t countY = static_cast<size_t>((totalH + tileH - 1) / tileH);
+
+	this->ProcessTilesParallel(countX, countY, [&](size_t x, size_t y) {
+		return CreateTileInfo(frame, static_cast<int>(x) * tileW, static_cast<int>(y) * tileH, tileW, tileH);
+	}, tileCallback, order, threadsCount);
+}
 
-	for (double lat = min.lat.rad(); lat < max.lat.rad(); lat += tileStepLat)
+/// <summary>
+/// Parallel version of ProcessTileMap (tiles with the same GPS step).
+/// See ProcessTileMapParallel above for callback contract
+/// </summary>
+/// <param name="tileW"></param>
+/// <param name="tileH"></param>
+/// <param name="min"></param>
+/// <param name="max"></param>
+/// <param name="tileStep"></param>
+/// <param name="tileCallback"></param>
+/// <param name="order">traversal order of tiles</param>
+/// <param name="threadsCount">number of workers, 0 = number of HW threads</param>
+template <typename HeightType, typename ProjType>
+void DEMData<HeightType, ProjType>::ProcessTileMapParallel(
+	int tileW, int tileH,
+	const Projections::Coordinate & min, const Projections::Coordinate & max,
+	const Projections::Coordinate & tileStep,
+	ParallelTileCallback tileCallback, 
+	TILE_ORDER order, size_t threadsCount)
+{
+	PROFILE_SCOPE("ProcessTileMap");
+
+	auto latSteps = CreateTileSteps(min.lat.rad(), max.lat.rad(), tileStep.lat.rad());
+	auto lonSteps = CreateTileSteps(min.lon.rad(), max.lon.rad(), tileStep.lon.rad());
+
+	this->ProcessTilesParallel(lonSteps.size(), latSteps.size(), [&](size_t x, size_t y) {
+		return CreateTileInfo(lonSteps[x], latSteps[y], tileW, tileH);
+	}, tileCallback, order, threadsCount);
+}
+
+/// <summary>
+/// Call tileCallback for all tiles of grid countX x countY in traversal order
+/// </summary>
+/// <param name="countX"></param>
+/// <param name="countY"></param>
+/// <param name="getTile">tile at grid position (x, y)</param>
+/// <param name="tileCallback"></param>
+/// <param name="order"></param>
+template <typename HeightType, typename ProjType>
+void DEMData<HeightType, ProjType>::ProcessTiles(size_t countX, size_t countY,
+	const std::function<TileInfo(size_t x, size_t y)> & getTile,
+	const std::function<void(TileInfo & ti, size_t x, size_t y)> & tileCallback,
+	TILE_ORDER order)
+{
+	std::vector<size_t> tilesOrder = this->CreateTileOrder(countX, countY, order, getTile);
+
+	for (size_t i = 0; i < countX * countY; i++)
 	{
-		bool breakLat = false;
-		if (lat >= max.lat.rad())
+		size_t index = (tilesOrder.empty()) ? i : tilesOrder[i];
+		size_t x = index % countX;
+		size_t y = index / countX;
+
+		TileInfo ti = getTile(x, y);
+
+		if (this->skipEmptyTiles && (this->HasCoverage(ti.GetCorner(0), ti.GetCorner(3)) == false))
 		{
-			lat = max.lat.rad();
-			breakLat = true;
+			Profiler::GetInstance().AddCounter("ProcessTileMap::EmptyTile");
+			continue;
 		}
 
-		if (lat + tileStepLat > max.lat.rad())
+		PROFILE_SCOPE("ProcessTileMap::Callback");
+		tileCallback(ti, x, y);
+	}
+}
+
+/// <summary>
+/// Parallel version of ProcessTiles
+/// </summary>
+/// <param name="countX"></param>
+/// <param name="countY"></param>
+/// <param name="getTile">tile at grid position (x, y), called from more threads</param>
+/// <param name="tileCallback"></param>
+/// <param name="order"></param>
+/// <param name="threadsCount"></param>
+template <typename HeightType, typename ProjType>
+void DEMData<HeightType, ProjType>::ProcessTilesParallel(size_t countX, size_t countY,
+	const std::function<TileInfo(size_t x, size_t y)> & getTile,
+	const ParallelTileCallback & tileCallback,
+	TILE_ORDER order, size_t threadsCount)
+{
+	std::vector<size_t> tilesOrder = this->CreateTileOrder(countX, countY, order, getTile);
+
+	WorkStealingPool pool(threadsCount);
+	std::vector<DEMRequestContext<ProjType>> contexts(pool.GetThreadsCount());
+
+	pool.Run(countX * countY, [&](size_t i, size_t worker) {
+		size_t index = (tilesOrder.empty()) ? i : tilesOrder[i];
+		size_t x = index % countX;
+		size_t y = index / countX;
+
+		TileInfo ti = getTile(x, y);
+
+		if (this->skipEmptyTiles && (this->HasCoverage(ti.GetCorner(0), ti.GetCorner(3)) == false))
+		{
+			Profiler::GetInstance().AddCounter("ProcessTileMap::EmptyTile");
+			return;
+		}
+
+		PROFILE_SCOPE("ProcessTileMap::Callback");
+		tileCallback(ti, x, y, contexts[worker]);
+	});
+
+	if (this->verbose)
+	{
+		printf("ProcessTileMap: %zu tiles (%s), %zu workers, %zu steals\n",
+			countX * countY, TileOrder::GetName(order), pool.GetThreadsCount(), pool.GetStealsCount());
+	}
+}
+
+/// <summary>
+/// Calculate traversal order of tiles of grid countX x countY.
+/// SOURCE_MAJOR groups tiles by DEM tile under their center, 
+/// groups follow Hilbert curve over DEM tiles and tiles in group
+/// follow Hilbert curve over output tiles.
+/// Tiles without DEM data are placed at the end
+/// </summary>
+/// <param name="countX"></param>
+/// <param name="countY"></param>
+/// <param name="order"></param>
+/// <param name="getTile">tile at grid position (x, y), used by SOURCE_MAJOR</param>
+/// <returns>tile indices (x + y * countX) in traversal order, empty for ROW_MAJOR</returns>
+template <typename HeightType, typename ProjType>
+std::vector<size_t> DEMData<HeightType, ProjType>::CreateTileOrder(size_t countX, size_t countY, TILE_ORDER order,
+	const std::function<TileInfo(size_t x, size_t y)> & getTile)
+{
+	if (order == TILE_ORDER::ROW_MAJOR)
+	{
+		return std::vector<size_t>();
+	}
+
+	if (order != TILE_ORDER::SOURCE_MAJOR)
+	{
+		return TileOrder::CreateCurveOrder(countX, countY, order);
+	}
+
+	PROFILE_SCOPE("ProcessTileMap::Order");
+
+	//DEM tiles are on 1 degree grid
+	const uint32_t SOURCE_GRID = 512;
+	const uint64_t NO_SOURCE = std::numeric_limits<uint64_t>::max();
+
+	uint32_t n = TileOrder::GetHilbertSize(countX, countY);
+
+	std::vector<size_t> res(countX * countY);
+	std::vector<std::pair<uint64_t, uint64_t>> keys(res.size());
+	for (size_t i = 0; i < res.size(); i++)
+	{
+		uint32_t x = static_cast<uint32_t>(i % countX);
+		uint32_t y = static_cast<uint32_t>(i / countX);
+
+		TileInfo ti = getTile(x, y);
+
+		Projections::Coordinate center;
+		center.lat = GeoCoordinate::rad(ti.minLat.rad() + 0.5 * ti.stepLat.rad());
+		center.lon = GeoCoordinate::rad(ti.minLon.rad() + 0.5 * ti.stepLon.rad());
+
+		DEMTileInfo * source = this->GetTile(center);
+
+		res[i] = i;
+		keys[i].first = NO_SOURCE;
+		keys[i].second = TileOrder::GetHilbertIndex(x, y, n);
+
+		if (source != nullptr)
 		{
-			tileStepLat -= ((lat + tileStepLat) - max.lat.rad());
-			breakLat = true;
+			uint32_t sx = static_cast<uint32_t>(std::floor(source->minLon.deg() + 180.0));
+			uint32_t sy = static_cast<uint32_t>(std::floor(source->minLat.deg() + 90.0));
+			keys[i].first = TileOrder::GetHilbertIndex(sx, sy, SOURCE_GRID);
 		}
+	}
+
+	std::sort(res.begin(), res.end(), [&](size_t a, size_t b) {
+		return keys[a] < keys[b];
+	});
+
+	return res;
+}
+
+/// <summary>
+/// Count DEM tile loads needed to build tiles in given order,
+/// if tiles cache holds cacheTiles DEM tiles (LRU).
+/// DEM tiles of each output tile are found on grid of probes 
+/// with step at most 0.5 degree
+/// </summary>
+/// <param name="tiles">output tiles in traversal order</param>
+/// <param name="cacheTiles">number of DEM tiles in cache</param>
+/// <returns>number of DEM tile loads</returns>
+template <typename HeightType, typename ProjType>
+size_t DEMData<HeightType, ProjType>::CountTileLoads(const std::vector<TileMapItem> & tiles, size_t cacheTiles)
+{
+	const double PROBE_STEP = GeoCoordinate::deg(0.5).rad();
+
+	std::list<DEMTileInfo *> lru;
+	std::unordered_map<DEMTileInfo *, std::list<DEMTileInfo *>::iterator> cached;
+
+	size_t loads = 0;
+	std::unordered_set<DEMTileInfo *> sources;
+
+	for (const TileMapItem & item : tiles)
+	{
+		const TileInfo & ti = item.ti;
+
+		//probes are in pixel centers, so neighbour DEM tiles
+		//touching only the border are not counted
+		double lat0 = ti.minLat.rad() + 0.5 * ti.pixelStepLat.rad();
+		double lon0 = ti.minLon.rad() + 0.5 * ti.pixelStepLon.rad();
+		double latLength = ti.stepLat.rad() - ti.pixelStepLat.rad();
+		double lonLength = ti.stepLon.rad() - ti.pixelStepLon.rad();
 
-		size_t x = 0; //dir
-		double tileStepLon = tileStep.lon.rad();
+		int latCount = static_cast<int>(std::ceil(latLength / PROBE_STEP)) + 1;
+		int lonCount = static_cast<int>(std::ceil(lonLength / PROBE_STEP)) + 1;
 
-		for (double lon = min.lon.rad(); lon < max.lon.rad(); lon += tileStepLon)
+		sources.clear();
+		for (int y = 0; y < latCount; y++)
 		{
-			bool breakLon = false;
-			if (lon >= max.lon.rad())
+			for (int x = 0; x < lonCount; x++)
 			{
-				lon = max.lon.rad();
-				breakLon = true;
+				Projections::Coordinate c;
+				c.lat = GeoCoordinate::rad(lat0 + ((latCount > 1) ? latLength * y / (latCount - 1) : 0));
+				c.lon = GeoCoordinate::rad(lon0 + ((lonCount > 1) ? lonLength * x / (lonCount - 1) : 0));
+
+				DEMTileInfo * source = this->GetTile(c);
+				if (source != nullptr)
+				{
+					sources.insert(source);
+				}
 			}
+		}
 
-			if (lon + tileStepLon > max.lon.rad())
+		for (DEMTileInfo * source : sources)
+		{
+			auto it = cached.find(source);
+			if (it != cached.end())
 			{
-				tileStepLon -= ((lon + tileStepLon) - max.lon.rad());
-				breakLon = true;
+				lru.splice(lru.begin(), lru, it->second);
+				continue;
 			}
 
-			TileInfo ti;
+			loads++;
+			lru.push_front(source);
+			cached[source] = lru.begin();
 
-			ti.width = tileW;
-			ti.height = tileH;
-			ti.minLon = GeoCoordinate::rad(lon);
-			ti.minLat = GeoCoordinate::rad(lat);
-			ti.stepLon = GeoCoordinate::rad(tileStepLon);
-			ti.stepLat = GeoCoordinate::rad(tileStepLat);
-			ti.pixelStepLat = GeoCoordinate::rad(tileStepLat / tileH);
-			ti.pixelStepLon = GeoCoordinate::rad(tileStepLon / tileW);
-
-			tileCallback(ti, x, y);
-
-			if (breakLon)
+			if (lru.size() > cacheTiles)
 			{
-				break;
+				cached.erase(lru.back());
+				lru.pop_back();
 			}
+		}
+	}
+
+	return loads;
+}
 
-			x++;
+/// <summary>
+/// Print number of DEM tile loads of BuildTileMap tiles for all traversal orders
+/// </summary>
+/// <param name="totalW"></param>
+/// <param name="totalH"></param>
+/// <param name="tilesCountX"></param>
+/// <param name="tilesCountY"></param>
+/// <param name="min"></param>
+/// <param name="max"></param>
+/// <param name="cacheTiles">number of DEM tiles in cache</param>
+template <typename HeightType, typename ProjType>
+void DEMData<HeightType, ProjType>::PrintTileOrderStats(int totalW, int totalH,
+	int tilesCountX, int tilesCountY,
+	const Projections::Coordinate & min, const Projections::Coordinate & max,
+	size_t cacheTiles)
+{
+	printf("DEM tile loads (%d x %d tiles, cache %zu DEM tiles):\n", tilesCountX, tilesCountY, cacheTiles);
+	for (TILE_ORDER order : TileOrder::ALL)
+	{
+		auto tiles = this->BuildTileList(totalW, totalH, tilesCountX, tilesCountY, min, max, order);
+		printf("  %-14s %zu\n", TileOrder::GetName(order), this->CountTileLoads(tiles, cacheTiles));
+	}
+}
+
+/// <summary>
+/// Tile of projection frame with top-left corner at pixel (x, y)
+/// </summary>
+/// <param name="frame">projection with frame of the whole map</param>
+/// <param name="x"></param>
+/// <param name="y"></param>
+/// <param name="tileW"></param>
+/// <param name="tileH"></param>
+/// <returns></returns>
+template <typename HeightType, typename ProjType>
+TileInfo DEMData<HeightType, ProjType>::CreateTileInfo(ProjType & frame, int x, int y, int tileW, int tileH)
+{
+	Projections::Coordinate tileMin = frame.ProjectInverse({ x, y + tileH });
+	Projections::Coordinate tileMax = frame.ProjectInverse({ x + tileW, y });
+
+	TileInfo ti;
+
+	ti.width = tileW;
+	ti.height = tileH;
+	ti.minLon = tileMin.lon;
+	ti.minLat = tileMin.lat;
+	ti.stepLon = GeoCoordinate::rad(tileMax.lon.rad() - tileMin.lon.rad());
+	ti.stepLat = GeoCoordinate::rad(tileMax.lat.rad() - tileMin.lat.rad());
+	ti.pixelStepLat = GeoCoordinate::rad(ti.stepLat.rad() / tileH);
+	ti.pixelStepLon = GeoCoordinate::rad(ti.stepLon.rad() / tileW);
+
+	return ti;
+}
+
+/// <summary>
+/// Tile with the same GPS step
+/// </summary>
+/// <param name="lon">[min lon, step lon] in radians</param>
+/// <param name="lat">[min lat, step lat] in radians</param>
+/// <param name="tileW"></param>
+/// <param name="tileH"></param>
+/// <returns></returns>
+template <typename HeightType, typename ProjType>
+TileInfo DEMData<HeightType, ProjType>::CreateTileInfo(const std::pair<double, double> & lon, const std::pair<double, double> & lat, 
+	int tileW, int tileH)
+{
+	TileInfo ti;
+
+	ti.width = tileW;
+	ti.height = tileH;
+	ti.minLon = GeoCoordinate::rad(lon.first);
+	ti.minLat = GeoCoordinate::rad(lat.first);
+	ti.stepLon = GeoCoordinate::rad(lon.second);
+	ti.stepLat = GeoCoordinate::rad(lat.second);
+	ti.pixelStepLat = GeoCoordinate::rad(lat.second / tileH);
+	ti.pixelStepLon = GeoCoordinate::rad(lon.second / tileW);
+
+	return ti;
+}
+
+/// <summary>
+/// Split range [minValue, maxValue) to parts of size step,
+/// last part is shortened to end at maxValue
+/// </summary>
+/// <param name="minValue"></param>
+/// <param name="maxValue"></param>
+/// <param name="step"></param>
+/// <returns>list of [start, step]</returns>
+template <typename HeightType, typename ProjType>
+std::vector<std::pair<double, double>> DEMData<HeightType, ProjType>::CreateTileSteps(double minValue, double maxValue, double step)
+{
+	std::vector<std::pair<double, double>> res;
+
+	for (double v = minValue; v < maxValue; v += step)
+	{
+		bool breakStep = false;
+		if (v + step > maxValue)
+		{
+			step -= ((v + step) - maxValue);
+			breakStep = true;
 		}
 
-		if (breakLat)
+		res.emplace_back(v, step);
+
+		if (breakStep)
 		{
 			break;
 		}
-
-		y++;
 	}
-	
+
+	return res;
 }
 
 /// <summary>
 /// Create single tile with size (w, h)
-/// and fill it with height from GPS with corners (min, max)
+/// and fill it with height from GPS with corners (min, max).
+/// Can be called from more threads at once
 /// </summary>
 /// <param name="w"></param>
 /// <param name="h"></param>
@@ -516,83 +1007,174 @@ void DEMData<HeightType, ProjType>::ProcessTileMap(
 template <typename HeightType, typename ProjType>
 HeightType * DEMData<HeightType, ProjType>::BuildMap(int w, int h, 
 	const Projections::Coordinate & min, const Projections::Coordinate & max, bool keepAR)
+{
+	std::unique_ptr<DEMRequestContext<ProjType>> ctx = this->AcquireContext();
+
+	//projection is published by GetProjection, so each call has new one
+	ctx->projection = std::make_shared<ProjType>();
+
+	HeightType * heightMap = this->BuildMap(*ctx, w, h, min, max, keepAR);
+
+	{
+		std::lock_guard<std::mutex> lock(this->projectionLock);
+		this->projection = ctx->projection;
+	}
+
+	this->ReleaseContext(std::move(ctx));
+
+	return heightMap;
+}
+
+/// <summary>
+/// Create single tile with size (w, h)
+/// and fill it with height from GPS with corners (min, max).
+/// Working state is stored in ctx, so more BuildMap calls
+/// with different contexts can run at the same time
+/// </summary>
+/// <param name="ctx">request context</param>
+/// <param name="w"></param>
+/// <param name="h"></param>
+/// <param name="min"></param>
+/// <param name="max"></param>
+/// <param name="keepAR"></param>
+/// <returns></returns>
+template <typename HeightType, typename ProjType>
+HeightType * DEMData<HeightType, ProjType>::BuildMap(DEMRequestContext<ProjType> & ctx, int w, int h, 
+	const Projections::Coordinate & min, const Projections::Coordinate & max, bool keepAR)
 {
 	if (this->verbose)
 	{
 		printf("BUILD map Lon: %f %f / Lat: %f %f\n", min.lon.deg(), max.lon.deg(), min.lat.deg(), max.lat.deg());
 	}
 		
-	this->projection->SetFrame(min, max, w, h, keepAR);
-		
-	
-
-	coords.clear();
-	tilePixels.clear();
-	//pixelTiles.clear();
-	
+	ProfilerScope buildScope("BuildMap");
 
-	//pixelTiles.resize(w * h, nullptr);
-	
-	
-	for (int y = 0; y < h; y++)
 	{
-		for (int x = 0; x < w; x++)
-		{				
-			Projections::Coordinate c = this->projection->ProjectInverse({ x, y });
-			coords.push_back(c);
-
-			DEMTileInfo * ti = this->GetTile(c);
-			if (ti == nullptr)
-			{
-				continue;
-			}
-
-			//pixelTiles[x + y * w] = ti;
-			tilePixels[ti].push_back(x + y * w);	
-
-			
-		}
+		PROFILE_SCOPE("BuildMap::SetFrame");
+		ctx.projection->SetFrame(min, max, w, h, keepAR);
 	}
 
+	//frame (can be larger than min, max with keepAR) without any DEM tile
+	if (this->HasCoverage(ctx.projection->ProjectInverse({ 0, h }), ctx.projection->ProjectInverse({ w, 0 })) == false)
+	{
+		Profiler::GetInstance().AddCounter("BuildMap::EmptyFrame");
+		return nullptr;
+	}
+		
+	this->CreatePixelsPlan(ctx, w, h);
 	
-	if (tilePixels.size() == 0)
+	if (ctx.tilePixels.size() == 0)
 	{
 		return nullptr;
 	}
 
 	if (this->verbose)
 	{
-		printf("Tiles count: %zu \n", tilePixels.size());
+		printf("Tiles count: %zu \n", ctx.tilePixels.size());
 	}
 
 	HeightType * heightMap = new HeightType[w * h];
 	memset(heightMap, 0, w * h * sizeof(HeightType));
 
 
+	//tiles are loaded (and decompressed) in parallel on decode pool
+	//raw files are read ahead on async reader - each device has its own queue
+	//only limited number of tiles is loaded ahead to keep memory bounded
+	std::vector<std::pair<DEMTileInfo *, std::vector<size_t> *>> tilesOrder;
+	tilesOrder.reserve(ctx.tilePixels.size());
+	for (auto & ti : ctx.tilePixels)
+	{
+		tilesOrder.emplace_back(ti.first, &ti.second);
+	}
+
+	std::vector<DEMTileData> tilesData;
+	tilesData.reserve(tilesOrder.size());
+
+	std::vector<std::future<void>> tilesLoad;
+	tilesLoad.reserve(tilesOrder.size());
+
+	auto loadNext = [&]() {
+		tilesData.emplace_back(this->tilesCache, this->tilesPool.get());
+		
+		DEMTileData * td = &tilesData.back();
+		td->SetTileInfo(tilesOrder[tilesData.size() - 1].first);
+
+		size_t samplesCount = tilesOrder[tilesData.size() - 1].second->size();
+
+		//few samples from random access tile are read one by one
+		bool sparse = td->IsSparseSampling(samplesCount);
+		if (sparse == false)
+		{
+			td->RequestTileData(*this->tilesReader);
+		}
+
+		tilesLoad.push_back(this->decodePool->AddTask([td, sparse]() {
+			if (sparse == false)
+			{
+				td->LoadTileData();
+			}
+		}));
+	};
+
+	size_t loadAhead = 2 * this->decodePool->GetThreadsCount();
+	while ((tilesData.size() < tilesOrder.size()) && (tilesData.size() < loadAhead))
+	{
+		loadNext();
+	}
+
+	std::vector<short> samples;
+
 	int count = 0;
 	int lastProgress = 0;
-	for (auto ti : tilePixels)
+	for (size_t t = 0; t < tilesOrder.size(); t++)
 	{		
-		DEMTileData td(this->tilesCache);
-		td.SetTileInfo(ti.first);
-		
-		//if (ti.second.size() > 10)
 		{
-			td.LoadTileData();
+			PROFILE_SCOPE("BuildMap::TileLoadWait");
+			tilesLoad[t].wait();
 		}
+
+		if (tilesData.size() < tilesOrder.size())
+		{
+			loadNext();
+		}
+
+		DEMTileData & td = tilesData[t];
+		const std::vector<size_t> & pixels = *tilesOrder[t].second;
 		
-		for (size_t i = 0; i < ti.second.size(); i++)
+		if (this->elevMapping == false)
+		{
+			//heights in meters are stored directly
+			PROFILE_SCOPE("BuildMap::Sampling");
+			for (size_t i = 0; i < pixels.size(); i++)
+			{
+				heightMap[pixels[i]] = static_cast<HeightType>(this->GetHeight(ctx, td, pixels[i]));
+			}
+		}
+		else
 		{
-			size_t index = ti.second[i];									
+			samples.resize(pixels.size());
+			{
+				PROFILE_SCOPE("BuildMap::Sampling");
+				for (size_t i = 0; i < pixels.size(); i++)
+				{
+					samples[i] = this->GetHeight(ctx, td, pixels[i]);
+				}
+			}
 
-			heightMap[index] = static_cast<HeightType>(this->GetHeight(td, index));
+			{
+				PROFILE_SCOPE("BuildMap::ElevationMapping");
+				for (size_t i = 0; i < pixels.size(); i++)
+				{
+					heightMap[pixels[i]] = this->MapElevation(samples[i]);
+				}
+			}
 		}
 
-		//td.ReleaseData();	
+		td.ReleaseData();	
 
 		if (this->verbose)
 		{
-			double progress = ((static_cast<double>(count) / tilePixels.size()) * 100.0);
+			double progress = ((static_cast<double>(count) / ctx.tilePixels.size()) * 100.0);
 			if (static_cast<int>(progress) != lastProgress)
 			{
 				printf("\rProgress: %i %%", static_cast<int>(progress));
@@ -626,18 +1208,133 @@ HeightType * DEMData<HeightType, ProjType>::BuildMap(int w, int h,
 	if (this->verbose)
 	{
 		printf("\nMap builded\n");
+
+		if (VFS::GetInstance()->GetStats().IsEnabled())
+		{
+			this->PrintIOStats();
+		}
+	}
+
+	if (this->verbose && Profiler::GetInstance().IsEnabled())
+	{
+		buildScope.Stop();
+		this->PrintProfile();
 	}
 	return heightMap;
 }
 
+/// <summary>
+/// Get unused context for BuildMap without explicit context
+/// (contexts are reused to keep their buffers allocated)
+/// </summary>
+/// <returns></returns>
 template <typename HeightType, typename ProjType>
-Neighbors DEMData<HeightType, ProjType>::GetCoordinateNeighbors(const Projections::Coordinate & c, DEMTileInfo * ti)
+std::unique_ptr<DEMRequestContext<ProjType>> DEMData<HeightType, ProjType>::AcquireContext()
+{
+	{
+		std::lock_guard<std::mutex> lock(this->contextsLock);
+		if (this->freeContexts.empty() == false)
+		{
+			std::unique_ptr<DEMRequestContext<ProjType>> ctx = std::move(this->freeContexts.back());
+			this->freeContexts.pop_back();
+			return ctx;
+		}
+	}
+
+	return std::unique_ptr<DEMRequestContext<ProjType>>(new DEMRequestContext<ProjType>());
+}
+
+template <typename HeightType, typename ProjType>
+void DEMData<HeightType, ProjType>::ReleaseContext(std::unique_ptr<DEMRequestContext<ProjType>> ctx)
+{
+	std::lock_guard<std::mutex> lock(this->contextsLock);
+	this->freeContexts.push_back(std::move(ctx));
+}
+
+/// <summary>
+/// Calculate geo coordinate of each pixel of current projection frame
+/// and group pixels by tile they fall into (coords and tilePixels of ctx)
+/// </summary>
+/// <param name="ctx">request context with projection frame</param>
+/// <param name="w">frame width</param>
+/// <param name="h">frame height</param>
+template <typename HeightType, typename ProjType>
+void DEMData<HeightType, ProjType>::CreatePixelsPlan(DEMRequestContext<ProjType> & ctx, int w, int h)
+{
+	PROFILE_SCOPE("BuildMap::Plan");
+
+	std::vector<Projections::Coordinate> & coords = ctx.coords;
+	std::unordered_map<DEMTileInfo *, std::vector<size_t>> & tilePixels = ctx.tilePixels;
+
+	coords.clear();
+	tilePixels.clear();
+	//pixelTiles.clear();
+	
+
+	//pixelTiles.resize(w * h, nullptr);
+	
+	//phases are interleaved per row, their time is accumulated
+	//and added to profiler summary only
+	bool profile = Profiler::GetInstance().IsEnabled();
+	uint64_t coordsTime = 0;
+	uint64_t lookupTime = 0;
+	uint64_t planTime = 0;
+
+	std::vector<DEMTileInfo *> rowTiles(w);
+	
+	for (int y = 0; y < h; y++)
+	{
+		uint64_t t0 = (profile) ? Profiler::GetTimeUs() : 0;
+
+		size_t rowStart = coords.size();
+		for (int x = 0; x < w; x++)
+		{				
+			coords.push_back(ctx.projection->ProjectInverse({ x, y }));
+		}
+
+		uint64_t t1 = (profile) ? Profiler::GetTimeUs() : 0;
+
+		for (int x = 0; x < w; x++)
+		{
+			rowTiles[x] = this->GetTile(coords[rowStart + x]);
+		}
+
+		uint64_t t2 = (profile) ? Profiler::GetTimeUs() : 0;
+
+		for (int x = 0; x < w; x++)
+		{
+			if (rowTiles[x] == nullptr)
+			{
+				continue;
+			}
+
+			//pixelTiles[x + y * w] = ti;
+			tilePixels[rowTiles[x]].push_back(x + y * w);
+		}
+
+		if (profile)
+		{
+			uint64_t t3 = Profiler::GetTimeUs();
+			coordsTime += t1 - t0;
+			lookupTime += t2 - t1;
+			planTime += t3 - t2;
+		}
+	}
+
+	Profiler::GetInstance().AddTime("BuildMap::Plan::Coordinates", coordsTime, h);
+	Profiler::GetInstance().AddTime("BuildMap::Plan::TileLookup", lookupTime, h);
+	Profiler::GetInstance().AddTime("BuildMap::Plan::PixelLists", planTime, h);
+}
+
+template <typename HeightType, typename ProjType>
+Neighbors DEMData<HeightType, ProjType>::GetCoordinateNeighbors(const DEMRequestContext<ProjType> & ctx, 
+	const Projections::Coordinate & c, DEMTileInfo * ti)
 {
 
 	//double stepLatRad = this->projection->GetStepLat().rad();
 	//double stepLonRad = this->projection->GetStepLon().rad();
 
-	auto step = this->projection->CalcStep(Projections::STEP_TYPE::PIXEL_CENTER);
+	auto step = ctx.projection->CalcStep(Projections::STEP_TYPE::PIXEL_CENTER);
 
 	double stepLatRad = step.lat.rad();
 	double stepLonRad = step.lon.rad();
@@ -688,20 +1385,17 @@ Neighbors DEMData<HeightType, ProjType>::GetCoordinateNeighbors(const Projection
 }
 
 template <typename HeightType, typename ProjType>
-short DEMData<HeightType, ProjType>::GetHeight(DEMTileData & td, size_t index)
+short DEMData<HeightType, ProjType>::GetHeight(const DEMRequestContext<ProjType> & ctx, DEMTileData & td, size_t index)
 {
-	double value = 0;
-
-
-	const Projections::Coordinate & c = coords[index];
-	value = td.GetValue(c);
+	const Projections::Coordinate & c = ctx.coords[index];
+	short value = td.GetValue(c);
 
 	/*
 	//with neighbors
 	int count = 1;
 
 	//get all neighbors for given pixel at [index]
-	auto & n = this->GetCoordinateNeighbors(coords[index], td.GetTileInfo());
+	auto & n = this->GetCoordinateNeighbors(ctx, ctx.coords[index], td.GetTileInfo());
 
 	//printf("Neighbors for %d: %d\n", index, n.neighborCoord.size());
 
@@ -725,6 +1419,18 @@ short DEMData<HeightType, ProjType>::GetHeight(DEMTileData & td, size_t index)
 	value /= count;
 	*/
 
+	return value;
+}
+
+/// <summary>
+/// Convert sampled height to output value
+/// (mapped to full range of HeightType if elevation mapping is enabled)
+/// </summary>
+/// <param name="value">height in meters</param>
+/// <returns>output value</returns>
+template <typename HeightType, typename ProjType>
+HeightType DEMData<HeightType, ProjType>::MapElevation(short value) const
+{
 	if (this->elevMapping == false)
 	{
 		return static_cast<HeightType>(value);
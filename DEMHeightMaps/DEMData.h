@@ -3,6 +3,8 @@
 
 #include <unordered_map>
 #include <memory>
+#include <functional>
+#include <mutex>
 #include <thread>
 #include <vector>
 
@@ -12,8 +14,14 @@
 
 #include "./DEMTile.h"
 #include "./Cache/MemoryCache.h"
+#include "./Cache/BufferPool.h"
+#include "./Utils/ThreadPool.h"
+#include "./Utils/TileOrder.h"
+#include "./Utils/CoverageMask.h"
 #include "./Strings/MyString.h"
 
+class VFSAsyncReader;
+
 typedef std::unordered_map<DEMTileInfo, DEMTileData, hashFunc, equalsFunc> DemTileMap;
 
 typedef struct Neighbors
@@ -22,20 +30,56 @@ typedef struct Neighbors
 	std::unordered_map<DEMTileInfo *, std::vector<size_t>> neighborsCache;
 } Neighbors;
 
+/// <summary>
+/// Working state of single BuildMap request - projection frame
+/// and pixels plan. BuildMap calls running at the same time
+/// must use different contexts (tile catalog and cache are shared).
+/// Context can be reused for next requests, buffers are kept allocated
+/// </summary>
+template <typename ProjType>
+struct DEMRequestContext
+{
+	std::shared_ptr<ProjType> projection;
+	std::vector<Projections::Coordinate> coords; //[pixel] = coords
+	std::unordered_map<DEMTileInfo *, std::vector<size_t>> tilePixels; //[tile] = list of pixels
+
+	DEMRequestContext() : projection(std::make_shared<ProjType>()) {}
+	DEMRequestContext(std::shared_ptr<ProjType> projection) : projection(projection) {}
+};
+
+/// <summary>
+/// Output tile with its position in tile map
+/// </summary>
+typedef struct TileMapItem
+{
+	TileInfo ti;
+	size_t x;
+	size_t y;
+} TileMapItem;
+
+class BuildMapBenchmark;
+
 template <typename HeightType, typename ProjType>
 class DEMData 
 {
 	public:
+		typedef std::function<void(TileInfo & ti, size_t x, size_t y, DEMRequestContext<ProjType> & ctx)> ParallelTileCallback;
 
 		DEMData(std::initializer_list<MyStringAnsi> dirs);
 		DEMData(std::initializer_list<MyStringAnsi> dirs, const MyStringAnsi & tilesInfoXML);
 		~DEMData();
 		
 		std::shared_ptr<ProjType> GetProjection() const;
+		bool HasCoverage(const Projections::Coordinate & min, const Projections::Coordinate & max) const;
 
 		void SetVerboseEnabled(bool val);
+		void SetSkipEmptyTilesEnabled(bool val);
 		void SetElevationMappingEnabled(bool val);
 		void SetMinMaxElevation(double minElev, double maxElev);
+		void SetIOStatsEnabled(bool val, const MyStringAnsi & traceFile = "");
+		void PrintIOStats() const;
+		void SetProfilingEnabled(bool val, const MyStringAnsi & traceFile = "", bool hwCounters = false);
+		void PrintProfile() const;
 
 		void ExportTileList(const MyStringAnsi & fileName);
 		
@@ -43,18 +87,44 @@ class DEMData
 			int totalW, int totalH, int tilesCountX, int tilesCountY,
 			const Projections::Coordinate & min, const Projections::Coordinate & max);
 
+		std::vector<TileMapItem> BuildTileList(
+			int totalW, int totalH, int tilesCountX, int tilesCountY,
+			const Projections::Coordinate & min, const Projections::Coordinate & max,
+			TILE_ORDER order);
+
+		size_t CountTileLoads(const std::vector<TileMapItem> & tiles, size_t cacheTiles);
+		void PrintTileOrderStats(int totalW, int totalH, int tilesCountX, int tilesCountY,
+			const Projections::Coordinate & min, const Projections::Coordinate & max,
+			size_t cacheTiles);
+
 
 		void ProcessTileMap(int totalW, int totalH,
 			int tilesCountX, int tilesCountY,
 			const Projections::Coordinate & min, const Projections::Coordinate & max,
-			std::function<void(TileInfo & ti, size_t, size_t y)> tileCallback);
+			std::function<void(TileInfo & ti, size_t, size_t y)> tileCallback,
+			TILE_ORDER order = TILE_ORDER::ROW_MAJOR);
 
 		void ProcessTileMap(int tileW, int tileH,
 			const Projections::Coordinate & min, const Projections::Coordinate & max,
 			const Projections::Coordinate & tileStep,
-			std::function<void(TileInfo & ti, size_t x, size_t y)> tileCallback);
+			std::function<void(TileInfo & ti, size_t x, size_t y)> tileCallback,
+			TILE_ORDER order = TILE_ORDER::ROW_MAJOR);
+
+		void ProcessTileMapParallel(int totalW, int totalH,
+			int tilesCountX, int tilesCountY,
+			const Projections::Coordinate & min, const Projections::Coordinate & max,
+			ParallelTileCallback tileCallback, 
+			TILE_ORDER order = TILE_ORDER::ROW_MAJOR, size_t threadsCount = 0);
+
+		void ProcessTileMapParallel(int tileW, int tileH,
+			const Projections::Coordinate & min, const Projections::Coordinate & max,
+			const Projections::Coordinate & tileStep,
+			ParallelTileCallback tileCallback, 
+			TILE_ORDER order = TILE_ORDER::ROW_MAJOR, size_t threadsCount = 0);
 
 		HeightType * BuildMap(int w, int h, const Projections::Coordinate & min, const Projections::Coordinate & max, bool keepAR);
+		HeightType * BuildMap(DEMRequestContext<ProjType> & ctx, int w, int h, 
+			const Projections::Coordinate & min, const Projections::Coordinate & max, bool keepAR);
 		
 
 	
@@ -66,6 +136,7 @@ class DEMData
 		const int TILE_SIZE_1 = 3601;
 
 		bool verbose;
+		bool skipEmptyTiles;
 
 		bool elevMapping;
 		double minHeight;
@@ -73,26 +144,55 @@ class DEMData
 
 		//loaded tiles and projection info
 		std::vector<std::vector<DEMTileInfo>> tiles2Dmap; //[geo position][all tiles]
-		std::shared_ptr<ProjType> projection;
+		CoverageMask coverage; //1 degree cells with tiles
+		std::shared_ptr<ProjType> projection; //frame of last BuildMap without explicit context
 
-		//main image tiles
-		std::vector<Projections::Coordinate> coords; //[pixel] = coords		
-		std::unordered_map<DEMTileInfo *, std::vector<size_t>> tilePixels; //[tile] = list of pixels
+		mutable std::mutex projectionLock;
+
+		//contexts of BuildMap without explicit context, reused by later calls
+		std::vector<std::unique_ptr<DEMRequestContext<ProjType>>> freeContexts;
+		std::mutex contextsLock;
 
 	
 		MemoryCache<MyStringAnsi, TileRawData, LRUControl<MyStringAnsi>> * tilesCache;
+		std::shared_ptr<BufferPool> tilesPool;	//decoded tile buffers
+		ThreadPool * decodePool;				//parallel tile loading / decompression
+		VFSAsyncReader * tilesReader;			//read ahead of tile files, queued per device
 		
 		
 
 		void LoadTiles();
+		void BuildCoverageMask();
+		std::unique_ptr<DEMRequestContext<ProjType>> AcquireContext();
+		void ReleaseContext(std::unique_ptr<DEMRequestContext<ProjType>> ctx);
+
+		void CreatePixelsPlan(DEMRequestContext<ProjType> & ctx, int w, int h);
 		void ImportTileList(const MyStringAnsi & fileName);
 
-		Neighbors GetCoordinateNeighbors(const Projections::Coordinate & c, DEMTileInfo * ti);
+		Neighbors GetCoordinateNeighbors(const DEMRequestContext<ProjType> & ctx, const Projections::Coordinate & c, DEMTileInfo * ti);
 
 		DEMTileInfo * GetTile(const Projections::Coordinate & c);
 		void AddTile(const DEMTileInfo & ti);
 
-		short GetHeight(DEMTileData & td, size_t index);
+		void ProcessTiles(size_t countX, size_t countY,
+			const std::function<TileInfo(size_t x, size_t y)> & getTile,
+			const std::function<void(TileInfo & ti, size_t x, size_t y)> & tileCallback,
+			TILE_ORDER order);
+		void ProcessTilesParallel(size_t countX, size_t countY,
+			const std::function<TileInfo(size_t x, size_t y)> & getTile,
+			const ParallelTileCallback & tileCallback,
+			TILE_ORDER order, size_t threadsCount);
+		std::vector<size_t> CreateTileOrder(size_t countX, size_t countY, TILE_ORDER order,
+			const std::function<TileInfo(size_t x, size_t y)> & getTile);
+
+		static TileInfo CreateTileInfo(ProjType & frame, int x, int y, int tileW, int tileH);
+		static TileInfo CreateTileInfo(const std::pair<double, double> & lon, const std::pair<double, double> & lat, int tileW, int tileH);
+		static std::vector<std::pair<double, double>> CreateTileSteps(double minValue, double maxValue, double step);
+
+		short GetHeight(const DEMRequestContext<ProjType> & ctx, DEMTileData & td, size_t index);
+		HeightType MapElevation(short value) const;
+
+		friend class BuildMapBenchmark;
 		
 };
 
@@ -4,37 +4,75 @@
 #include <limits>
 
 #include "./VFS/VFS.h"
+#include "./VFS/PackedFS.h"
+#include "./VFS/VFSAsyncReader.h"
 #include "./Utils/Utils.h"
+#include "./Utils/Profiler.h"
 
 
-DEMTileData::DEMTileData(MemoryCache<MyStringAnsi, TileRawData, LRUControl<MyStringAnsi>> * cache)
-	: cache(cache)
+DEMTileData::DEMTileData(MemoryCache<MyStringAnsi, TileRawData, LRUControl<MyStringAnsi>> * cache, BufferPool * pool)
+	: cache(cache), pool(pool), info(nullptr), randomAccess(false), pendingSize(0)
 {
 	this->data.data = nullptr;
 	this->data.dataSize = 0;
+	this->data.normalized = false;
 }
 
 DEMTileData::~DEMTileData()
 {
-	
+	if (this->pendingRead.valid())
+	{
+		//reader writes to pending buffer until read is finished
+		this->pendingRead.wait();
+	}
 }
 
-/*
+/// <summary>
+/// Release reference to tile data. Data itself are released
+/// when they are not held by cache or other tile
+/// </summary>
 void DEMTileData::ReleaseData()
 {
-	delete[](this->data.data);
+	if (this->pendingRead.valid())
+	{
+		//reader writes to pending buffer until read is finished
+		this->pendingRead.wait();
+		this->pendingRead = std::shared_future<size_t>();
+	}
+	this->pendingBuffer = nullptr;
+
 	this->data.data = nullptr;
 	this->data.dataSize = 0;
+	this->data.owner = nullptr;
+	this->data.normalized = false;
 }
-*/
 
 void DEMTileData::SetTileInfo(DEMTileInfo * info)
 {
 	this->info = info;
-	this->data.data = nullptr;
-	this->data.dataSize = 0;
+	this->randomAccess = (info != nullptr) && (VFS::GetInstance()->IsFileRandomAccess(info->filePath));
+	this->ReleaseData();
 }
 
+/// <summary>
+/// Test if it is cheaper to read samples one by one than to load
+/// entire tile. This is true for random access tiles (compressed by frames
+/// or stored in mapped archive), if there are less samples than frames in tile
+/// (each single read decompresses at most one frame).
+/// Raw files are always loaded at once - each single read would open the file
+/// </summary>
+/// <param name="samplesCount">number of samples taken from tile</param>
+/// <returns></returns>
+bool DEMTileData::IsSparseSampling(size_t samplesCount) const
+{
+	if (this->randomAccess == false)
+	{
+		return false;
+	}
+
+	size_t tileSize = static_cast<size_t>(this->info->width) * this->info->height * sizeof(short);
+	return samplesCount < tileSize / PACKED_FS_FRAME_SIZE;
+}
 DEMTileInfo * DEMTileData::GetTileInfo()
 {
 	return this->info;
@@ -68,9 +106,17 @@ short DEMTileData::GetValue(const Projections::Coordinate & c)
 	//tiles are "horizontally" flipped... [0,0] is at top left, not bottom left, where is minimal lon/lat
 	int index = static_cast<int>(x) + (this->info->height - 1 - static_cast<int>(y)) * this->info->width;
 
-	short value = this->GetValue(index);
+	return this->GetValue(index);
+}
 
-		
+/// <summary>
+/// Convert raw value from file to height
+/// (HGT is stored as big endian, negative values are voids)
+/// </summary>
+/// <param name="value">raw value</param>
+/// <returns>height</returns>
+short DEMTileData::NormalizeValue(short value) const
+{
 	if (this->info->source == TileInfo::HGT)
 	{
 		short b = (value >> 8) & 0xff;  // next byte, bits 8-15
@@ -88,41 +134,123 @@ short DEMTileData::GetValue(const Projections::Coordinate & c)
 	return value;
 }
 
-short DEMTileData::GetValue(int index)
+/// <summary>
+/// Normalize all values of loaded tile in place
+/// Called right after decoding, while data are still hot in cache
+/// </summary>
+void DEMTileData::NormalizeData()
 {
-	short value = 0;
+	size_t count = this->data.dataSize / sizeof(short);
+	short * values = this->data.data;
 
-	if (this->data.data != nullptr)
+	if (this->info->source == TileInfo::HGT)
 	{
-		value = this->data.data[index];
+		for (size_t i = 0; i < count; i++)
+		{
+			uint16_t v = static_cast<uint16_t>(values[i]);
+			short swapped = static_cast<short>((v << 8) | (v >> 8));
+			values[i] = (swapped < 0) ? 0 : swapped;
+		}
 	}
 	else
-	{		
-		if (this->info->isArchived)
+	{
+		for (size_t i = 0; i < count; i++)
 		{
-			this->LoadTileData();
-			value = this->data.data[index];
+			values[i] = (values[i] < 0) ? 0 : values[i];
 		}
-		else 
-		{			
-			FILE * f = VFS::GetInstance()->GetRawFile(this->info->filePath);
-			if (f == nullptr)
+	}
+
+	this->data.normalized = true;
+}
+
+short DEMTileData::GetValue(int index)
+{
+	short value = 0;
+
+	if (this->data.data == nullptr)
+	{		
+		if (this->randomAccess)
+		{
+			//read single value, for compressed files only frame
+			//with value is decompressed
+			if (VFS::GetInstance()->ReadAt(this->info->filePath, index * sizeof(short), sizeof(short), &value) != sizeof(short))
 			{
 				return 0;
 			}
-			
-			fseek(f, index * sizeof(short), SEEK_SET);
-			fread(&value, 1, sizeof(short), f);
 
-			fclose(f);
+			return this->NormalizeValue(value);
+		}
+		
+		this->LoadTileData();
 
-			//VFS::GetInstance()->(vf);
+		if (this->data.data == nullptr)
+		{
+			return 0;
 		}
 	}
 
-	return value;
+	value = this->data.data[index];
+
+	return (this->data.normalized) ? value : this->NormalizeValue(value);
+}
+
+/// <summary>
+/// Start read of entire tile file on async reader. Reads are queued
+/// on device of the file (eg. Voidfill and SRTM roots on different drives)
+/// and ordered by their position on device.
+/// Only uncompressed files, that can not be viewed from mapped archive,
+/// are read this way (raw files, STORED files of unmapped archives),
+/// other files are loaded by LoadTileData directly.
+/// Data are decoded by LoadTileData, once the read is finished
+/// </summary>
+/// <param name="reader">async reader</param>
+void DEMTileData::RequestTileData(VFSAsyncReader & reader)
+{
+	if ((this->data.data != nullptr) || (this->pendingRead.valid()))
+	{
+		return;
+	}
+
+	VFS_LOCATION location;
+	if ((VFS::GetInstance()->GetFileLocation(this->info->filePath, location) == false) ||
+		(location.uncompressed == false) ||
+		(VFS::GetInstance()->IsFileRandomAccess(this->info->filePath)))
+	{
+		return;
+	}
+
+	if (this->cache->GetCopy(this->info->fileName, this->data))
+	{
+		Profiler::GetInstance().AddCounter("TileLoad::CacheHit");
+		return;
+	}
+
+	size_t fileSize = VFS::GetInstance()->GetFileSize(this->info->filePath);
+	std::shared_ptr<void> buf = (fileSize == 0) ? nullptr : this->pool->Acquire(fileSize);
+	if (buf == nullptr)
+	{
+		return;
+	}
+
+	VFS_READ_REQUEST request;
+	request.path = this->info->filePath;
+	request.offset = 0;
+	request.size = fileSize;
+	request.buffer = buf.get();
+
+	this->pendingBuffer = buf;
+	this->pendingSize = fileSize;
+	this->pendingRead = reader.Submit(request).share();
 }
 
+/// <summary>
+/// Load data of entire tile. Data are taken from cache or
+/// viewed directly from mapped archive (stored files) or
+/// decoded into buffer from pool (single-shot inflate for compressed files)
+/// and normalized in place. If read was started by RequestTileData,
+/// its buffer is used.
+/// Can be called for different tiles from multiple threads at once
+/// </summary>
 void DEMTileData::LoadTileData()
 {
 
@@ -130,31 +258,83 @@ void DEMTileData::LoadTileData()
 	{
 		return;
 	}
+
+	PROFILE_SCOPE("TileLoad");
 	
-	auto tmp = this->cache->Get(this->info->fileName);
-	if (tmp != nullptr)
+	if (this->cache->GetCopy(this->info->fileName, this->data))
 	{
-		this->data = *tmp;
+		Profiler::GetInstance().AddCounter("TileLoad::CacheHit");
 		return;
 	}
 
+	Profiler::GetInstance().AddCounter("TileLoad::CacheMiss");
 
-	char * tileData = VFS::GetInstance()->GetFileContent(this->info->filePath, &data.dataSize);
-	
-	this->data.data = reinterpret_cast<short *>(tileData);	
-	
-	auto info = this->cache->Insert(this->info->fileName, this->data, data.dataSize);
-	if (info.itemRemoved)
+
+	size_t cacheSize = 0;
+
+	//try to sample directly from mapped archive - no copy
+	VFS_VIEW view = VFS::GetInstance()->GetFileView(this->info->filePath);
+	if ((view.data != nullptr) && (reinterpret_cast<uintptr_t>(view.data) % alignof(short) == 0))
+	{
+		this->data.data = reinterpret_cast<short *>(const_cast<char *>(view.data));
+		this->data.dataSize = view.size;
+		this->data.owner = view.owner;
+		this->data.normalized = false;
+
+		//data are held by OS page cache, not by our heap
+		cacheSize = sizeof(TileRawData);
+	}
+	else
 	{
-		for (auto tmp : info.removedValue)
+		size_t fileSize = 0;
+		std::shared_ptr<void> buf = nullptr;
+		bool loaded = false;
+
+		if (this->pendingRead.valid())
 		{
-			if (tmp.data == this->data.data)
+			PROFILE_SCOPE("TileLoad::ReadWait");
+
+			fileSize = this->pendingSize;
+			buf = this->pendingBuffer;
+			loaded = (this->pendingRead.get() == fileSize);
+
+			this->pendingRead = std::shared_future<size_t>();
+			this->pendingBuffer = nullptr;
+		}
+		else
+		{
+			fileSize = VFS::GetInstance()->GetFileSize(this->info->filePath);
+			buf = (fileSize == 0) ? nullptr : this->pool->Acquire(fileSize);
+			loaded = (buf != nullptr) && (VFS::GetInstance()->ReadFileData(this->info->filePath, buf.get(), fileSize));
+		}
+
+		if (loaded)
+		{
+			this->data.data = static_cast<short *>(buf.get());
+			this->data.dataSize = fileSize;
+			this->data.owner = buf;
+		}
+		else
+		{
+			//fallback for unsupported archive entries
+			char * tileData = VFS::GetInstance()->GetFileContent(this->info->filePath, &data.dataSize);
+			if (tileData == nullptr)
 			{
-				printf("Problem... releasing currently loaded data\n");
+				return;
 			}
-			delete[] tmp.data;
+
+			this->data.data = reinterpret_cast<short *>(tileData);
+			this->data.owner = std::shared_ptr<void>(tileData, [](void * p) {
+				delete[] static_cast<char *>(p);
+			});
 		}
-	}
 
-}
+		this->NormalizeData();
 
+		cacheSize = data.dataSize;
+	}
+	
+	//removed values are released by their owner,
+	//when the last tile using them is done
+	this->cache->Insert(this->info->fileName, this->data, cacheSize);
+}
@@ -3,6 +3,8 @@
 
 
 #include <atomic>
+#include <future>
+#include <memory>
 #include <unordered_map>
 #include <mutex>
 
@@ -10,9 +12,12 @@
 #include <MapProjection.h>
 
 #include "./Cache/DataCache.h"
+#include "./Cache/BufferPool.h"
 
 #include "./Strings/MyString.h"
 
+class VFSAsyncReader;
+
 //=============================================================================================
 //=============================================================================================
 //=============================================================================================
@@ -100,6 +105,11 @@ typedef struct TileRawData
 	size_t dataSize;
 	short * data;
 
+	std::shared_ptr<void> owner; //lifetime handle of data (pool buffer, mapped file or heap array)
+								 //data are released, when last copy is destroyed
+
+	bool normalized;			 //values are already byte swapped and clamped
+
 	~TileRawData()
 	{
 		//delete[] data;
@@ -113,7 +123,7 @@ class DEMTileData
 {
 	public:
 					
-		DEMTileData(MemoryCache<MyStringAnsi, TileRawData, LRUControl<MyStringAnsi>> * cache);
+		DEMTileData(MemoryCache<MyStringAnsi, TileRawData, LRUControl<MyStringAnsi>> * cache, BufferPool * pool);
 		DEMTileData(DEMTileData const&) = default;
 
 		DEMTileData& operator=(DEMTileData const&) = delete;		
@@ -121,8 +131,10 @@ class DEMTileData
 
 		DEMTileInfo * GetTileInfo();
 
-		//void ReleaseData();
+		void ReleaseData();
+		void RequestTileData(VFSAsyncReader & reader);
 		void LoadTileData();
+		bool IsSparseSampling(size_t samplesCount) const;
 
 		void SetTileInfo(DEMTileInfo * info);
 		short GetValue(const Projections::Coordinate & c);
@@ -132,12 +144,20 @@ class DEMTileData
 		
 		
 		MemoryCache<MyStringAnsi, TileRawData, LRUControl<MyStringAnsi>> * cache;
+		BufferPool * pool;
 		DEMTileInfo * info;
+		bool randomAccess;	//single values can be cheaply read without loading entire tile
 
 		TileRawData data;
+
+		std::shared_future<size_t> pendingRead;	//read of tile file started by RequestTileData
+		std::shared_ptr<void> pendingBuffer;	//target of pending read
+		size_t pendingSize;
 		
 
 		short GetValue(int index);
+		short NormalizeValue(short value) const;
+		void NormalizeData();
 
 		
 };
@@ -0,0 +1,387 @@
+#include "./MBTilesWriter.h"
+
+#include <cstdio>
+#include <climits>
+#include <algorithm>
+
+#ifdef USE_SQLITE
+#include <sqlite3.h>
+#endif
+
+#include "./Strings/MurmurHash3.h"
+
+/// <summary>
+/// ctor
+/// </summary>
+/// <param name="fileName">MBTiles file, created if it does not exist</param>
+/// <param name="batchSize">number of tiles in one transaction</param>
+MBTilesWriter::MBTilesWriter(const MyStringAnsi & fileName, size_t batchSize) :
+	fileName(fileName),
+	batchSize((batchSize == 0) ? 1 : batchSize),
+	db(nullptr),
+	insertMap(nullptr),
+	insertImage(nullptr),
+	selectTile(nullptr),
+	tilesCount(0),
+	pendingCount(0),
+	commitFailed(false),
+	minZoom(INT_MAX),
+	maxZoom(INT_MIN)
+{
+}
+
+MBTilesWriter::~MBTilesWriter()
+{
+	this->Close();
+}
+
+/// <summary>
+/// Open (or create) MBTiles file
+/// Existing tiles are kept, so interrupted generation can continue
+/// </summary>
+/// <param name="name">tileset name stored in metadata</param>
+/// <returns>false if file can not be opened</returns>
+bool MBTilesWriter::Open(const MyStringAnsi & name)
+{
+#ifdef USE_SQLITE
+	std::lock_guard<std::mutex> l(this->lock);
+
+	if (sqlite3_open(this->fileName.c_str(), &this->db) != SQLITE_OK)
+	{
+		printf("[MBTiles] Failed to open %s (%s)\n", this->fileName.c_str(), sqlite3_errmsg(this->db));
+		sqlite3_close(this->db);
+		this->db = nullptr;
+		return false;
+	}
+
+	bool ok = this->Execute("PRAGMA journal_mode = WAL;") &&
+		this->Execute("CREATE TABLE IF NOT EXISTS metadata (name TEXT PRIMARY KEY, value TEXT);") &&
+		this->Execute("CREATE TABLE IF NOT EXISTS images (tile_id TEXT PRIMARY KEY, tile_data BLOB);") &&
+		this->Execute("CREATE TABLE IF NOT EXISTS map (zoom_level INTEGER, tile_column INTEGER, tile_row INTEGER, tile_id TEXT, "
+			"PRIMARY KEY (zoom_level, tile_column, tile_row));") &&
+		this->Execute("CREATE VIEW IF NOT EXISTS tiles AS SELECT map.zoom_level AS zoom_level, map.tile_column AS tile_column, "
+			"map.tile_row AS tile_row, images.tile_data AS tile_data FROM map JOIN images ON images.tile_id = map.tile_id;");
+
+	ok = ok &&
+		(sqlite3_prepare_v2(this->db, "INSERT OR REPLACE INTO map (zoom_level, tile_column, tile_row, tile_id) VALUES (?, ?, ?, ?);",
+			-1, &this->insertMap, nullptr) == SQLITE_OK) &&
+		(sqlite3_prepare_v2(this->db, "INSERT OR IGNORE INTO images (tile_id, tile_data) VALUES (?, ?);",
+			-1, &this->insertImage, nullptr) == SQLITE_OK) &&
+		(sqlite3_prepare_v2(this->db, "SELECT tile_data FROM tiles WHERE zoom_level = ? AND tile_column = ? AND tile_row = ?;",
+			-1, &this->selectTile, nullptr) == SQLITE_OK);
+
+	if (ok == false)
+	{
+		printf("[MBTiles] Failed to create tables in %s (%s)\n", this->fileName.c_str(), sqlite3_errmsg(this->db));
+		return false;
+	}
+
+	//known images - they are not inserted again
+	sqlite3_stmt * stmt = nullptr;
+	if (sqlite3_prepare_v2(this->db, "SELECT tile_id FROM images;", -1, &stmt, nullptr) == SQLITE_OK)
+	{
+		while (sqlite3_step(stmt) == SQLITE_ROW)
+		{
+			this->images.insert(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0)));
+		}
+	}
+	sqlite3_finalize(stmt);
+
+	//name is bound, so it can contain any characters
+	bool nameOk = false;
+	if (sqlite3_prepare_v2(this->db, "INSERT OR REPLACE INTO metadata (name, value) VALUES ('name', ?), ('format', 'png');",
+		-1, &stmt, nullptr) == SQLITE_OK)
+	{
+		sqlite3_bind_text(stmt, 1, name.c_str(), static_cast<int>(name.length()), SQLITE_TRANSIENT);
+		nameOk = (sqlite3_step(stmt) == SQLITE_DONE);
+	}
+	sqlite3_finalize(stmt);
+
+	if (nameOk == false)
+	{
+		printf("[MBTiles] Failed to write metadata to %s (%s)\n", this->fileName.c_str(), sqlite3_errmsg(this->db));
+		return false;
+	}
+
+	return this->Execute("BEGIN;");
+#else
+	(void)name;
+	printf("[MBTiles] Failed to open %s - built without SQLite (USE_SQLITE)\n", this->fileName.c_str());
+	return false;
+#endif
+}
+
+/// <summary>
+/// Commit pending tiles, write zoom range and close file
+/// </summary>
+void MBTilesWriter::Close()
+{
+#ifdef USE_SQLITE
+	std::lock_guard<std::mutex> l(this->lock);
+
+	if (this->db == nullptr)
+	{
+		return;
+	}
+
+	this->WriteZoomMetadata();
+	this->Commit();
+
+	sqlite3_finalize(this->insertMap);
+	sqlite3_finalize(this->insertImage);
+	sqlite3_finalize(this->selectTile);
+	this->insertMap = nullptr;
+	this->insertImage = nullptr;
+	this->selectTile = nullptr;
+
+	sqlite3_close(this->db);
+	this->db = nullptr;
+#endif
+}
+
+/// <summary>
+/// Add tile, image data are stored only if the same image is not stored yet
+/// </summary>
+/// <param name="z"></param>
+/// <param name="x"></param>
+/// <param name="y">y (0 = north)</param>
+/// <param name="data">encoded tile</param>
+/// <returns></returns>
+bool MBTilesWriter::Write(int z, size_t x, size_t y, const std::vector<uint8_t> & data)
+{
+#ifdef USE_SQLITE
+	MyStringAnsi id = CalcTileId(data);
+
+	std::lock_guard<std::mutex> l(this->lock);
+
+	if (this->db == nullptr)
+	{
+		return false;
+	}
+
+	if ((this->images.find(id) == this->images.end()) &&
+		(this->pendingImages.find(id) == this->pendingImages.end()))
+	{
+		sqlite3_bind_text(this->insertImage, 1, id.c_str(), static_cast<int>(id.length()), SQLITE_TRANSIENT);
+		sqlite3_bind_blob(this->insertImage, 2, data.data(), static_cast<int>(data.size()), SQLITE_STATIC);
+
+		int res = sqlite3_step(this->insertImage);
+		sqlite3_reset(this->insertImage);
+		if (res != SQLITE_DONE)
+		{
+			printf("[MBTiles] Failed to insert image %s (%s)\n", id.c_str(), sqlite3_errmsg(this->db));
+			return false;
+		}
+		this->pendingImages.insert(id);
+	}
+
+	sqlite3_bind_int(this->insertMap, 1, z);
+	sqlite3_bind_int64(this->insertMap, 2, static_cast<sqlite3_int64>(x));
+	sqlite3_bind_int64(this->insertMap, 3, static_cast<sqlite3_int64>(GetTmsRow(z, y)));
+	sqlite3_bind_text(this->insertMap, 4, id.c_str(), static_cast<int>(id.length()), SQLITE_TRANSIENT);
+
+	int res = sqlite3_step(this->insertMap);
+	sqlite3_reset(this->insertMap);
+	if (res != SQLITE_DONE)
+	{
+		printf("[MBTiles] Failed to insert tile %d/%zu/%zu (%s)\n", z, x, y, sqlite3_errmsg(this->db));
+		return false;
+	}
+
+	this->tilesCount++;
+	this->minZoom = std::min(this->minZoom, z);
+	this->maxZoom = std::max(this->maxZoom, z);
+
+	this->pendingCount++;
+	if (this->pendingCount >= this->batchSize)
+	{
+		bool ok = this->Commit();
+		return this->Execute("BEGIN;") && ok;
+	}
+
+	return true;
+#else
+	(void)z;
+	(void)x;
+	(void)y;
+	(void)data;
+	return false;
+#endif
+}
+
+bool MBTilesWriter::Read(int z, size_t x, size_t y, std::vector<uint8_t> & data)
+{
+	data.clear();
+
+#ifdef USE_SQLITE
+	std::lock_guard<std::mutex> l(this->lock);
+
+	if (this->db == nullptr)
+	{
+		return false;
+	}
+
+	sqlite3_bind_int(this->selectTile, 1, z);
+	sqlite3_bind_int64(this->selectTile, 2, static_cast<sqlite3_int64>(x));
+	sqlite3_bind_int64(this->selectTile, 3, static_cast<sqlite3_int64>(GetTmsRow(z, y)));
+
+	bool found = false;
+	if (sqlite3_step(this->selectTile) == SQLITE_ROW)
+	{
+		const uint8_t * blob = static_cast<const uint8_t *>(sqlite3_column_blob(this->selectTile, 0));
+		int size = sqlite3_column_bytes(this->selectTile, 0);
+		data.assign(blob, blob + size);
+		found = true;
+	}
+	sqlite3_reset(this->selectTile);
+
+	return found;
+#else
+	(void)z;
+	(void)x;
+	(void)y;
+	return false;
+#endif
+}
+
+/// <summary>
+/// Commit pending tiles
+/// Fails also if any batch committed by Write since last Flush was rolled back
+/// </summary>
+/// <returns></returns>
+bool MBTilesWriter::Flush()
+{
+#ifdef USE_SQLITE
+	std::lock_guard<std::mutex> l(this->lock);
+
+	if (this->db == nullptr)
+	{
+		return false;
+	}
+
+	this->WriteZoomMetadata();
+
+	bool ok = this->Commit() && (this->commitFailed == false);
+	this->commitFailed = false;
+
+	return this->Execute("BEGIN;") && ok;
+#else
+	return false;
+#endif
+}
+
+bool MBTilesWriter::IsBuffered() const
+{
+	return true;
+}
+
+/// <summary>
+/// Number of tiles written since Open
+/// </summary>
+/// <returns></returns>
+size_t MBTilesWriter::GetTilesCount() const
+{
+	std::lock_guard<std::mutex> l(this->lock);
+	return this->tilesCount;
+}
+
+/// <summary>
+/// Number of unique images in file
+/// </summary>
+/// <returns></returns>
+size_t MBTilesWriter::GetImagesCount() const
+{
+	std::lock_guard<std::mutex> l(this->lock);
+	return this->images.size() + this->pendingImages.size();
+}
+
+bool MBTilesWriter::Execute(const char * sql)
+{
+#ifdef USE_SQLITE
+	char * err = nullptr;
+	if (sqlite3_exec(this->db, sql, nullptr, nullptr, &err) != SQLITE_OK)
+	{
+		printf("[MBTiles] %s failed (%s)\n", sql, (err) ? err : "");
+		sqlite3_free(err);
+		return false;
+	}
+	return true;
+#else
+	(void)sql;
+	return false;
+#endif
+}
+
+/// <summary>
+/// Commit open transaction. Images inserted in it are known
+/// only if commit succeeds, otherwise transaction is rolled back
+/// and images are inserted again by later tiles
+/// </summary>
+/// <returns></returns>
+bool MBTilesWriter::Commit()
+{
+	this->pendingCount = 0;
+
+	bool ok = this->Execute("COMMIT;");
+	if (ok)
+	{
+		this->images.insert(this->pendingImages.begin(), this->pendingImages.end());
+	}
+	else
+	{
+#ifdef USE_SQLITE
+		//failed commit can keep transaction open
+		if (sqlite3_get_autocommit(this->db) == 0)
+		{
+			this->Execute("ROLLBACK;");
+		}
+#endif
+		this->commitFailed = true;
+	}
+
+	this->pendingImages.clear();
+
+	return ok;
+}
+
+/// <summary>
+/// Store zoom range of written tiles (merged with range already in file)
+/// </summary>
+void MBTilesWriter::WriteZoomMetadata()
+{
+	if (this->minZoom > this->maxZoom)
+	{
+		return;
+	}
+
+	this->Execute("INSERT OR REPLACE INTO metadata (name, value) VALUES "
+		"('minzoom', (SELECT MIN(zoom_level) FROM map)), "
+		"('maxzoom', (SELECT MAX(zoom_level) FROM map));");
+}
+
+/// <summary>
+/// Image id - MurmurHash3 (128 bit) of data as hex string
+/// </summary>
+/// <param name="data"></param>
+/// <returns></returns>
+MyStringAnsi MBTilesWriter::CalcTileId(const std::vector<uint8_t> & data)
+{
+	uint64_t hash[2];
+	MurmurHash3_x64_128(data.data(), static_cast<int>(data.size()), MURMUR_HASH_DEF_SEED, hash);
+
+	char id[33];
+	snprintf(id, sizeof(id), "%016llx%016llx",
+		static_cast<unsigned long long>(hash[0]), static_cast<unsigned long long>(hash[1]));
+	return id;
+}
+
+/// <summary>
+/// MBTiles rows are TMS - row 0 is at the south
+/// </summary>
+/// <param name="z"></param>
+/// <param name="y">y (0 = north)</param>
+/// <returns></returns>
+size_t MBTilesWriter::GetTmsRow(int z, size_t y)
+{
+	return ((static_cast<size_t>(1) << z) - 1) - y;
+}
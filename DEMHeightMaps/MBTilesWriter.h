@@ -0,0 +1,72 @@
+#ifndef MBTILES_WRITER_H
+#define MBTILES_WRITER_H
+
+#include <cstdint>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+#include "./TileWriter.h"
+#include "./Strings/MyString.h"
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+/// <summary>
+/// Tiles are stored in single MBTiles (SQLite) file.
+/// Deduplicated layout - table map (z, x, y, tile_id) and table images (tile_id, data),
+/// tiles with the same content (eg. flat sea) share one image.
+/// tile_id is MurmurHash3 (128 bit) of tile data.
+/// View tiles (zoom_level, tile_column, tile_row, tile_data) is standard MBTiles interface.
+///
+/// Rows are TMS (row 0 is at the south), zoom z is expected to have 2^z rows.
+/// Inserts are grouped to transactions of batchSize tiles,
+/// tile is persistent once its transaction is committed (or after Flush).
+///
+/// SQLite is used only if USE_SQLITE is defined, otherwise Open fails
+/// </summary>
+class MBTilesWriter : public TileWriter
+{
+	public:
+		MBTilesWriter(const MyStringAnsi & fileName, size_t batchSize = 512);
+		~MBTilesWriter();
+
+		bool Open(const MyStringAnsi & name);
+		void Close();
+
+		bool Write(int z, size_t x, size_t y, const std::vector<uint8_t> & data) override;
+		bool Read(int z, size_t x, size_t y, std::vector<uint8_t> & data) override;
+		bool Flush() override;
+		bool IsBuffered() const override;
+
+		size_t GetTilesCount() const;
+		size_t GetImagesCount() const;
+
+	private:
+		MyStringAnsi fileName;
+		size_t batchSize;
+
+		sqlite3 * db;
+		sqlite3_stmt * insertMap;
+		sqlite3_stmt * insertImage;
+		sqlite3_stmt * selectTile;
+
+		std::unordered_set<MyStringAnsi> images;		//ids of committed images
+		std::unordered_set<MyStringAnsi> pendingImages;	//ids of images inserted in open transaction
+		size_t tilesCount;
+		size_t pendingCount;						//tiles in open transaction
+		bool commitFailed;							//batch was rolled back since last Flush
+		int minZoom;
+		int maxZoom;
+
+		mutable std::mutex lock;
+
+		bool Execute(const char * sql);
+		bool Commit();
+		void WriteZoomMetadata();
+
+		static MyStringAnsi CalcTileId(const std::vector<uint8_t> & data);
+		static size_t GetTmsRow(int z, size_t y);
+};
+
+#endif
@@ -0,0 +1,186 @@
+#include "./TileGenerator.h"
+
+#include <cstring>
+
+#include <MapProjection.h>
+#include <GeoCoordinate.h>
+#include <Projections.h>
+
+#include "./Utils/Profiler.h"
+
+/// <summary>
+/// ctor
+/// </summary>
+/// <param name="dem">source data</param>
+/// <param name="settings">pyramid settings</param>
+template <typename HeightType, typename ProjType>
+TileGenerator<HeightType, ProjType>::TileGenerator(DEMData<HeightType, ProjType> * dem, const TileGeneratorSettings & settings) :
+	dem(dem),
+	settings(settings),
+	verbose(false)
+{
+	int tilesCount = 1 << this->settings.maxZoom;
+	this->frame.SetFrame(this->settings.min, this->settings.max,
+		tilesCount * this->settings.tileSize, tilesCount * this->settings.tileSize, false);
+}
+
+template <typename HeightType, typename ProjType>
+void TileGenerator<HeightType, ProjType>::SetVerboseEnabled(bool val)
+{
+	this->verbose = val;
+}
+
+/// <summary>
+/// Create all tiles of pyramid from minZoom to maxZoom
+/// </summary>
+/// <param name="tileCallback">called for every created tile</param>
+template <typename HeightType, typename ProjType>
+void TileGenerator<HeightType, ProjType>::Generate(TileCallback tileCallback)
+{
+	PROFILE_SCOPE("TileGenerator");
+
+	int tilesCount = 1 << this->settings.minZoom;
+
+	for (int y = 0; y < tilesCount; y++)
+	{
+		for (int x = 0; x < tilesCount; x++)
+		{
+			if (this->verbose)
+			{
+				printf("Pyramid %d/%d/%d (%d of %d)\n", this->settings.minZoom, x, y,
+					x + y * tilesCount + 1, tilesCount * tilesCount);
+			}
+
+			this->CreateTile(this->settings.minZoom, x, y, tileCallback);
+		}
+	}
+}
+
+/// <summary>
+/// Create tile and all its children (depth-first)
+/// </summary>
+/// <param name="z">zoom level</param>
+/// <param name="x">tile x</param>
+/// <param name="y">tile y</param>
+/// <param name="tileCallback">called for every created tile</param>
+/// <returns>tile data or nullptr if tile is empty</returns>
+template <typename HeightType, typename ProjType>
+std::unique_ptr<HeightType[]> TileGenerator<HeightType, ProjType>::CreateTile(int z, int x, int y, TileCallback & tileCallback)
+{
+	//whole subtree is skipped if there is no DEM tile in its area
+	int size = this->settings.tileSize << (this->settings.maxZoom - z);
+
+	Projections::Coordinate tileMin = this->frame.ProjectInverse({ x * size, (y + 1) * size });
+	Projections::Coordinate tileMax = this->frame.ProjectInverse({ (x + 1) * size, y * size });
+
+	if (this->dem->HasCoverage(tileMin, tileMax) == false)
+	{
+		return nullptr;
+	}
+
+	std::unique_ptr<HeightType[]> tile;
+
+	if (z == this->settings.maxZoom)
+	{
+		tile = this->RenderTile(x, y);
+	}
+	else
+	{
+		//[0] = top left, [1] = top right, [2] = bottom left, [3] = bottom right
+		std::unique_ptr<HeightType[]> children[4];
+		children[0] = this->CreateTile(z + 1, 2 * x, 2 * y, tileCallback);
+		children[1] = this->CreateTile(z + 1, 2 * x + 1, 2 * y, tileCallback);
+		children[2] = this->CreateTile(z + 1, 2 * x, 2 * y + 1, tileCallback);
+		children[3] = this->CreateTile(z + 1, 2 * x + 1, 2 * y + 1, tileCallback);
+
+		tile = this->Downsample(children);
+	}
+
+	if (tile != nullptr)
+	{
+		tileCallback(z, x, y, this->settings.tileSize, this->settings.tileSize, tile.get());
+	}
+
+	return tile;
+}
+
+/// <summary>
+/// Build tile of the deepest zoom level from DEM
+/// Tile bounds are calculated in the same way as in DEMData::ProcessTileMap
+/// </summary>
+/// <param name="x">tile x</param>
+/// <param name="y">tile y</param>
+/// <returns>tile data or nullptr if there is no DEM data</returns>
+template <typename HeightType, typename ProjType>
+std::unique_ptr<HeightType[]> TileGenerator<HeightType, ProjType>::RenderTile(int x, int y)
+{
+	PROFILE_SCOPE("TileGenerator::Render");
+
+	int size = this->settings.tileSize;
+
+	Projections::Coordinate tileMin = this->frame.ProjectInverse({ x * size, (y + 1) * size });
+	Projections::Coordinate tileMax = this->frame.ProjectInverse({ (x + 1) * size, y * size });
+
+	return std::unique_ptr<HeightType[]>(this->dem->BuildMap(size, size, tileMin, tileMax, false));
+}
+
+/// <summary>
+/// Create tile from its four children by averaging 2x2 pixel blocks.
+/// Missing children are filled with 0 (same as pixels without DEM in BuildMap)
+/// </summary>
+/// <param name="children">children tiles (top left, top right, bottom left, bottom right)</param>
+/// <returns>tile data or nullptr if all children are empty</returns>
+template <typename HeightType, typename ProjType>
+std::unique_ptr<HeightType[]> TileGenerator<HeightType, ProjType>::Downsample(const std::unique_ptr<HeightType[]> * children) const
+{
+	if ((children[0] == nullptr) && (children[1] == nullptr) &&
+		(children[2] == nullptr) && (children[3] == nullptr))
+	{
+		return nullptr;
+	}
+
+	PROFILE_SCOPE("TileGenerator::Downsample");
+
+	int size = this->settings.tileSize;
+	int half = size / 2;
+
+	std::unique_ptr<HeightType[]> tile(new HeightType[size * size]);
+	memset(tile.get(), 0, size * size * sizeof(HeightType));
+
+	for (int c = 0; c < 4; c++)
+	{
+		const HeightType * child = children[c].get();
+		if (child == nullptr)
+		{
+			continue;
+		}
+
+		int offsetX = (c % 2) * half;
+		int offsetY = (c / 2) * half;
+
+		for (int y = 0; y < half; y++)
+		{
+			const HeightType * row0 = child + (2 * y) * size;
+			const HeightType * row1 = row0 + size;
+			HeightType * out = tile.get() + (offsetY + y) * size + offsetX;
+
+			for (int x = 0; x < half; x++)
+			{
+				int sum = static_cast<int>(row0[2 * x]) + static_cast<int>(row0[2 * x + 1]) +
+					static_cast<int>(row1[2 * x]) + static_cast<int>(row1[2 * x + 1]);
+
+				out[x] = static_cast<HeightType>((sum + 2) / 4);
+			}
+		}
+	}
+
+	return tile;
+}
+
+template class TileGenerator<uint8_t, Projections::Equirectangular>;
+template class TileGenerator<uint16_t, Projections::Equirectangular>;
+template class TileGenerator<short, Projections::Equirectangular>;
+
+template class TileGenerator<uint8_t, Projections::Mercator>;
+template class TileGenerator<uint16_t, Projections::Mercator>;
+template class TileGenerator<short, Projections::Mercator>;
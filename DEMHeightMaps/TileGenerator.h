@@ -0,0 +1,65 @@
+#ifndef TILE_GENERATOR_H
+#define TILE_GENERATOR_H
+
+#include <functional>
+#include <memory>
+
+#include <MapProjection.h>
+#include <GeoCoordinate.h>
+
+#include "./DEMData.h"
+
+/// <summary>
+/// Pyramid settings
+/// Zoom level z has 2^z x 2^z tiles of tileSize x tileSize pixels
+/// covering region (min, max)
+/// </summary>
+typedef struct TileGeneratorSettings
+{
+	int minZoom;
+	int maxZoom;
+	int tileSize;
+
+	Projections::Coordinate min;
+	Projections::Coordinate max;
+
+} TileGeneratorSettings;
+
+/// <summary>
+/// Bottom-up tile pyramid generator.
+/// Only tiles of the deepest zoom level are built from DEM (BuildMap),
+/// tiles of all upper levels are created by 2x2 downsampling (box filter)
+/// of their four children. Pyramid is traversed depth-first, so at most
+/// 4 tiles per level are held in memory and each DEM tile is read
+/// only for the deepest level.
+///
+/// Created tiles are passed to callback (z, x, y, data), y = 0 is at the top (north).
+/// Tiles without any DEM data (eg. sea) are not created and not passed to callback,
+/// subtrees outside of DEM coverage mask are not visited at all
+/// </summary>
+template <typename HeightType, typename ProjType>
+class TileGenerator
+{
+	public:
+		typedef std::function<void(int z, int x, int y, int w, int h, const HeightType * data)> TileCallback;
+
+		TileGenerator(DEMData<HeightType, ProjType> * dem, const TileGeneratorSettings & settings);
+		~TileGenerator() = default;
+
+		void SetVerboseEnabled(bool val);
+
+		void Generate(TileCallback tileCallback);
+
+	private:
+		DEMData<HeightType, ProjType> * dem;
+		TileGeneratorSettings settings;
+		bool verbose;
+
+		ProjType frame;		//projection of the deepest zoom level (whole region)
+
+		std::unique_ptr<HeightType[]> CreateTile(int z, int x, int y, TileCallback & tileCallback);
+		std::unique_ptr<HeightType[]> RenderTile(int x, int y);
+		std::unique_ptr<HeightType[]> Downsample(const std::unique_ptr<HeightType[]> * children) const;
+};
+
+#endif
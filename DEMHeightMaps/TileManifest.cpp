@@ -0,0 +1,234 @@
+#include "./TileManifest.h"
+
+#include <cinttypes>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+
+#include "./Strings/MurmurHash3.h"
+
+/// <summary>
+/// ctor
+/// </summary>
+/// <param name="fileName">manifest file, created if it does not exist</param>
+TileManifest::TileManifest(const MyStringAnsi & fileName) :
+	fileName(fileName),
+	f(nullptr)
+{
+}
+
+TileManifest::~TileManifest()
+{
+	this->Close();
+}
+
+/// <summary>
+/// Load records from existing manifest and open it for appending
+/// </summary>
+/// <returns>false if manifest can not be opened for writing</returns>
+bool TileManifest::Open()
+{
+	std::lock_guard<std::mutex> l(this->lock);
+
+	this->entries.clear();
+
+	//incomplete last line (crash during write) has no new line
+	bool complete = true;
+
+	FILE * in = nullptr;
+	my_fopen(&in, this->fileName.c_str(), "r");
+	if (in != nullptr)
+	{
+		char line[256];
+		size_t invalid = 0;
+		while (fgets(line, sizeof(line), in) != nullptr)
+		{
+			int z = 0;
+			unsigned long long x = 0;
+			unsigned long long y = 0;
+			char hash[32];
+			int end = 0;
+
+			complete = (strchr(line, '\n') != nullptr);
+
+			if ((complete == false) || 
+				(sscanf(line, "%d %llu %llu %31s %n", &z, &x, &y, hash, &end) != 4) ||
+				(line[end] != '\0') || (IsValidHash(hash) == false))
+			{
+				invalid++;
+				continue;
+			}
+
+			TileManifestEntry entry;
+			entry.empty = (strcmp(hash, "-") == 0);
+			entry.hash = (entry.empty) ? 0 : strtoull(hash, nullptr, 16);
+
+			this->entries[GetKey(z, static_cast<size_t>(x), static_cast<size_t>(y))] = entry;
+		}
+		fclose(in);
+
+		if (invalid > 0)
+		{
+			printf("Manifest %s: %zu invalid lines ignored\n", this->fileName.c_str(), invalid);
+		}
+	}
+
+	my_fopen(&this->f, this->fileName.c_str(), "a");
+	if (this->f == nullptr)
+	{
+		printf("Failed to open manifest %s\n", this->fileName.c_str());
+		return false;
+	}
+
+	if (complete == false)
+	{
+		//new records must not continue incomplete line
+		fputc('\n', this->f);
+		fflush(this->f);
+	}
+
+	return true;
+}
+
+void TileManifest::Close()
+{
+	std::lock_guard<std::mutex> l(this->lock);
+
+	if (this->f != nullptr)
+	{
+		fclose(this->f);
+		this->f = nullptr;
+	}
+}
+
+/// <summary>
+/// Find record of tile
+/// </summary>
+/// <param name="z"></param>
+/// <param name="x"></param>
+/// <param name="y"></param>
+/// <param name="entry">found record</param>
+/// <returns>true if tile was completed</returns>
+bool TileManifest::Find(int z, size_t x, size_t y, TileManifestEntry & entry) const
+{
+	std::lock_guard<std::mutex> l(this->lock);
+
+	auto it = this->entries.find(GetKey(z, x, y));
+	if (it == this->entries.end())
+	{
+		return false;
+	}
+
+	entry = it->second;
+	return true;
+}
+
+size_t TileManifest::GetCount() const
+{
+	std::lock_guard<std::mutex> l(this->lock);
+	return this->entries.size();
+}
+
+/// <summary>
+/// Record completed tile, data are content of written file
+/// </summary>
+/// <param name="z"></param>
+/// <param name="x"></param>
+/// <param name="y"></param>
+/// <param name="data">written file</param>
+void TileManifest::Add(int z, size_t x, size_t y, const std::vector<uint8_t> & data)
+{
+	this->Add(z, x, y, CalcHash(data.data(), data.size()));
+}
+
+/// <summary>
+/// Record written tile with already calculated hash (see CalcHash)
+/// </summary>
+/// <param name="z"></param>
+/// <param name="x"></param>
+/// <param name="y"></param>
+/// <param name="hash">hash of written file</param>
+void TileManifest::Add(int z, size_t x, size_t y, uint64_t hash)
+{
+	TileManifestEntry entry;
+	entry.empty = false;
+	entry.hash = hash;
+
+	this->Append(z, x, y, entry);
+}
+
+/// <summary>
+/// Record completed tile without data
+/// </summary>
+/// <param name="z"></param>
+/// <param name="x"></param>
+/// <param name="y"></param>
+void TileManifest::AddEmpty(int z, size_t x, size_t y)
+{
+	TileManifestEntry entry;
+	entry.empty = true;
+	entry.hash = 0;
+
+	this->Append(z, x, y, entry);
+}
+
+uint64_t TileManifest::CalcHash(const uint8_t * data, size_t size)
+{
+	uint64_t hash[2];
+	MurmurHash3_x64_128(data, static_cast<int>(size), MURMUR_HASH_DEF_SEED, hash);
+	return hash[0];
+}
+
+void TileManifest::Append(int z, size_t x, size_t y, const TileManifestEntry & entry)
+{
+	std::lock_guard<std::mutex> l(this->lock);
+
+	this->entries[GetKey(z, x, y)] = entry;
+
+	if (this->f == nullptr)
+	{
+		return;
+	}
+
+	if (entry.empty)
+	{
+		fprintf(this->f, "%d %zu %zu -\n", z, x, y);
+	}
+	else
+	{
+		fprintf(this->f, "%d %zu %zu %016" PRIx64 "\n", z, x, y, entry.hash);
+	}
+	fflush(this->f);
+}
+
+/// <summary>
+/// Hash is "-" or 16 hex digits
+/// </summary>
+/// <param name="hash"></param>
+/// <returns></returns>
+bool TileManifest::IsValidHash(const char * hash)
+{
+	if (strcmp(hash, "-") == 0)
+	{
+		return true;
+	}
+
+	if (strlen(hash) != 16)
+	{
+		return false;
+	}
+
+	for (int i = 0; i < 16; i++)
+	{
+		if (isxdigit(static_cast<unsigned char>(hash[i])) == 0)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+uint64_t TileManifest::GetKey(int z, size_t x, size_t y)
+{
+	return (static_cast<uint64_t>(z) << 58) | (static_cast<uint64_t>(x) << 29) | static_cast<uint64_t>(y);
+}
@@ -0,0 +1,62 @@
+#ifndef TILE_MANIFEST_H
+#define TILE_MANIFEST_H
+
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "./Strings/MyString.h"
+
+/// <summary>
+/// Manifest record of single output tile
+/// </summary>
+typedef struct TileManifestEntry
+{
+	bool empty;			//tile has no data, nothing was written
+	uint64_t hash;		//hash of written file
+} TileManifestEntry;
+
+/// <summary>
+/// Append-only checkpoint of completed output tiles.
+/// Every line is "z x y hash" (hash = 16 hex digits of written file, 
+/// "-" for tile without data). Line is flushed when tile is completed,
+/// so after crash only the last (incomplete) line can be lost and it is ignored.
+/// Later record of the same tile replaces earlier one.
+///
+/// Tiles are identified by position only, so manifest is valid
+/// for any number of threads and any tile order
+/// </summary>
+class TileManifest
+{
+	public:
+		TileManifest(const MyStringAnsi & fileName);
+		~TileManifest();
+
+		bool Open();
+		void Close();
+
+		bool Find(int z, size_t x, size_t y, TileManifestEntry & entry) const;
+		size_t GetCount() const;
+
+		void Add(int z, size_t x, size_t y, const std::vector<uint8_t> & data);
+		void Add(int z, size_t x, size_t y, uint64_t hash);
+		void AddEmpty(int z, size_t x, size_t y);
+
+		static uint64_t CalcHash(const uint8_t * data, size_t size);
+
+	private:
+		MyStringAnsi fileName;
+		FILE * f;
+
+		std::unordered_map<uint64_t, TileManifestEntry> entries;
+		mutable std::mutex lock;
+
+		void Append(int z, size_t x, size_t y, const TileManifestEntry & entry);
+
+		static bool IsValidHash(const char * hash);
+		static uint64_t GetKey(int z, size_t x, size_t y);
+};
+
+#endif
@@ -0,0 +1,511 @@
+#include "./TilePipeline.h"
+
+#include <cstdio>
+#include <thread>
+#include <type_traits>
+
+#include <MapProjection.h>
+#include <GeoCoordinate.h>
+#include <Projections.h>
+
+#include "./Utils/Profiler.h"
+
+/// <summary>
+/// ctor
+/// </summary>
+/// <param name="dem">source data</param>
+/// <param name="settings">pipeline settings</param>
+template <typename HeightType, typename ProjType>
+TilePipeline<HeightType, ProjType>::TilePipeline(DEMData<HeightType, ProjType> * dem, const TilePipelineSettings & settings) :
+	dem(dem),
+	settings(settings),
+	verbose(false),
+	manifest(nullptr),
+	writer(nullptr),
+	zoom(0),
+	memory(settings.memoryLimit),
+	skippedCount(0),
+	sampledCount(0),
+	emptyCount(0),
+	writtenCount(0),
+	failedCount(0),
+	writtenBytes(0)
+{
+	if (this->settings.sampleThreads <= 0)
+	{
+		this->settings.sampleThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+	}
+	if (this->settings.encodeThreads <= 0)
+	{
+		this->settings.encodeThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+	}
+	this->settings.writeThreads = std::max(1, this->settings.writeThreads);
+
+	PNGEncoder png(this->settings.png);
+	if (this->settings.encoding == TILE_ENCODING::TERRAIN_RGB)
+	{
+		this->encoder = [png](int w, int h, const HeightType * data, std::vector<uint8_t> & out) {
+			return TilePipeline<HeightType, ProjType>::EncodeTerrainRGB(png, w, h, data, out);
+		};
+	}
+	else
+	{
+		this->encoder = [png](int w, int h, const HeightType * data, std::vector<uint8_t> & out) {
+			return TilePipeline<HeightType, ProjType>::EncodePNG(png, w, h, data, out);
+		};
+	}
+}
+
+template <typename HeightType, typename ProjType>
+void TilePipeline<HeightType, ProjType>::SetEncoder(Encoder encoder)
+{
+	this->encoder = encoder;
+}
+
+template <typename HeightType, typename ProjType>
+void TilePipeline<HeightType, ProjType>::SetVerboseEnabled(bool val)
+{
+	this->verbose = val;
+}
+
+/// <summary>
+/// Set opened manifest of completed tiles (not owned by pipeline),
+/// nullptr = all tiles are built
+/// </summary>
+/// <param name="manifest"></param>
+template <typename HeightType, typename ProjType>
+void TilePipeline<HeightType, ProjType>::SetManifest(TileManifest * manifest)
+{
+	this->manifest = manifest;
+}
+
+/// <summary>
+/// Set output backend used by Run without output directory (not owned by pipeline)
+/// </summary>
+/// <param name="writer"></param>
+template <typename HeightType, typename ProjType>
+void TilePipeline<HeightType, ProjType>::SetWriter(TileWriter * writer)
+{
+	this->writer = writer;
+}
+
+/// <summary>
+/// Default encoder - greyscale PNG,
+/// 8-bit for uint8_t heights, 16-bit for other types
+/// </summary>
+/// <param name="png">PNG encoder</param>
+/// <param name="w">tile width</param>
+/// <param name="h">tile height</param>
+/// <param name="data">tile heights</param>
+/// <param name="out">encoded file</param>
+/// <returns>true if tile was encoded</returns>
+template <typename HeightType, typename ProjType>
+bool TilePipeline<HeightType, ProjType>::EncodePNG(const PNGEncoder & png, int w, int h, const HeightType * data, std::vector<uint8_t> & out)
+{
+	if (sizeof(HeightType) == 1)
+	{
+		return png.EncodeGrey8(w, h, reinterpret_cast<const uint8_t *>(data), out);
+	}
+
+	if (std::is_same<HeightType, short>::value)
+	{
+		//signed heights - negative values (below sea level) are clamped to 0
+		return png.EncodeGrey16(w, h, reinterpret_cast<const short *>(data), out);
+	}
+
+	return png.EncodeGrey16(w, h, reinterpret_cast<const uint16_t *>(data), out);
+}
+
+/// <summary>
+/// Terrain-RGB encoder - heights are packed to 24 bits (0.1 m steps)
+/// Short heights are encoded directly, other types are converted to short
+/// </summary>
+/// <param name="png">PNG encoder</param>
+/// <param name="w">tile width</param>
+/// <param name="h">tile height</param>
+/// <param name="data">tile heights in meters</param>
+/// <param name="out">encoded file</param>
+/// <returns>true if tile was encoded</returns>
+template <typename HeightType, typename ProjType>
+bool TilePipeline<HeightType, ProjType>::EncodeTerrainRGB(const PNGEncoder & png, int w, int h, const HeightType * data, std::vector<uint8_t> & out)
+{
+	if (std::is_same<HeightType, short>::value)
+	{
+		return png.EncodeTerrainRGB(w, h, reinterpret_cast<const short *>(data), out);
+	}
+
+	std::vector<short> heights(static_cast<size_t>(w) * h);
+	for (size_t i = 0; i < heights.size(); i++)
+	{
+		heights[i] = static_cast<short>(data[i]);
+	}
+	return png.EncodeTerrainRGB(w, h, heights.data(), out);
+}
+
+/// <summary>
+/// Build all tiles of tile map and write them to outputDir/x/y.png
+/// (same layout as tiles of BuildTileMap written one by one).
+/// Tiles without DEM data are not written
+/// </summary>
+/// <param name="totalW">width of whole map</param>
+/// <param name="totalH">height of whole map</param>
+/// <param name="tilesCountX">number of tiles in x</param>
+/// <param name="tilesCountY">number of tiles in y</param>
+/// <param name="min">min corner of map</param>
+/// <param name="max">max corner of map</param>
+/// <param name="outputDir">output directory</param>
+/// <param name="zoom">zoom level of tiles (used in manifest)</param>
+/// <returns>true if all tiles were written</returns>
+template <typename HeightType, typename ProjType>
+bool TilePipeline<HeightType, ProjType>::Run(int totalW, int totalH, int tilesCountX, int tilesCountY,
+	const Projections::Coordinate & min, const Projections::Coordinate & max,
+	const MyStringAnsi & outputDir, int zoom)
+{
+	TileWriter * oldWriter = this->writer;
+
+	DirectoryTileWriter dirWriter(outputDir, false);
+	this->writer = &dirWriter;
+
+	bool res = this->Run(totalW, totalH, tilesCountX, tilesCountY, min, max, zoom);
+
+	this->writer = oldWriter;
+	return res;
+}
+
+/// <summary>
+/// Build all tiles of tile map and write them with writer set by SetWriter.
+/// Tiles without DEM data are not written
+/// </summary>
+/// <param name="totalW">width of whole map</param>
+/// <param name="totalH">height of whole map</param>
+/// <param name="tilesCountX">number of tiles in x</param>
+/// <param name="tilesCountY">number of tiles in y</param>
+/// <param name="min">min corner of map</param>
+/// <param name="max">max corner of map</param>
+/// <param name="zoom">zoom level of tiles (used in manifest and writer)</param>
+/// <returns>true if all tiles were written</returns>
+template <typename HeightType, typename ProjType>
+bool TilePipeline<HeightType, ProjType>::Run(int totalW, int totalH, int tilesCountX, int tilesCountY,
+	const Projections::Coordinate & min, const Projections::Coordinate & max,
+	int zoom)
+{
+	PROFILE_SCOPE("Pipeline");
+
+	TileWriter * writer = this->writer;
+	if (writer == nullptr)
+	{
+		printf("Pipeline: no tile writer is set\n");
+		return false;
+	}
+
+	this->zoom = zoom;
+	this->skippedCount = 0;
+	this->sampledCount = 0;
+	this->emptyCount = 0;
+	this->writtenCount = 0;
+	this->failedCount = 0;
+	this->writtenBytes = 0;
+	this->pending.clear();
+
+	//plan - tile bounds are calculated before sampling starts
+	std::vector<TileMapItem> tiles;
+	{
+		PROFILE_SCOPE("Pipeline::Plan");
+		tiles = this->dem->BuildTileList(totalW, totalH, tilesCountX, tilesCountY, min, max, this->settings.order);
+	}
+
+	BoundedQueue<SampleJob> sampleQueue(this->settings.queueSize);
+	BoundedQueue<EncodeJob> encodeQueue(this->settings.queueSize);
+	BoundedQueue<WriteJob> writeQueue(this->settings.queueSize);
+
+	std::vector<std::thread> sampleWorkers;
+	std::vector<std::thread> encodeWorkers;
+	std::vector<std::thread> writeWorkers;
+
+	for (int i = 0; i < this->settings.sampleThreads; i++)
+	{
+		sampleWorkers.emplace_back(&TilePipeline::SampleWorker, this, std::ref(sampleQueue), std::ref(encodeQueue));
+	}
+	for (int i = 0; i < this->settings.encodeThreads; i++)
+	{
+		encodeWorkers.emplace_back(&TilePipeline::EncodeWorker, this, std::ref(encodeQueue), std::ref(writeQueue));
+	}
+	for (int i = 0; i < this->settings.writeThreads; i++)
+	{
+		writeWorkers.emplace_back(&TilePipeline::WriteWorker, this, std::ref(writeQueue), writer);
+	}
+
+	size_t totalCount = 0;
+	for (const TileMapItem & tile : tiles)
+	{
+		if (this->IsCompleted(tile, writer))
+		{
+			this->skippedCount++;
+			continue;
+		}
+
+		SampleJob job;
+		job.ti = tile.ti;
+		job.x = tile.x;
+		job.y = tile.y;
+
+		//height map + BuildMap plan (coordinate and index of each pixel)
+		size_t pixels = static_cast<size_t>(job.ti.width) * job.ti.height;
+		job.memory = pixels * (sizeof(HeightType) + sizeof(Projections::Coordinate) + sizeof(size_t));
+
+		this->memory.Acquire(job.memory);
+		sampleQueue.Push(std::move(job));
+		totalCount++;
+	}
+
+	sampleQueue.Close();
+	for (auto & t : sampleWorkers)
+	{
+		t.join();
+	}
+
+	encodeQueue.Close();
+	for (auto & t : encodeWorkers)
+	{
+		t.join();
+	}
+
+	writeQueue.Close();
+	for (auto & t : writeWorkers)
+	{
+		t.join();
+	}
+
+	this->Flush(writer);
+
+	if (this->verbose)
+	{
+		printf("Pipeline: %zu tiles, %zu completed before, %zu empty, %zu written (%.2f MB), %zu failed, peak memory %.2f MB\n",
+			totalCount, this->skippedCount.load(), this->emptyCount.load(), this->writtenCount.load(),
+			this->writtenBytes.load() / (1024.0 * 1024.0), this->failedCount.load(),
+			this->memory.GetPeak() / (1024.0 * 1024.0));
+	}
+
+	return this->failedCount == 0;
+}
+
+/// <summary>
+/// Test if tile was completed by previous run (recorded in manifest).
+/// With verifyExisting, written tile must exist and match recorded hash
+/// </summary>
+/// <param name="tile">tile</param>
+/// <param name="writer">output backend</param>
+/// <returns>true if tile can be skipped</returns>
+template <typename HeightType, typename ProjType>
+bool TilePipeline<HeightType, ProjType>::IsCompleted(const TileMapItem & tile, TileWriter * writer) const
+{
+	if (this->manifest == nullptr)
+	{
+		return false;
+	}
+
+	TileManifestEntry entry;
+	if (this->manifest->Find(this->zoom, tile.x, tile.y, entry) == false)
+	{
+		return false;
+	}
+
+	if ((entry.empty) || (this->settings.verifyExisting == false))
+	{
+		return true;
+	}
+
+	std::vector<uint8_t> data;
+	if (writer->Read(this->zoom, tile.x, tile.y, data) == false)
+	{
+		printf("Tile %d/%zu/%zu from manifest is missing\n", this->zoom, tile.x, tile.y);
+		return false;
+	}
+
+	if (TileManifest::CalcHash(data.data(), data.size()) != entry.hash)
+	{
+		printf("Tile %d/%zu/%zu does not match manifest\n", this->zoom, tile.x, tile.y);
+		return false;
+	}
+
+	return true;
+}
+
+template <typename HeightType, typename ProjType>
+void TilePipeline<HeightType, ProjType>::SampleWorker(BoundedQueue<SampleJob> & input, BoundedQueue<EncodeJob> & output)
+{
+	DEMRequestContext<ProjType> ctx;
+
+	SampleJob job;
+	while (input.Pop(job))
+	{
+		HeightType * data = nullptr;
+		{
+			PROFILE_SCOPE("Pipeline::Sample");
+			data = this->dem->BuildMap(ctx, job.ti.width, job.ti.height, job.ti.GetCorner(0), job.ti.GetCorner(3), false);
+		}
+
+		size_t mapMemory = static_cast<size_t>(job.ti.width) * job.ti.height * sizeof(HeightType);
+
+		if (data == nullptr)
+		{
+			//empty - all is water probably
+			this->emptyCount++;
+			if (this->manifest != nullptr)
+			{
+				this->manifest->AddEmpty(this->zoom, job.x, job.y);
+			}
+			this->memory.Release(job.memory);
+			continue;
+		}
+
+		this->sampledCount++;
+
+		//plan is not needed anymore
+		this->memory.Release(job.memory - mapMemory);
+
+		EncodeJob encodeJob;
+		encodeJob.x = job.x;
+		encodeJob.y = job.y;
+		encodeJob.w = job.ti.width;
+		encodeJob.h = job.ti.height;
+		encodeJob.data = std::unique_ptr<HeightType[]>(data);
+		encodeJob.memory = mapMemory;
+
+		output.Push(std::move(encodeJob));
+	}
+}
+
+/// <summary>
+/// Encode stage
+/// </summary>
+/// <param name="input">tiles to encode</param>
+/// <param name="output">encoded tiles</param>
+template <typename HeightType, typename ProjType>
+void TilePipeline<HeightType, ProjType>::EncodeWorker(BoundedQueue<EncodeJob> & input, BoundedQueue<WriteJob> & output)
+{
+	EncodeJob job;
+	while (input.Pop(job))
+	{
+		WriteJob writeJob;
+		writeJob.x = job.x;
+		writeJob.y = job.y;
+
+		bool ok = false;
+		{
+			PROFILE_SCOPE("Pipeline::Encode");
+			ok = this->encoder(job.w, job.h, job.data.get(), writeJob.data);
+		}
+
+		job.data = nullptr;
+		this->memory.Release(job.memory);
+
+		if (ok == false)
+		{
+			printf("Failed to encode tile %zu/%zu\n", job.x, job.y);
+			this->failedCount++;
+			continue;
+		}
+
+		//encoded tile was already admitted, it can not wait for memory
+		writeJob.memory = writeJob.data.size();
+		this->memory.Add(writeJob.memory);
+
+		output.Push(std::move(writeJob));
+	}
+}
+
+/// <summary>
+/// Write stage - pass encoded tiles to writer
+/// </summary>
+/// <param name="input">encoded tiles</param>
+/// <param name="writer">output backend</param>
+template <typename HeightType, typename ProjType>
+void TilePipeline<HeightType, ProjType>::WriteWorker(BoundedQueue<WriteJob> & input, TileWriter * writer)
+{
+	WriteJob job;
+	while (input.Pop(job))
+	{
+		PROFILE_SCOPE("Pipeline::Write");
+
+		bool ok = writer->Write(this->zoom, job.x, job.y, job.data);
+
+		if (ok)
+		{
+			this->writtenCount++;
+			this->writtenBytes += job.data.size();
+		}
+		else
+		{
+			this->failedCount++;
+		}
+
+		if ((ok) && (this->manifest != nullptr))
+		{
+			uint64_t hash = TileManifest::CalcHash(job.data.data(), job.data.size());
+
+			if (writer->IsBuffered() == false)
+			{
+				this->manifest->Add(this->zoom, job.x, job.y, hash);
+			}
+			else
+			{
+				size_t pendingCount = 0;
+				{
+					std::lock_guard<std::mutex> lock(this->pendingLock);
+					this->pending.push_back({ job.x, job.y, hash });
+					pendingCount = this->pending.size();
+				}
+
+				if (pendingCount >= this->settings.flushCount)
+				{
+					this->Flush(writer);
+				}
+			}
+		}
+
+		this->memory.Release(job.memory);
+	}
+}
+
+/// <summary>
+/// Flush writer and record pending tiles to manifest.
+/// Tiles of buffered writer are recorded only if flush succeeded,
+/// so manifest never contains tile that is not persistent
+/// </summary>
+/// <param name="writer">output backend</param>
+/// <returns>true if flush succeeded</returns>
+template <typename HeightType, typename ProjType>
+bool TilePipeline<HeightType, ProjType>::Flush(TileWriter * writer)
+{
+	//held during flush, so tiles are recorded in the order of flushes
+	std::lock_guard<std::mutex> lock(this->pendingLock);
+
+	std::vector<PendingTile> tiles;
+	tiles.swap(this->pending);
+
+	if (writer->Flush() == false)
+	{
+		printf("Pipeline: failed to flush written tiles\n");
+		this->failedCount += std::max<size_t>(tiles.size(), 1);
+		return false;
+	}
+
+	if (this->manifest != nullptr)
+	{
+		for (const PendingTile & t : tiles)
+		{
+			this->manifest->Add(this->zoom, t.x, t.y, t.hash);
+		}
+	}
+
+	return true;
+}
+
+template class TilePipeline<uint8_t, Projections::Equirectangular>;
+template class TilePipeline<uint16_t, Projections::Equirectangular>;
+template class TilePipeline<short, Projections::Equirectangular>;
+
+template class TilePipeline<uint8_t, Projections::Mercator>;
+template class TilePipeline<uint16_t, Projections::Mercator>;
+template class TilePipeline<short, Projections::Mercator>;
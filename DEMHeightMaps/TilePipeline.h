@@ -0,0 +1,163 @@
+#ifndef TILE_PIPELINE_H
+#define TILE_PIPELINE_H
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <MapProjection.h>
+#include <GeoCoordinate.h>
+
+#include "./DEMData.h"
+#include "./TileManifest.h"
+#include "./TileWriter.h"
+#include "./Utils/BoundedQueue.h"
+#include "./Utils/MemoryBudget.h"
+#include "./Utils/PNGEncoder.h"
+#include "./Strings/MyString.h"
+
+/// <summary>
+/// Default tile encoding
+/// GREY - greyscale PNG, 8-bit for uint8_t heights, 16-bit for other types
+/// TERRAIN_RGB - Mapbox Terrain-RGB PNG, heights must be in meters (elevation mapping disabled)
+/// </summary>
+enum class TILE_ENCODING { GREY = 0, TERRAIN_RGB = 1 };
+
+/// <summary>
+/// Pipeline settings
+/// </summary>
+typedef struct TilePipelineSettings
+{
+	int sampleThreads;		//BuildMap workers, 0 = number of HW threads
+	int encodeThreads;		//encoder workers, 0 = number of HW threads
+	int writeThreads;		//file writers
+	size_t queueSize;		//max tiles waiting between two stages
+	size_t memoryLimit;		//ceiling for tiles in flight (height maps, BuildMap plans, encoded files)
+	TILE_ORDER order;		//order in which tiles enter sample stage
+	bool verifyExisting;	//completed tiles from manifest are skipped only if their file matches recorded hash
+	TILE_ENCODING encoding;	//default encoder
+	PNGEncoderSettings png;	//settings of default encoder
+	size_t flushCount;		//buffered writer (eg. MBTiles) is flushed after this number of tiles,
+							//tiles are recorded to manifest only after flush
+
+	TilePipelineSettings() :
+		sampleThreads(0),
+		encodeThreads(0),
+		writeThreads(1),
+		queueSize(16),
+		memoryLimit(CACHE_SIZE_GB(1)),
+		order(TILE_ORDER::HILBERT),
+		verifyExisting(false),
+		encoding(TILE_ENCODING::GREY),
+		flushCount(512)
+	{}
+
+} TilePipelineSettings;
+
+/// <summary>
+/// Pipelined tile generation: plan -> sample -> encode -> write.
+/// Tiles from BuildTileList (plan stage, in settings.order) are built with BuildMap
+/// (sample stage), encoded (PNG by default) and written with TileWriter
+/// (outputDir/x/y.png or writer set by SetWriter).
+/// Every stage has its own workers and stages are connected
+/// with bounded queues, so faster stages wait for slower ones.
+/// Tile is admitted to sample stage only if its memory
+/// fits into memoryLimit, memory is released when tile is written.
+///
+/// Each sample worker has its own DEMData request context,
+/// so BuildMap calls run in parallel
+///
+/// With manifest, every written (or empty) tile is recorded
+/// and tiles completed by previous runs are skipped
+/// </summary>
+template <typename HeightType, typename ProjType>
+class TilePipeline
+{
+	public:
+		typedef std::function<bool(int w, int h, const HeightType * data, std::vector<uint8_t> & out)> Encoder;
+
+		TilePipeline(DEMData<HeightType, ProjType> * dem, const TilePipelineSettings & settings);
+		~TilePipeline() = default;
+
+		void SetEncoder(Encoder encoder);
+		void SetVerboseEnabled(bool val);
+		void SetManifest(TileManifest * manifest);
+		void SetWriter(TileWriter * writer);
+
+		bool Run(int totalW, int totalH, int tilesCountX, int tilesCountY,
+			const Projections::Coordinate & min, const Projections::Coordinate & max,
+			const MyStringAnsi & outputDir, int zoom = 0);
+
+		bool Run(int totalW, int totalH, int tilesCountX, int tilesCountY,
+			const Projections::Coordinate & min, const Projections::Coordinate & max,
+			int zoom);
+
+		static bool EncodePNG(const PNGEncoder & png, int w, int h, const HeightType * data, std::vector<uint8_t> & out);
+		static bool EncodeTerrainRGB(const PNGEncoder & png, int w, int h, const HeightType * data, std::vector<uint8_t> & out);
+
+	private:
+		typedef struct SampleJob
+		{
+			TileInfo ti;
+			size_t x;
+			size_t y;
+			size_t memory;		//reserved memory of tile
+		} SampleJob;
+
+		typedef struct EncodeJob
+		{
+			size_t x;
+			size_t y;
+			int w;
+			int h;
+			std::unique_ptr<HeightType[]> data;
+			size_t memory;
+		} EncodeJob;
+
+		typedef struct WriteJob
+		{
+			size_t x;
+			size_t y;
+			std::vector<uint8_t> data;
+			size_t memory;
+		} WriteJob;
+
+		typedef struct PendingTile
+		{
+			size_t x;
+			size_t y;
+			uint64_t hash;		//manifest hash of written file
+		} PendingTile;
+
+		DEMData<HeightType, ProjType> * dem;
+		TilePipelineSettings settings;
+		Encoder encoder;
+		bool verbose;
+
+		TileManifest * manifest;
+		TileWriter * writer;
+		int zoom;				//zoom of current Run (manifest and writer key)
+
+		MemoryBudget memory;
+
+		std::vector<PendingTile> pending;	//written, but not flushed tiles of buffered writer
+		std::mutex pendingLock;
+
+		std::atomic<size_t> skippedCount;
+		std::atomic<size_t> sampledCount;
+		std::atomic<size_t> emptyCount;
+		std::atomic<size_t> writtenCount;
+		std::atomic<size_t> failedCount;
+		std::atomic<uint64_t> writtenBytes;
+
+		bool IsCompleted(const TileMapItem & tile, TileWriter * writer) const;
+
+		void SampleWorker(BoundedQueue<SampleJob> & input, BoundedQueue<EncodeJob> & output);
+		void EncodeWorker(BoundedQueue<EncodeJob> & input, BoundedQueue<WriteJob> & output);
+		void WriteWorker(BoundedQueue<WriteJob> & input, TileWriter * writer);
+		bool Flush(TileWriter * writer);
+};
+
+#endif
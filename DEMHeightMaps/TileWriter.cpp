@@ -0,0 +1,96 @@
+#include "./TileWriter.h"
+
+#include <cstdio>
+
+#include "./VFS/OSUtils.h"
+
+/// <summary>
+/// ctor
+/// </summary>
+/// <param name="dir">output directory</param>
+/// <param name="zoomDirs">tiles are in zoom directories dir/z/x/y.png</param>
+DirectoryTileWriter::DirectoryTileWriter(const MyStringAnsi & dir, bool zoomDirs) :
+	dir(dir),
+	zoomDirs(zoomDirs)
+{
+	if (this->dir.GetLastChar() != '/')
+	{
+		this->dir += '/';
+	}
+}
+
+bool DirectoryTileWriter::Write(int z, size_t x, size_t y, const std::vector<uint8_t> & data)
+{
+	MyStringAnsi outPath = this->GetDir(z, x);
+
+	{
+		std::lock_guard<std::mutex> lock(this->dirsLock);
+		if (this->createdDirs.insert(outPath).second)
+		{
+			std::shared_ptr<OSUtils> os = OSUtils::Instance();
+			if (os != nullptr)
+			{
+				os->CreatePath(outPath);
+			}
+		}
+	}
+
+	MyStringAnsi filePath = outPath;
+	filePath += static_cast<int>(y);
+	filePath += ".png";
+
+	FILE * f = nullptr;
+	my_fopen(&f, filePath.c_str(), "wb");
+
+	bool ok = (f != nullptr) && (fwrite(data.data(), 1, data.size(), f) == data.size());
+	if (f != nullptr)
+	{
+		ok = (fclose(f) == 0) && ok;
+	}
+
+	if (ok == false)
+	{
+		printf("Failed to write tile %s\n", filePath.c_str());
+	}
+
+	return ok;
+}
+
+bool DirectoryTileWriter::Read(int z, size_t x, size_t y, std::vector<uint8_t> & data)
+{
+	MyStringAnsi filePath = this->GetDir(z, x);
+	filePath += static_cast<int>(y);
+	filePath += ".png";
+
+	data.clear();
+
+	FILE * f = nullptr;
+	my_fopen(&f, filePath.c_str(), "rb");
+	if (f == nullptr)
+	{
+		return false;
+	}
+
+	uint8_t buf[64 * 1024];
+	size_t read = 0;
+	while ((read = fread(buf, 1, sizeof(buf), f)) > 0)
+	{
+		data.insert(data.end(), buf, buf + read);
+	}
+	fclose(f);
+
+	return true;
+}
+
+MyStringAnsi DirectoryTileWriter::GetDir(int z, size_t x) const
+{
+	MyStringAnsi outPath = this->dir;
+	if (this->zoomDirs)
+	{
+		outPath += z;
+		outPath += '/';
+	}
+	outPath += static_cast<int>(x);
+	outPath += '/';
+	return outPath;
+}
@@ -0,0 +1,61 @@
+#ifndef TILE_WRITER_H
+#define TILE_WRITER_H
+
+#include <cstdint>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+#include "./Strings/MyString.h"
+
+/// <summary>
+/// Output backend for encoded tiles.
+/// Write and Read can be called from more threads at once
+/// </summary>
+class TileWriter
+{
+	public:
+		virtual ~TileWriter() = default;
+
+		virtual bool Write(int z, size_t x, size_t y, const std::vector<uint8_t> & data) = 0;
+		virtual bool Read(int z, size_t x, size_t y, std::vector<uint8_t> & data) = 0;
+
+		/// <summary>
+		/// Make all written tiles persistent
+		/// </summary>
+		/// <returns></returns>
+		virtual bool Flush() { return true; }
+
+		/// <summary>
+		/// Written tiles are persistent only after successful Flush
+		/// (otherwise they are persistent when Write returns)
+		/// </summary>
+		/// <returns></returns>
+		virtual bool IsBuffered() const { return false; }
+};
+
+/// <summary>
+/// Every tile is single file dir/z/x/y.png
+/// (or dir/x/y.png without zoom directories)
+/// Directories are created with OSUtils (if initialized), otherwise they must exist
+/// </summary>
+class DirectoryTileWriter : public TileWriter
+{
+	public:
+		DirectoryTileWriter(const MyStringAnsi & dir, bool zoomDirs = true);
+		~DirectoryTileWriter() = default;
+
+		bool Write(int z, size_t x, size_t y, const std::vector<uint8_t> & data) override;
+		bool Read(int z, size_t x, size_t y, std::vector<uint8_t> & data) override;
+
+	private:
+		MyStringAnsi dir;
+		bool zoomDirs;
+
+		std::unordered_set<MyStringAnsi> createdDirs;
+		std::mutex dirsLock;
+
+		MyStringAnsi GetDir(int z, size_t x) const;
+};
+
+#endif
@@ -0,0 +1,120 @@
+#ifndef BOUNDED_QUEUE_H
+#define BOUNDED_QUEUE_H
+
+#include <queue>
+#include <mutex>
+#include <condition_variable>
+
+/// <summary>
+/// Thread-safe FIFO queue with limited capacity.
+/// Push blocks while queue is full (backpressure to producer),
+/// Pop blocks while queue is empty.
+/// After Close, Push fails and Pop returns remaining items and then fails
+/// </summary>
+template <typename T>
+class BoundedQueue
+{
+	public:
+		BoundedQueue(size_t capacity);
+		~BoundedQueue() = default;
+
+		bool Push(T && item);
+		bool Pop(T & item);
+
+		void Close();
+		size_t GetSize() const;
+
+	private:
+		std::queue<T> items;
+		size_t capacity;
+		bool closed;
+
+		mutable std::mutex lock;
+		std::condition_variable notFull;
+		std::condition_variable notEmpty;
+};
+
+/// <summary>
+/// ctor
+/// </summary>
+/// <param name="capacity">max number of items in queue (at least 1)</param>
+template <typename T>
+BoundedQueue<T>::BoundedQueue(size_t capacity) :
+	capacity((capacity == 0) ? 1 : capacity),
+	closed(false)
+{
+}
+
+/// <summary>
+/// Add item, wait while queue is full
+/// </summary>
+/// <param name="item">added item</param>
+/// <returns>false if queue was closed</returns>
+template <typename T>
+bool BoundedQueue<T>::Push(T && item)
+{
+	std::unique_lock<std::mutex> l(this->lock);
+	this->notFull.wait(l, [&]() {
+		return this->closed || (this->items.size() < this->capacity);
+	});
+
+	if (this->closed)
+	{
+		return false;
+	}
+
+	this->items.push(std::move(item));
+	l.unlock();
+
+	this->notEmpty.notify_one();
+	return true;
+}
+
+/// <summary>
+/// Remove item, wait while queue is empty
+/// </summary>
+/// <param name="item">removed item</param>
+/// <returns>false if queue is closed and empty</returns>
+template <typename T>
+bool BoundedQueue<T>::Pop(T & item)
+{
+	std::unique_lock<std::mutex> l(this->lock);
+	this->notEmpty.wait(l, [&]() {
+		return this->closed || (this->items.empty() == false);
+	});
+
+	if (this->items.empty())
+	{
+		return false;
+	}
+
+	item = std::move(this->items.front());
+	this->items.pop();
+	l.unlock();
+
+	this->notFull.notify_one();
+	return true;
+}
+
+/// <summary>
+/// No more items will be added, waiting consumers are woken up
+/// </summary>
+template <typename T>
+void BoundedQueue<T>::Close()
+{
+	{
+		std::lock_guard<std::mutex> l(this->lock);
+		this->closed = true;
+	}
+	this->notFull.notify_all();
+	this->notEmpty.notify_all();
+}
+
+template <typename T>
+size_t BoundedQueue<T>::GetSize() const
+{
+	std::lock_guard<std::mutex> l(this->lock);
+	return this->items.size();
+}
+
+#endif
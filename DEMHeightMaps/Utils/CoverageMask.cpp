@@ -0,0 +1,177 @@
+#include "./CoverageMask.h"
+
+#include <algorithm>
+#include <cmath>
+
+/// <summary>
+/// ctor - empty mask
+/// </summary>
+CoverageMask::CoverageMask()
+{
+	this->Clear();
+}
+
+void CoverageMask::Clear()
+{
+	this->levels.clear();
+	for (int size = GRID_SIZE; size > 0; size /= 2)
+	{
+		this->levels.emplace_back((static_cast<size_t>(size) * size + 63) / 64, 0);
+	}
+}
+
+/// <summary>
+/// Set all cells touched by area. Build must be called after all areas are added
+/// </summary>
+/// <param name="minLonDeg"></param>
+/// <param name="minLatDeg"></param>
+/// <param name="maxLonDeg"></param>
+/// <param name="maxLatDeg"></param>
+void CoverageMask::AddArea(double minLonDeg, double minLatDeg, double maxLonDeg, double maxLatDeg)
+{
+	int x0 = GetCellX(std::min(minLonDeg, maxLonDeg));
+	int x1 = GetCellX(std::max(minLonDeg, maxLonDeg));
+	int y0 = GetCellY(std::min(minLatDeg, maxLatDeg));
+	int y1 = GetCellY(std::max(minLatDeg, maxLatDeg));
+
+	for (int y = y0; y <= y1; y++)
+	{
+		for (int x = x0; x <= x1; x++)
+		{
+			this->SetBit(0, x, y);
+		}
+	}
+}
+
+/// <summary>
+/// Create quadtree levels from cells
+/// </summary>
+void CoverageMask::Build()
+{
+	for (size_t level = 1; level < this->levels.size(); level++)
+	{
+		std::fill(this->levels[level].begin(), this->levels[level].end(), 0);
+
+		int size = GRID_SIZE >> level;
+		for (int y = 0; y < size; y++)
+		{
+			for (int x = 0; x < size; x++)
+			{
+				int l = static_cast<int>(level) - 1;
+				if (this->GetBit(l, 2 * x, 2 * y) || this->GetBit(l, 2 * x + 1, 2 * y) ||
+					this->GetBit(l, 2 * x, 2 * y + 1) || this->GetBit(l, 2 * x + 1, 2 * y + 1))
+				{
+					this->SetBit(static_cast<int>(level), x, y);
+				}
+			}
+		}
+	}
+}
+
+/// <summary>
+/// Test if there are no cells with data in area
+/// </summary>
+/// <param name="minLonDeg"></param>
+/// <param name="minLatDeg"></param>
+/// <param name="maxLonDeg"></param>
+/// <param name="maxLatDeg"></param>
+/// <returns>true if area has no data</returns>
+bool CoverageMask::IsEmpty(double minLonDeg, double minLatDeg, double maxLonDeg, double maxLatDeg) const
+{
+	int x0 = GetCellX(std::min(minLonDeg, maxLonDeg));
+	int x1 = GetCellX(std::max(minLonDeg, maxLonDeg));
+	int y0 = GetCellY(std::min(minLatDeg, maxLatDeg));
+	int y1 = GetCellY(std::max(minLatDeg, maxLatDeg));
+
+	return this->IsEmpty(static_cast<int>(this->levels.size()) - 1, 0, 0, x0, y0, x1, y1);
+}
+
+/// <summary>
+/// Number of 1 degree cells with data
+/// </summary>
+/// <returns></returns>
+size_t CoverageMask::GetCellsCount() const
+{
+	size_t count = 0;
+	for (uint64_t v : this->levels[0])
+	{
+		for (; v != 0; v &= (v - 1))
+		{
+			count++;
+		}
+	}
+	return count;
+}
+
+bool CoverageMask::GetBit(int level, int x, int y) const
+{
+	size_t index = static_cast<size_t>(x) + static_cast<size_t>(y) * (GRID_SIZE >> level);
+	return ((this->levels[level][index / 64] >> (index % 64)) & 1) != 0;
+}
+
+void CoverageMask::SetBit(int level, int x, int y)
+{
+	size_t index = static_cast<size_t>(x) + static_cast<size_t>(y) * (GRID_SIZE >> level);
+	this->levels[level][index / 64] |= (uint64_t(1) << (index % 64));
+}
+
+/// <summary>
+/// Test quadtree node (x, y) at level against cells range [x0, x1] x [y0, y1]
+/// </summary>
+/// <param name="level">node level</param>
+/// <param name="x">node x</param>
+/// <param name="y">node y</param>
+/// <param name="x0">first cell x</param>
+/// <param name="y0">first cell y</param>
+/// <param name="x1">last cell x</param>
+/// <param name="y1">last cell y</param>
+/// <returns>true if node has no data in range</returns>
+bool CoverageMask::IsEmpty(int level, int x, int y, int x0, int y0, int x1, int y1) const
+{
+	if (this->GetBit(level, x, y) == false)
+	{
+		return true;
+	}
+
+	//cells covered by node
+	int nx0 = x << level;
+	int ny0 = y << level;
+	int nx1 = nx0 + (1 << level) - 1;
+	int ny1 = ny0 + (1 << level) - 1;
+
+	if ((nx1 < x0) || (nx0 > x1) || (ny1 < y0) || (ny0 > y1))
+	{
+		return true;
+	}
+
+	if ((nx0 >= x0) && (nx1 <= x1) && (ny0 >= y0) && (ny1 <= y1))
+	{
+		//node with data is inside range
+		return false;
+	}
+
+	for (int cy = 0; cy < 2; cy++)
+	{
+		for (int cx = 0; cx < 2; cx++)
+		{
+			if (this->IsEmpty(level - 1, 2 * x + cx, 2 * y + cy, x0, y0, x1, y1) == false)
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+int CoverageMask::GetCellX(double lonDeg)
+{
+	int x = static_cast<int>(std::floor(lonDeg + 180.0));
+	return std::min(std::max(x, 0), 359);
+}
+
+int CoverageMask::GetCellY(double latDeg)
+{
+	int y = static_cast<int>(std::floor(latDeg + 90.0));
+	return std::min(std::max(y, 0), 179);
+}
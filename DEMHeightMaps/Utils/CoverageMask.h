@@ -0,0 +1,44 @@
+#ifndef COVERAGE_MASK_H
+#define COVERAGE_MASK_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+/// <summary>
+/// Hierarchical mask of 1 degree cells with data.
+/// Level 0 is bitmap of cells (lon, lat), every upper level
+/// is quadtree level - cell is set if any of its 4 children is set.
+/// Empty area is found by descending only into set cells
+/// that overlap the query, so large empty areas (sea) are rejected at coarse levels.
+///
+/// Query is conservative - cell touched by area (even by its border) is set
+/// </summary>
+class CoverageMask
+{
+	public:
+		CoverageMask();
+		~CoverageMask() = default;
+
+		void Clear();
+		void AddArea(double minLonDeg, double minLatDeg, double maxLonDeg, double maxLatDeg);
+		void Build();
+
+		bool IsEmpty(double minLonDeg, double minLatDeg, double maxLonDeg, double maxLatDeg) const;
+		size_t GetCellsCount() const;
+
+	private:
+		static const int GRID_SIZE = 512; //power of 2 that fits 360 x 180 cells
+
+		std::vector<std::vector<uint64_t>> levels; //[level][bit] = cell (x + y * size of level)
+
+		bool GetBit(int level, int x, int y) const;
+		void SetBit(int level, int x, int y);
+
+		bool IsEmpty(int level, int x, int y, int x0, int y0, int x1, int y1) const;
+
+		static int GetCellX(double lonDeg);
+		static int GetCellY(double latDeg);
+};
+
+#endif
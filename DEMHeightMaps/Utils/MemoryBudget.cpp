@@ -0,0 +1,62 @@
+#include "./MemoryBudget.h"
+
+#include <algorithm>
+
+/// <summary>
+/// ctor
+/// </summary>
+/// <param name="limit">memory ceiling in bytes</param>
+MemoryBudget::MemoryBudget(size_t limit) :
+	limit(limit),
+	used(0),
+	peak(0)
+{
+}
+
+/// <summary>
+/// Wait until memory is available and reserve it.
+/// Request larger than limit is admitted when nothing else is reserved
+/// </summary>
+/// <param name="bytes">reserved bytes</param>
+void MemoryBudget::Acquire(size_t bytes)
+{
+	std::unique_lock<std::mutex> l(this->lock);
+	this->released.wait(l, [&]() {
+		return (this->used == 0) || (this->used + bytes <= this->limit);
+	});
+
+	this->used += bytes;
+	this->peak = std::max(this->peak, this->used);
+}
+
+/// <summary>
+/// Reserve memory without waiting (limit can be exceeded)
+/// </summary>
+/// <param name="bytes">reserved bytes</param>
+void MemoryBudget::Add(size_t bytes)
+{
+	std::lock_guard<std::mutex> l(this->lock);
+	this->used += bytes;
+	this->peak = std::max(this->peak, this->used);
+}
+
+void MemoryBudget::Release(size_t bytes)
+{
+	{
+		std::lock_guard<std::mutex> l(this->lock);
+		this->used -= std::min(bytes, this->used);
+	}
+	this->released.notify_all();
+}
+
+size_t MemoryBudget::GetUsed() const
+{
+	std::lock_guard<std::mutex> l(this->lock);
+	return this->used;
+}
+
+size_t MemoryBudget::GetPeak() const
+{
+	std::lock_guard<std::mutex> l(this->lock);
+	return this->peak;
+}
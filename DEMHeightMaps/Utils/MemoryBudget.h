@@ -0,0 +1,36 @@
+#ifndef MEMORY_BUDGET_H
+#define MEMORY_BUDGET_H
+
+#include <cstddef>
+#include <mutex>
+#include <condition_variable>
+
+/// <summary>
+/// Global memory ceiling shared by more threads.
+/// Acquire blocks until requested memory fits into limit,
+/// Add always succeeds (for memory that is created by work already admitted,
+/// so it can not deadlock with consumers that would release memory)
+/// </summary>
+class MemoryBudget
+{
+	public:
+		MemoryBudget(size_t limit);
+		~MemoryBudget() = default;
+
+		void Acquire(size_t bytes);
+		void Add(size_t bytes);
+		void Release(size_t bytes);
+
+		size_t GetUsed() const;
+		size_t GetPeak() const;
+
+	private:
+		size_t limit;
+		size_t used;
+		size_t peak;
+
+		mutable std::mutex lock;
+		std::condition_variable released;
+};
+
+#endif
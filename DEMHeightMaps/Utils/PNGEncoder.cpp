@@ -0,0 +1,366 @@
+#include "./PNGEncoder.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <zlib.h>
+
+/// <summary>
+/// ctor
+/// </summary>
+/// <param name="settings">compression settings</param>
+PNGEncoder::PNGEncoder(const PNGEncoderSettings & settings) :
+	settings(settings)
+{
+	if (this->settings.compressionLevel < 0)
+	{
+		this->settings.compressionLevel = 0;
+	}
+	else if (this->settings.compressionLevel > 9)
+	{
+		this->settings.compressionLevel = 9;
+	}
+}
+
+const PNGEncoderSettings & PNGEncoder::GetSettings() const
+{
+	return this->settings;
+}
+
+/// <summary>
+/// Encode 8-bit greyscale image
+/// </summary>
+/// <param name="w">image width</param>
+/// <param name="h">image height</param>
+/// <param name="data">w * h values, rows from top</param>
+/// <param name="out">encoded file</param>
+/// <returns>true if image was encoded</returns>
+bool PNGEncoder::EncodeGrey8(int w, int h, const uint8_t * data, std::vector<uint8_t> & out) const
+{
+	return this->Encode(w, h, 8, 1, data, out);
+}
+
+/// <summary>
+/// Encode 16-bit greyscale image
+/// </summary>
+/// <param name="w">image width</param>
+/// <param name="h">image height</param>
+/// <param name="data">w * h values in native byte order, rows from top</param>
+/// <param name="out">encoded file</param>
+/// <returns>true if image was encoded</returns>
+bool PNGEncoder::EncodeGrey16(int w, int h, const uint16_t * data, std::vector<uint8_t> & out) const
+{
+	//PNG stores 16-bit values as big endian
+	std::vector<uint8_t> be(static_cast<size_t>(w) * h * 2);
+	for (size_t i = 0; i < static_cast<size_t>(w) * h; i++)
+	{
+		be[2 * i] = static_cast<uint8_t>(data[i] >> 8);
+		be[2 * i + 1] = static_cast<uint8_t>(data[i] & 0xFF);
+	}
+
+	return this->Encode(w, h, 16, 1, be.data(), out);
+}
+
+/// <summary>
+/// Encode heights in meters as 16-bit greyscale image
+/// Negative heights are stored as 0
+/// </summary>
+/// <param name="w">image width</param>
+/// <param name="h">image height</param>
+/// <param name="heights">w * h heights, rows from top</param>
+/// <param name="out">encoded file</param>
+/// <returns>true if image was encoded</returns>
+bool PNGEncoder::EncodeGrey16(int w, int h, const short * heights, std::vector<uint8_t> & out) const
+{
+	std::vector<uint8_t> be(static_cast<size_t>(w) * h * 2);
+	for (size_t i = 0; i < static_cast<size_t>(w) * h; i++)
+	{
+		uint16_t v = (heights[i] < 0) ? 0 : static_cast<uint16_t>(heights[i]);
+		be[2 * i] = static_cast<uint8_t>(v >> 8);
+		be[2 * i + 1] = static_cast<uint8_t>(v & 0xFF);
+	}
+
+	return this->Encode(w, h, 16, 1, be.data(), out);
+}
+
+/// <summary>
+/// Encode 8-bit RGB image
+/// </summary>
+/// <param name="w">image width</param>
+/// <param name="h">image height</param>
+/// <param name="data">w * h * 3 values (RGB), rows from top</param>
+/// <param name="out">encoded file</param>
+/// <returns>true if image was encoded</returns>
+bool PNGEncoder::EncodeRGB8(int w, int h, const uint8_t * data, std::vector<uint8_t> & out) const
+{
+	return this->Encode(w, h, 8, 3, data, out);
+}
+
+/// <summary>
+/// Encode heights in meters as Terrain-RGB image
+/// </summary>
+/// <param name="w">image width</param>
+/// <param name="h">image height</param>
+/// <param name="heights">w * h heights, rows from top</param>
+/// <param name="out">encoded file</param>
+/// <returns>true if image was encoded</returns>
+bool PNGEncoder::EncodeTerrainRGB(int w, int h, const short * heights, std::vector<uint8_t> & out) const
+{
+	std::vector<uint8_t> rgb(static_cast<size_t>(w) * h * 3);
+	for (size_t i = 0; i < static_cast<size_t>(w) * h; i++)
+	{
+		PackTerrainRGB(heights[i], rgb.data() + 3 * i);
+	}
+
+	return this->Encode(w, h, 8, 3, rgb.data(), out);
+}
+
+/// <summary>
+/// Pack height to Terrain-RGB pixel, value is height in 0.1 m steps from -10000 m.
+/// Heights are whole meters, so no rounding is needed, heights below -10000 m are clamped
+/// </summary>
+/// <param name="height">height in meters</param>
+/// <param name="rgb">output pixel</param>
+void PNGEncoder::PackTerrainRGB(short height, uint8_t * rgb)
+{
+	int32_t h = (height < -10000) ? -10000 : height;
+	uint32_t v = static_cast<uint32_t>((h + 10000) * 10);
+
+	rgb[0] = static_cast<uint8_t>(v >> 16);
+	rgb[1] = static_cast<uint8_t>((v >> 8) & 0xFF);
+	rgb[2] = static_cast<uint8_t>(v & 0xFF);
+}
+
+/// <summary>
+/// Filter rows, deflate them to single IDAT and create file
+/// </summary>
+/// <param name="w">image width</param>
+/// <param name="h">image height</param>
+/// <param name="bitDepth">8 or 16</param>
+/// <param name="channels">1 (greyscale) or 3 (RGB)</param>
+/// <param name="data">rows of image (16-bit values are big endian)</param>
+/// <param name="out">encoded file</param>
+/// <returns>true if image was encoded</returns>
+bool PNGEncoder::Encode(int w, int h, int bitDepth, int channels, const uint8_t * data, std::vector<uint8_t> & out) const
+{
+	out.clear();
+
+	if ((w <= 0) || (h <= 0) || (data == nullptr))
+	{
+		return false;
+	}
+
+	const size_t bpp = (bitDepth / 8) * channels;
+	const size_t rowSize = static_cast<size_t>(w) * bpp;
+
+	//filtered rows - filter type byte + row
+	std::vector<uint8_t> filtered(static_cast<size_t>(h) * (rowSize + 1));
+
+	std::vector<uint8_t> zeroRow(rowSize, 0);
+	std::vector<uint8_t> candidate;
+	if (this->settings.filter == PNG_FILTER::ADAPTIVE)
+	{
+		candidate.resize(rowSize + 1);
+	}
+
+	for (int y = 0; y < h; y++)
+	{
+		const uint8_t * row = data + y * rowSize;
+		const uint8_t * prevRow = (y == 0) ? zeroRow.data() : row - rowSize;
+		uint8_t * dst = filtered.data() + y * (rowSize + 1);
+
+		if (this->settings.filter != PNG_FILTER::ADAPTIVE)
+		{
+			dst[0] = static_cast<uint8_t>(this->settings.filter);
+			FilterRow(this->settings.filter, bpp, rowSize, row, prevRow, dst + 1);
+			continue;
+		}
+
+		//minimum sum of absolute differences heuristic (PNG specification)
+		uint64_t bestCost = UINT64_MAX;
+		for (int f = static_cast<int>(PNG_FILTER::NONE); f <= static_cast<int>(PNG_FILTER::PAETH); f++)
+		{
+			FilterRow(static_cast<PNG_FILTER>(f), bpp, rowSize, row, prevRow, candidate.data() + 1);
+
+			uint64_t cost = GetRowCost(candidate.data() + 1, rowSize);
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				candidate[0] = static_cast<uint8_t>(f);
+				memcpy(dst, candidate.data(), rowSize + 1);
+			}
+		}
+	}
+
+	int strategy = Z_DEFAULT_STRATEGY;
+	switch (this->settings.strategy)
+	{
+		case PNG_STRATEGY::FILTERED: strategy = Z_FILTERED; break;
+		case PNG_STRATEGY::RLE: strategy = Z_RLE; break;
+		case PNG_STRATEGY::HUFFMAN_ONLY: strategy = Z_HUFFMAN_ONLY; break;
+		default: strategy = Z_DEFAULT_STRATEGY; break;
+	}
+
+	z_stream stream;
+	memset(&stream, 0, sizeof(z_stream));
+	if (deflateInit2(&stream, this->settings.compressionLevel, Z_DEFLATED, 15, 8, strategy) != Z_OK)
+	{
+		printf("Failed to init deflate\n");
+		return false;
+	}
+
+	std::vector<uint8_t> compressed(deflateBound(&stream, static_cast<uLong>(filtered.size())));
+
+	stream.next_in = filtered.data();
+	stream.avail_in = static_cast<uInt>(filtered.size());
+	stream.next_out = compressed.data();
+	stream.avail_out = static_cast<uInt>(compressed.size());
+
+	int res = deflate(&stream, Z_FINISH);
+	size_t compressedSize = stream.total_out;
+	deflateEnd(&stream);
+
+	if (res != Z_STREAM_END)
+	{
+		printf("Failed to deflate PNG data (%d)\n", res);
+		return false;
+	}
+
+	out.reserve(compressedSize + 8 + 25 + 12 + 12);
+
+	static const uint8_t SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	out.insert(out.end(), SIGNATURE, SIGNATURE + 8);
+
+	uint8_t ihdr[13];
+	ihdr[0] = static_cast<uint8_t>(w >> 24);
+	ihdr[1] = static_cast<uint8_t>(w >> 16);
+	ihdr[2] = static_cast<uint8_t>(w >> 8);
+	ihdr[3] = static_cast<uint8_t>(w);
+	ihdr[4] = static_cast<uint8_t>(h >> 24);
+	ihdr[5] = static_cast<uint8_t>(h >> 16);
+	ihdr[6] = static_cast<uint8_t>(h >> 8);
+	ihdr[7] = static_cast<uint8_t>(h);
+	ihdr[8] = static_cast<uint8_t>(bitDepth);
+	ihdr[9] = (channels == 3) ? 2 : 0;	//truecolor / greyscale
+	ihdr[10] = 0;	//deflate
+	ihdr[11] = 0;	//adaptive filtering
+	ihdr[12] = 0;	//no interlace
+
+	AppendChunk("IHDR", ihdr, sizeof(ihdr), out);
+	AppendChunk("IDAT", compressed.data(), compressedSize, out);
+	AppendChunk("IEND", nullptr, 0, out);
+
+	return true;
+}
+
+/// <summary>
+/// Apply filter to single row
+/// </summary>
+/// <param name="filter">filter (not ADAPTIVE)</param>
+/// <param name="bpp">bytes per pixel</param>
+/// <param name="rowSize">row size in bytes</param>
+/// <param name="row">current row</param>
+/// <param name="prevRow">previous row (zeros for first row)</param>
+/// <param name="out">filtered row</param>
+void PNGEncoder::FilterRow(PNG_FILTER filter, size_t bpp, size_t rowSize,
+	const uint8_t * row, const uint8_t * prevRow, uint8_t * out)
+{
+	switch (filter)
+	{
+		case PNG_FILTER::SUB:
+			for (size_t i = 0; i < bpp; i++)
+			{
+				out[i] = row[i];
+			}
+			for (size_t i = bpp; i < rowSize; i++)
+			{
+				out[i] = static_cast<uint8_t>(row[i] - row[i - bpp]);
+			}
+			break;
+
+		case PNG_FILTER::UP:
+			for (size_t i = 0; i < rowSize; i++)
+			{
+				out[i] = static_cast<uint8_t>(row[i] - prevRow[i]);
+			}
+			break;
+
+		case PNG_FILTER::AVERAGE:
+			for (size_t i = 0; i < bpp; i++)
+			{
+				out[i] = static_cast<uint8_t>(row[i] - (prevRow[i] >> 1));
+			}
+			for (size_t i = bpp; i < rowSize; i++)
+			{
+				out[i] = static_cast<uint8_t>(row[i] - ((row[i - bpp] + prevRow[i]) >> 1));
+			}
+			break;
+
+		case PNG_FILTER::PAETH:
+			for (size_t i = 0; i < bpp; i++)
+			{
+				//left and upper-left are 0 => predictor is up
+				out[i] = static_cast<uint8_t>(row[i] - prevRow[i]);
+			}
+			for (size_t i = bpp; i < rowSize; i++)
+			{
+				int a = row[i - bpp];
+				int b = prevRow[i];
+				int c = prevRow[i - bpp];
+
+				int pa = std::abs(b - c);
+				int pb = std::abs(a - c);
+				int pc = std::abs(a + b - 2 * c);
+
+				int pred = ((pa <= pb) && (pa <= pc)) ? a : ((pb <= pc) ? b : c);
+				out[i] = static_cast<uint8_t>(row[i] - pred);
+			}
+			break;
+
+		default:
+			memcpy(out, row, rowSize);
+			break;
+	}
+}
+
+/// <summary>
+/// Sum of filtered bytes taken as signed values
+/// </summary>
+/// <param name="row">filtered row</param>
+/// <param name="rowSize">row size in bytes</param>
+/// <returns></returns>
+uint64_t PNGEncoder::GetRowCost(const uint8_t * row, size_t rowSize)
+{
+	uint64_t cost = 0;
+	for (size_t i = 0; i < rowSize; i++)
+	{
+		cost += (row[i] < 128) ? row[i] : (256 - row[i]);
+	}
+	return cost;
+}
+
+void PNGEncoder::AppendChunk(const char * type, const uint8_t * data, size_t size, std::vector<uint8_t> & out)
+{
+	AppendUInt32(static_cast<uint32_t>(size), out);
+
+	size_t typeStart = out.size();
+	out.insert(out.end(), type, type + 4);
+	if (size > 0)
+	{
+		out.insert(out.end(), data, data + size);
+	}
+
+	//CRC of type and data
+	uLong crc = crc32(0L, Z_NULL, 0);
+	crc = crc32(crc, out.data() + typeStart, static_cast<uInt>(size + 4));
+	AppendUInt32(static_cast<uint32_t>(crc), out);
+}
+
+void PNGEncoder::AppendUInt32(uint32_t v, std::vector<uint8_t> & out)
+{
+	out.push_back(static_cast<uint8_t>(v >> 24));
+	out.push_back(static_cast<uint8_t>(v >> 16));
+	out.push_back(static_cast<uint8_t>(v >> 8));
+	out.push_back(static_cast<uint8_t>(v));
+}
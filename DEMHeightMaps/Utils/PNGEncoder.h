@@ -0,0 +1,81 @@
+#ifndef PNG_ENCODER_H
+#define PNG_ENCODER_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+/// <summary>
+/// PNG row filter
+/// NONE, SUB, UP, AVERAGE, PAETH - same filter for all rows
+/// ADAPTIVE - filter with minimal sum of absolute differences for each row
+/// </summary>
+enum class PNG_FILTER { NONE = 0, SUB = 1, UP = 2, AVERAGE = 3, PAETH = 4, ADAPTIVE = 5 };
+
+/// <summary>
+/// zlib deflate strategy
+/// DEFAULT - Z_DEFAULT_STRATEGY
+/// FILTERED - Z_FILTERED (small filtered values, less string matching)
+/// RLE - Z_RLE (only runs, fastest with usable ratio for smooth heights)
+/// HUFFMAN_ONLY - Z_HUFFMAN_ONLY (no matching at all)
+/// </summary>
+enum class PNG_STRATEGY { DEFAULT = 0, FILTERED = 1, RLE = 2, HUFFMAN_ONLY = 3 };
+
+/// <summary>
+/// Encoder settings
+/// </summary>
+typedef struct PNGEncoderSettings
+{
+	int compressionLevel;		//zlib level 0 (store) - 9 (best)
+	PNG_STRATEGY strategy;
+	PNG_FILTER filter;
+
+	PNGEncoderSettings() :
+		compressionLevel(4),
+		strategy(PNG_STRATEGY::RLE),
+		filter(PNG_FILTER::PAETH)
+	{}
+
+} PNGEncoderSettings;
+
+/// <summary>
+/// Greyscale 8-bit / 16-bit and RGB 8-bit PNG encoder (IHDR, IDAT, IEND) on top of zlib.
+/// Heights are smooth, so Up / Paeth filtered rows are mostly small values
+/// and deflate can be run with low level and fast strategy.
+///
+/// Heights in meters can be stored as 16-bit greyscale or as Mapbox Terrain-RGB
+/// (height = -10000 + (R * 256 * 256 + G * 256 + B) * 0.1)
+///
+/// Encoder has no state except settings, Encode can be called
+/// from more threads at once
+/// </summary>
+class PNGEncoder
+{
+	public:
+		PNGEncoder(const PNGEncoderSettings & settings = PNGEncoderSettings());
+		~PNGEncoder() = default;
+
+		const PNGEncoderSettings & GetSettings() const;
+
+		bool EncodeGrey8(int w, int h, const uint8_t * data, std::vector<uint8_t> & out) const;
+		bool EncodeGrey16(int w, int h, const uint16_t * data, std::vector<uint8_t> & out) const;
+		bool EncodeGrey16(int w, int h, const short * heights, std::vector<uint8_t> & out) const;
+		bool EncodeRGB8(int w, int h, const uint8_t * data, std::vector<uint8_t> & out) const;
+		bool EncodeTerrainRGB(int w, int h, const short * heights, std::vector<uint8_t> & out) const;
+
+		static void PackTerrainRGB(short height, uint8_t * rgb);
+
+	private:
+		PNGEncoderSettings settings;
+
+		bool Encode(int w, int h, int bitDepth, int channels, const uint8_t * data, std::vector<uint8_t> & out) const;
+
+		static void FilterRow(PNG_FILTER filter, size_t bpp, size_t rowSize,
+			const uint8_t * row, const uint8_t * prevRow, uint8_t * out);
+		static uint64_t GetRowCost(const uint8_t * row, size_t rowSize);
+
+		static void AppendChunk(const char * type, const uint8_t * data, size_t size, std::vector<uint8_t> & out);
+		static void AppendUInt32(uint32_t v, std::vector<uint8_t> & out);
+};
+
+#endif
@@ -0,0 +1,231 @@
+#include "./PerfCounters.h"
+
+#include <cstring>
+
+#ifdef __linux__
+	#include <unistd.h>
+	#include <sys/syscall.h>
+	#include <linux/perf_event.h>
+#endif
+
+PerfCounterValues::PerfCounterValues()
+{
+	for (int i = 0; i < EVENTS_COUNT; i++)
+	{
+		this->values[i] = 0;
+		this->available[i] = false;
+	}
+}
+
+bool PerfCounterValues::IsAvailable() const
+{
+	for (int i = 0; i < EVENTS_COUNT; i++)
+	{
+		if (this->available[i])
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+/// <summary>
+/// Get instructions per cycle
+/// </summary>
+/// <returns>IPC or 0 if not available</returns>
+double PerfCounterValues::GetIPC() const
+{
+	if ((this->available[CYCLES] == false) || (this->available[INSTRUCTIONS] == false) ||
+		(this->values[CYCLES] == 0))
+	{
+		return 0;
+	}
+	return static_cast<double>(this->values[INSTRUCTIONS]) / this->values[CYCLES];
+}
+
+/// <summary>
+/// Accumulate other values
+/// </summary>
+/// <param name="v">added values</param>
+void PerfCounterValues::Add(const PerfCounterValues & v)
+{
+	for (int i = 0; i < EVENTS_COUNT; i++)
+	{
+		this->values[i] += v.values[i];
+		this->available[i] = this->available[i] || v.available[i];
+	}
+}
+
+/// <summary>
+/// Get difference of two snapshots (this - start)
+/// </summary>
+/// <param name="start">older snapshot</param>
+/// <returns>counter differences</returns>
+PerfCounterValues PerfCounterValues::Sub(const PerfCounterValues & start) const
+{
+	PerfCounterValues v;
+	for (int i = 0; i < EVENTS_COUNT; i++)
+	{
+		v.available[i] = this->available[i] && start.available[i];
+		v.values[i] = (v.available[i] && (this->values[i] > start.values[i])) ? this->values[i] - start.values[i] : 0;
+	}
+	return v;
+}
+
+const char * PerfCounterValues::GetName(EVENT e)
+{
+	switch (e)
+	{
+	case CYCLES: return "cycles";
+	case INSTRUCTIONS: return "instructions";
+	case LLC_MISSES: return "llc_misses";
+	case DTLB_MISSES: return "dtlb_misses";
+	case BRANCH_MISSES: return "branch_misses";
+	default: return "unknown";
+	}
+}
+
+//=============================================================================
+
+#ifdef __linux__
+
+/// <summary>
+/// Open single counter of calling thread
+/// </summary>
+/// <param name="type">PERF_TYPE_*</param>
+/// <param name="config">event config</param>
+/// <returns>file descriptor or -1 if event is not supported / permitted</returns>
+static int OpenCounter(uint32_t type, uint64_t config)
+{
+	perf_event_attr attr;
+	memset(&attr, 0, sizeof(perf_event_attr));
+	attr.size = sizeof(perf_event_attr);
+	attr.type = type;
+	attr.config = config;
+	attr.disabled = 0;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+	return static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+#endif
+
+/// <summary>
+/// ctor - open all counters for calling thread
+/// </summary>
+PerfCounters::PerfCounters()
+{
+	for (int i = 0; i < PerfCounterValues::EVENTS_COUNT; i++)
+	{
+		this->fds[i] = -1;
+	}
+
+#ifdef __linux__
+	this->fds[PerfCounterValues::CYCLES] = OpenCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+	this->fds[PerfCounterValues::INSTRUCTIONS] = OpenCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+	this->fds[PerfCounterValues::LLC_MISSES] = OpenCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+	this->fds[PerfCounterValues::DTLB_MISSES] = OpenCounter(PERF_TYPE_HW_CACHE,
+		PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+	this->fds[PerfCounterValues::BRANCH_MISSES] = OpenCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+#endif
+}
+
+PerfCounters::~PerfCounters()
+{
+#ifdef __linux__
+	for (int i = 0; i < PerfCounterValues::EVENTS_COUNT; i++)
+	{
+		if (this->fds[i] >= 0)
+		{
+			close(this->fds[i]);
+		}
+	}
+#endif
+}
+
+/// <summary>
+/// Get counters of calling thread (opened on first use)
+/// </summary>
+/// <returns>counters instance</returns>
+PerfCounters & PerfCounters::GetThreadInstance()
+{
+	thread_local PerfCounters counters;
+	return counters;
+}
+
+bool PerfCounters::IsAvailable() const
+{
+	for (int i = 0; i < PerfCounterValues::EVENTS_COUNT; i++)
+	{
+		if (this->fds[i] >= 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+/// <summary>
+/// Read current counter value, scaled if counter was multiplexed
+/// </summary>
+/// <param name="event">PerfCounterValues::EVENT</param>
+/// <param name="value">output value</param>
+/// <returns>true if value was read</returns>
+bool PerfCounters::Read(int event, uint64_t & value) const
+{
+#ifdef __linux__
+	if (this->fds[event] < 0)
+	{
+		return false;
+	}
+
+	uint64_t data[3]; //value, time enabled, time running
+	if (read(this->fds[event], data, sizeof(data)) != static_cast<ssize_t>(sizeof(data)))
+	{
+		return false;
+	}
+
+	value = data[0];
+	if ((data[2] > 0) && (data[2] < data[1]))
+	{
+		value = static_cast<uint64_t>(static_cast<double>(data[0]) * data[1] / data[2]);
+	}
+
+	return true;
+#else
+	return false;
+#endif
+}
+
+/// <summary>
+/// Get current (absolute) values of all counters.
+/// Snapshots can be subtracted, so measured intervals can be nested
+/// </summary>
+/// <returns>counter values</returns>
+PerfCounterValues PerfCounters::ReadValues() const
+{
+	PerfCounterValues v;
+
+	for (int i = 0; i < PerfCounterValues::EVENTS_COUNT; i++)
+	{
+		v.available[i] = this->Read(i, v.values[i]);
+	}
+
+	return v;
+}
+
+void PerfCounters::Start()
+{
+	this->startValues = this->ReadValues();
+}
+
+/// <summary>
+/// Get counter values since last Start
+/// </summary>
+/// <returns>counter differences</returns>
+PerfCounterValues PerfCounters::Stop() const
+{
+	return this->ReadValues().Sub(this->startValues);
+}
@@ -0,0 +1,73 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <cstdio>
+#include <cstdint>
+
+/// <summary>
+/// Values of hardware counters (difference between Start and Stop)
+/// </summary>
+typedef struct PerfCounterValues
+{
+	enum EVENT
+	{
+		CYCLES = 0,
+		INSTRUCTIONS = 1,
+		LLC_MISSES = 2,
+		DTLB_MISSES = 3,
+		BRANCH_MISSES = 4,
+		EVENTS_COUNT = 5
+	};
+
+	uint64_t values[EVENTS_COUNT];
+	bool available[EVENTS_COUNT];	//event is supported and was measured
+
+	PerfCounterValues();
+
+	bool IsAvailable() const;
+	double GetIPC() const;
+
+	void Add(const PerfCounterValues & v);
+	PerfCounterValues Sub(const PerfCounterValues & start) const;
+
+	static const char * GetName(EVENT e);
+
+} PerfCounterValues;
+
+/// <summary>
+/// Hardware performance counters of calling thread
+/// (cycles, instructions, LLC misses, dTLB misses, branch misses).
+/// Linux only (perf_event_open), on other platforms or if perf events
+/// are not permitted (perf_event_paranoid, containers) no counter is available
+/// and Start / Stop return empty values.
+///
+/// Counters are bound to thread that created the instance,
+/// so work done by other threads (eg. tile loading on thread pool) is not included.
+/// Counters are user space only, multiplexed events are scaled
+/// </summary>
+class PerfCounters
+{
+	public:
+		PerfCounters();
+		~PerfCounters();
+
+		PerfCounters(const PerfCounters &) = delete;
+		PerfCounters & operator=(const PerfCounters &) = delete;
+
+		bool IsAvailable() const;
+
+		PerfCounterValues ReadValues() const;
+
+		void Start();
+		PerfCounterValues Stop() const;
+
+		static PerfCounters & GetThreadInstance();
+
+	private:
+		int fds[PerfCounterValues::EVENTS_COUNT];
+		PerfCounterValues startValues;
+
+		bool Read(int event, uint64_t & value) const;
+};
+
+#endif
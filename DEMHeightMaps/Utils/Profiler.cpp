@@ -0,0 +1,414 @@
+#include "./Profiler.h"
+
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <cinttypes>
+
+/// <summary>
+/// Get global profiler
+/// </summary>
+/// <returns>profiler instance</returns>
+Profiler & Profiler::GetInstance()
+{
+	static Profiler instance;
+	return instance;
+}
+
+Profiler::Profiler() :
+	enabled(false),
+	hwCounters(false),
+	trace(nullptr),
+	firstTraceEvent(true),
+	startTimeUs(GetTimeUs())
+{
+}
+
+Profiler::~Profiler()
+{
+	this->CloseTrace();
+}
+
+void Profiler::SetEnabled(bool val)
+{
+	this->enabled = val;
+}
+
+bool Profiler::IsEnabled() const
+{
+	return this->enabled;
+}
+
+/// <summary>
+/// Read hardware counters of scope thread in each scope.
+/// Reading counters costs few syscalls per scope.
+/// If counters are not available, only time is measured
+/// </summary>
+/// <param name="val">enable hardware counters</param>
+void Profiler::SetHardwareCountersEnabled(bool val)
+{
+	if (val && (PerfCounters::GetThreadInstance().IsAvailable() == false))
+	{
+		printf("Hardware performance counters are not available\n");
+	}
+	this->hwCounters = val;
+}
+
+bool Profiler::IsHardwareCountersEnabled() const
+{
+	return this->hwCounters;
+}
+
+uint64_t Profiler::GetTimeUs()
+{
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+/// <summary>
+/// Write all events to Chrome trace JSON file.
+/// Previous trace file is closed (and its JSON array terminated)
+/// </summary>
+/// <param name="fileName">output file, empty to stop tracing</param>
+/// <returns>true if file was opened</returns>
+bool Profiler::SetTraceFile(const MyStringAnsi & fileName)
+{
+	std::lock_guard<std::mutex> lock(this->statsLock);
+
+	this->CloseTrace();
+
+	if (fileName.length() == 0)
+	{
+		return true;
+	}
+
+	FILE * f = nullptr;
+	my_fopen(&f, fileName.c_str(), "w");
+	if (f == nullptr)
+	{
+		printf("Failed to open trace file %s\n", fileName.c_str());
+		return false;
+	}
+
+	fprintf(f, "[\n");
+	this->trace = f;
+	this->firstTraceEvent = true;
+
+	return true;
+}
+
+void Profiler::CloseTrace()
+{
+	if (this->trace == nullptr)
+	{
+		return;
+	}
+
+	fprintf(this->trace, "\n]\n");
+	fclose(this->trace);
+	this->trace = nullptr;
+}
+
+/// <summary>
+/// Get small sequential id of current thread (trace "tid")
+/// Must be called with statsLock held
+/// </summary>
+/// <returns>thread id</returns>
+int Profiler::GetThreadId()
+{
+	auto it = this->threadIds.find(std::this_thread::get_id());
+	if (it != this->threadIds.end())
+	{
+		return it->second;
+	}
+
+	int id = static_cast<int>(this->threadIds.size()) + 1;
+	this->threadIds[std::this_thread::get_id()] = id;
+	return id;
+}
+
+void Profiler::UpdateTimer(const char * name, uint64_t durationUs, uint64_t count, const PerfCounterValues * hw)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	//for accumulated time, min / max are known only for average interval
+	uint64_t intervalUs = durationUs / count;
+
+	auto it = this->timers.find(name);
+	if (it == this->timers.end())
+	{
+		it = this->timers.emplace(name, TimerStats{ 0, 0, intervalUs, intervalUs, PerfCounterValues() }).first;
+	}
+
+	TimerStats & t = it->second;
+	t.count += count;
+	t.totalUs += durationUs;
+	t.minUs = std::min(t.minUs, intervalUs);
+	t.maxUs = std::max(t.maxUs, intervalUs);
+
+	if (hw)
+	{
+		t.hw.Add(*hw);
+	}
+}
+
+/// <summary>
+/// Add timed event (aggregated and written to trace)
+/// </summary>
+/// <param name="name">event name</param>
+/// <param name="startUs">start time (GetTimeUs)</param>
+/// <param name="durationUs">duration</param>
+/// <param name="hw">hardware counters of event (can be nullptr)</param>
+void Profiler::AddEvent(const char * name, uint64_t startUs, uint64_t durationUs, const PerfCounterValues * hw)
+{
+	if (this->enabled == false)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(this->statsLock);
+
+	this->UpdateTimer(name, durationUs, 1, hw);
+
+	if (this->trace)
+	{
+		fprintf(this->trace, "%s{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%" PRIu64 ",\"dur\":%" PRIu64 ",\"pid\":1,\"tid\":%d",
+			(this->firstTraceEvent) ? "" : ",\n", name,
+			(startUs > this->startTimeUs) ? startUs - this->startTimeUs : 0, durationUs, this->GetThreadId());
+
+		if ((hw) && (hw->IsAvailable()))
+		{
+			const char * separator = "";
+			fprintf(this->trace, ",\"args\":{");
+			for (int i = 0; i < PerfCounterValues::EVENTS_COUNT; i++)
+			{
+				if (hw->available[i])
+				{
+					fprintf(this->trace, "%s\"%s\":%" PRIu64, separator,
+						PerfCounterValues::GetName(static_cast<PerfCounterValues::EVENT>(i)), hw->values[i]);
+					separator = ",";
+				}
+			}
+			fprintf(this->trace, "}");
+		}
+
+		fprintf(this->trace, "}");
+		this->firstTraceEvent = false;
+	}
+}
+
+/// <summary>
+/// Add time accumulated over many short intervals
+/// (eg. per row of image). It is added only to summary,
+/// trace contains only events with real start time
+/// </summary>
+/// <param name="name">timer name</param>
+/// <param name="durationUs">total duration</param>
+/// <param name="count">number of measured intervals</param>
+void Profiler::AddTime(const char * name, uint64_t durationUs, uint64_t count)
+{
+	if (this->enabled == false)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(this->statsLock);
+	this->UpdateTimer(name, durationUs, count, nullptr);
+}
+
+/// <summary>
+/// Increment counter
+/// </summary>
+/// <param name="name">counter name</param>
+/// <param name="value">increment</param>
+void Profiler::AddCounter(const char * name, int64_t value)
+{
+	if (this->enabled == false)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(this->statsLock);
+
+	int64_t & c = this->counters[name];
+	c += value;
+
+	if (this->trace)
+	{
+		fprintf(this->trace, "%s{\"name\":\"%s\",\"ph\":\"C\",\"ts\":%" PRIu64 ",\"pid\":1,\"args\":{\"value\":%" PRId64 "}}",
+			(this->firstTraceEvent) ? "" : ",\n", name, GetTimeUs() - this->startTimeUs, c);
+		this->firstTraceEvent = false;
+	}
+}
+
+/// <summary>
+/// Clear all timers and counters, trace file is kept open
+/// </summary>
+void Profiler::Reset()
+{
+	std::lock_guard<std::mutex> lock(this->statsLock);
+
+	this->timers.clear();
+	this->counters.clear();
+}
+
+/// <summary>
+/// Print all timers sorted by total time and all counters
+/// </summary>
+/// <param name="f">output (stdout by default)</param>
+void Profiler::PrintSummary(FILE * f) const
+{
+	std::lock_guard<std::mutex> lock(this->statsLock);
+
+	std::vector<std::pair<std::string, TimerStats>> sorted(this->timers.begin(), this->timers.end());
+	std::sort(sorted.begin(), sorted.end(), [](const std::pair<std::string, TimerStats> & a, const std::pair<std::string, TimerStats> & b) {
+		return a.second.totalUs > b.second.totalUs;
+	});
+
+	fprintf(f, "===== Profile =====\n");
+	fprintf(f, "%-36s %10s %12s %10s %10s %10s\n", "phase", "count", "total ms", "avg us", "min us", "max us");
+
+	for (const auto & it : sorted)
+	{
+		const TimerStats & t = it.second;
+		fprintf(f, "%-36s %10" PRIu64 " %12.2f %10.1f %10" PRIu64 " %10" PRIu64 "\n",
+			it.first.c_str(), t.count, t.totalUs / 1000.0,
+			(t.count > 0) ? static_cast<double>(t.totalUs) / t.count : 0.0,
+			t.minUs, t.maxUs);
+	}
+
+	this->PrintHardwareCounters(f, sorted);
+
+	if (this->counters.empty())
+	{
+		return;
+	}
+
+	std::vector<std::pair<std::string, int64_t>> sortedCounters(this->counters.begin(), this->counters.end());
+	std::sort(sortedCounters.begin(), sortedCounters.end());
+
+	fprintf(f, "Counters:\n");
+	for (const auto & it : sortedCounters)
+	{
+		fprintf(f, "  %-34s %12" PRId64 "\n", it.first.c_str(), it.second);
+	}
+}
+
+/// <summary>
+/// Print hardware counters of timers that have them
+/// (counts are in thousands, misses are also per 1000 instructions)
+/// </summary>
+/// <param name="f">output</param>
+/// <param name="sorted">timers sorted by time</param>
+void Profiler::PrintHardwareCounters(FILE * f, const std::vector<std::pair<std::string, TimerStats>> & sorted)
+{
+	bool any = false;
+	for (const auto & it : sorted)
+	{
+		any = any || it.second.hw.IsAvailable();
+	}
+
+	if (any == false)
+	{
+		return;
+	}
+
+	fprintf(f, "Hardware counters (k = thousands, /ki = per 1000 instructions):\n");
+	fprintf(f, "%-36s %12s %6s %12s %8s %12s %8s %12s %8s\n",
+		"phase", "k cycles", "IPC", "k LLC miss", "/ki", "k dTLB miss", "/ki", "k br. miss", "/ki");
+
+	for (const auto & it : sorted)
+	{
+		const PerfCounterValues & hw = it.second.hw;
+		if (hw.IsAvailable() == false)
+		{
+			continue;
+		}
+
+		double ki = (hw.available[PerfCounterValues::INSTRUCTIONS]) ? hw.values[PerfCounterValues::INSTRUCTIONS] / 1000.0 : 0.0;
+
+		//not available values are printed as "-"
+		auto format = [](bool available, double value, const char * fmt) -> std::string {
+			char buf[32] = "-";
+			if (available)
+			{
+				snprintf(buf, sizeof(buf), fmt, value);
+			}
+			return buf;
+		};
+
+		std::string miss[3][2];
+		PerfCounterValues::EVENT missEvents[3] = {
+			PerfCounterValues::LLC_MISSES, PerfCounterValues::DTLB_MISSES, PerfCounterValues::BRANCH_MISSES
+		};
+		for (int i = 0; i < 3; i++)
+		{
+			PerfCounterValues::EVENT e = missEvents[i];
+			miss[i][0] = format(hw.available[e], hw.values[e] / 1000.0, "%.1f");
+			miss[i][1] = format(hw.available[e] && (ki > 0), (ki > 0) ? hw.values[e] / ki : 0.0, "%.2f");
+		}
+
+		fprintf(f, "%-36s %12s %6s %12s %8s %12s %8s %12s %8s\n",
+			it.first.c_str(),
+			format(hw.available[PerfCounterValues::CYCLES], hw.values[PerfCounterValues::CYCLES] / 1000.0, "%.1f").c_str(),
+			format(hw.GetIPC() > 0, hw.GetIPC(), "%.2f").c_str(),
+			miss[0][0].c_str(), miss[0][1].c_str(),
+			miss[1][0].c_str(), miss[1][1].c_str(),
+			miss[2][0].c_str(), miss[2][1].c_str());
+	}
+}
+
+//=============================================================================
+
+ProfilerScope::ProfilerScope(const char * name) :
+	name(name),
+	startUs(0),
+	active(Profiler::GetInstance().IsEnabled()),
+	hwActive(false)
+{
+	if (this->active == false)
+	{
+		return;
+	}
+
+	if (Profiler::GetInstance().IsHardwareCountersEnabled())
+	{
+		this->startHw = PerfCounters::GetThreadInstance().ReadValues();
+		this->hwActive = true;
+	}
+
+	this->startUs = Profiler::GetTimeUs();
+}
+
+ProfilerScope::~ProfilerScope()
+{
+	this->Stop();
+}
+
+/// <summary>
+/// End measured interval before end of scope
+/// (eg. to print summary including this scope)
+/// </summary>
+void ProfilerScope::Stop()
+{
+	if (this->active == false)
+	{
+		return;
+	}
+
+	uint64_t durationUs = Profiler::GetTimeUs() - this->startUs;
+	this->active = false;
+
+	if (this->hwActive)
+	{
+		PerfCounterValues hw = PerfCounters::GetThreadInstance().ReadValues().Sub(this->startHw);
+		Profiler::GetInstance().AddEvent(this->name, this->startUs, durationUs, &hw);
+	}
+	else
+	{
+		Profiler::GetInstance().AddEvent(this->name, this->startUs, durationUs);
+	}
+}
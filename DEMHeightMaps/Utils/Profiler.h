@@ -0,0 +1,111 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <cstdio>
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "./PerfCounters.h"
+#include "../Strings/MyString.h"
+
+#define PROFILER_CONCAT_IMPL(a, b) a##b
+#define PROFILER_CONCAT(a, b) PROFILER_CONCAT_IMPL(a, b)
+
+//time rest of the current scope under given name
+#define PROFILE_SCOPE(name) ProfilerScope PROFILER_CONCAT(profilerScope, __LINE__)(name)
+
+/// <summary>
+/// Phase timers and counters.
+/// Timed scopes are aggregated by name (count, total, min, max) and optionally
+/// written to Chrome trace JSON (chrome://tracing, Perfetto) with thread of each scope.
+/// Counters are aggregated by name and written to trace as counter events.
+/// Optionally, hardware counters (PerfCounters) of scope thread are read
+/// at the start and end of each scope and aggregated next to its time.
+///
+/// Profiler is disabled by default, disabled profiler costs only
+/// single atomic load per scope / counter. It is meant for coarse phases
+/// (per frame, per tile), not for per-pixel events
+/// </summary>
+class Profiler
+{
+	public:
+		static Profiler & GetInstance();
+
+		void SetEnabled(bool val);
+		bool IsEnabled() const;
+
+		void SetHardwareCountersEnabled(bool val);
+		bool IsHardwareCountersEnabled() const;
+
+		bool SetTraceFile(const MyStringAnsi & fileName);
+
+		void AddEvent(const char * name, uint64_t startUs, uint64_t durationUs,
+			const PerfCounterValues * hw = nullptr);
+		void AddTime(const char * name, uint64_t durationUs, uint64_t count = 1);
+		void AddCounter(const char * name, int64_t value = 1);
+
+		void Reset();
+		void PrintSummary(FILE * f = stdout) const;
+
+		static uint64_t GetTimeUs();
+
+	private:
+		typedef struct TimerStats
+		{
+			uint64_t count;
+			uint64_t totalUs;
+			uint64_t minUs;
+			uint64_t maxUs;
+			PerfCounterValues hw;
+		} TimerStats;
+
+		std::atomic<bool> enabled;
+		std::atomic<bool> hwCounters;
+
+		std::unordered_map<std::string, TimerStats> timers;
+		std::unordered_map<std::string, int64_t> counters;
+		std::unordered_map<std::thread::id, int> threadIds;
+		mutable std::mutex statsLock;
+
+		FILE * trace;
+		bool firstTraceEvent;
+		uint64_t startTimeUs;
+
+		Profiler();
+		~Profiler();
+
+		Profiler(const Profiler &) = delete;
+		Profiler & operator=(const Profiler &) = delete;
+
+		void CloseTrace();
+		int GetThreadId();
+		static void PrintHardwareCounters(FILE * f, const std::vector<std::pair<std::string, TimerStats>> & sorted);
+		void UpdateTimer(const char * name, uint64_t durationUs, uint64_t count, const PerfCounterValues * hw);
+};
+
+/// <summary>
+/// RAII timer - measures time from construction to destruction
+/// and adds it to profiler as event
+/// </summary>
+class ProfilerScope
+{
+	public:
+		ProfilerScope(const char * name);
+		~ProfilerScope();
+
+		void Stop();
+
+	private:
+		const char * name;
+		uint64_t startUs;
+		PerfCounterValues startHw;
+		bool active;
+		bool hwActive;
+};
+
+#endif
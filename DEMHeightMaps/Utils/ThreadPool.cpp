@@ -0,0 +1,90 @@
+#include "./ThreadPool.h"
+
+/// <summary>
+/// ctor
+/// </summary>
+/// <param name="threadsCount">number of workers, 0 = number of HW threads</param>
+ThreadPool::ThreadPool(size_t threadsCount) :
+	activeTasks(0),
+	stopped(false)
+{
+	if (threadsCount == 0)
+	{
+		threadsCount = std::thread::hardware_concurrency();
+		if (threadsCount == 0)
+		{
+			threadsCount = 4;
+		}
+	}
+
+	for (size_t i = 0; i < threadsCount; i++)
+	{
+		this->workers.emplace_back(&ThreadPool::WorkerLoop, this);
+	}
+}
+
+/// <summary>
+/// dtor - all queued tasks are finished before workers exit
+/// </summary>
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(this->tasksLock);
+		this->stopped = true;
+	}
+	this->tasksCondition.notify_all();
+
+	for (auto & w : this->workers)
+	{
+		w.join();
+	}
+}
+
+size_t ThreadPool::GetThreadsCount() const
+{
+	return this->workers.size();
+}
+
+/// <summary>
+/// Block until task queue is empty and no task is running
+/// </summary>
+void ThreadPool::WaitForAll()
+{
+	std::unique_lock<std::mutex> lock(this->tasksLock);
+	this->doneCondition.wait(lock, [this]() {
+		return (this->tasks.empty()) && (this->activeTasks == 0);
+	});
+}
+
+void ThreadPool::WorkerLoop()
+{
+	while (true)
+	{
+		std::function<void()> task;
+
+		{
+			std::unique_lock<std::mutex> lock(this->tasksLock);
+			this->tasksCondition.wait(lock, [this]() {
+				return (this->stopped) || (this->tasks.empty() == false);
+			});
+
+			if (this->tasks.empty())
+			{
+				//stopped and nothing left to do
+				return;
+			}
+
+			task = std::move(this->tasks.front());
+			this->tasks.pop();
+			this->activeTasks++;
+		}
+
+		task();
+
+		{
+			std::lock_guard<std::mutex> lock(this->tasksLock);
+			this->activeTasks--;
+		}
+		this->doneCondition.notify_all();
+	}
+}
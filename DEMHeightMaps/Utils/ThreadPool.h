@@ -0,0 +1,66 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+
+/// <summary>
+/// Fixed size pool of worker threads with single FIFO task queue
+/// </summary>
+class ThreadPool
+{
+	public:
+		ThreadPool(size_t threadsCount = 0);
+		~ThreadPool();
+
+		size_t GetThreadsCount() const;
+
+		template <typename Func>
+		std::future<typename std::result_of<Func()>::type> AddTask(Func && f);
+
+		void WaitForAll();
+
+	private:
+		std::vector<std::thread> workers;
+		std::queue<std::function<void()>> tasks;
+
+		std::mutex tasksLock;
+		std::condition_variable tasksCondition;
+		std::condition_variable doneCondition;
+
+		size_t activeTasks;
+		bool stopped;
+
+		void WorkerLoop();
+};
+
+/// <summary>
+/// Add new task to queue
+/// </summary>
+/// <param name="f">callable without parameters</param>
+/// <returns>future with result of task</returns>
+template <typename Func>
+std::future<typename std::result_of<Func()>::type> ThreadPool::AddTask(Func && f)
+{
+	typedef typename std::result_of<Func()>::type ResultType;
+
+	//packaged_task is not copyable, std::function requires copyable callable
+	auto task = std::make_shared<std::packaged_task<ResultType()>>(std::forward<Func>(f));
+	std::future<ResultType> res = task->get_future();
+
+	{
+		std::lock_guard<std::mutex> lock(this->tasksLock);
+		this->tasks.emplace([task]() { (*task)(); });
+	}
+	this->tasksCondition.notify_one();
+
+	return res;
+}
+
+#endif
@@ -0,0 +1,121 @@
+#include "./TileOrder.h"
+
+#include <algorithm>
+#include <numeric>
+
+const TILE_ORDER TileOrder::ALL[4] = { 
+	TILE_ORDER::ROW_MAJOR, TILE_ORDER::MORTON, TILE_ORDER::HILBERT, TILE_ORDER::SOURCE_MAJOR 
+};
+
+const char * TileOrder::GetName(TILE_ORDER order)
+{
+	switch (order)
+	{
+	case TILE_ORDER::ROW_MAJOR: return "row-major";
+	case TILE_ORDER::MORTON: return "morton";
+	case TILE_ORDER::HILBERT: return "hilbert";
+	case TILE_ORDER::SOURCE_MAJOR: return "source-major";
+	}
+	return "unknown";
+}
+
+/// <summary>
+/// Interleave bits of x and y
+/// </summary>
+/// <param name="x"></param>
+/// <param name="y"></param>
+/// <returns>position on Z-order curve</returns>
+uint64_t TileOrder::GetMortonIndex(uint32_t x, uint32_t y)
+{
+	auto spread = [](uint64_t v) {
+		v = (v | (v << 16)) & 0x0000FFFF0000FFFFULL;
+		v = (v | (v << 8)) & 0x00FF00FF00FF00FFULL;
+		v = (v | (v << 4)) & 0x0F0F0F0F0F0F0F0FULL;
+		v = (v | (v << 2)) & 0x3333333333333333ULL;
+		v = (v | (v << 1)) & 0x5555555555555555ULL;
+		return v;
+	};
+
+	return spread(x) | (spread(y) << 1);
+}
+
+/// <summary>
+/// Position of (x, y) on Hilbert curve filling grid n x n
+/// </summary>
+/// <param name="x"></param>
+/// <param name="y"></param>
+/// <param name="n">grid size (power of 2)</param>
+/// <returns>position on Hilbert curve</returns>
+uint64_t TileOrder::GetHilbertIndex(uint32_t x, uint32_t y, uint32_t n)
+{
+	uint64_t d = 0;
+	for (uint32_t s = n / 2; s > 0; s /= 2)
+	{
+		uint32_t rx = (x & s) ? 1 : 0;
+		uint32_t ry = (y & s) ? 1 : 0;
+		d += static_cast<uint64_t>(s) * s * ((3 * rx) ^ ry);
+
+		//rotate quadrant
+		if (ry == 0)
+		{
+			if (rx == 1)
+			{
+				x = n - 1 - x;
+				y = n - 1 - y;
+			}
+			std::swap(x, y);
+		}
+	}
+	return d;
+}
+
+/// <summary>
+/// Smallest power of 2 grid that contains countX x countY tiles
+/// </summary>
+/// <param name="countX"></param>
+/// <param name="countY"></param>
+/// <returns></returns>
+uint32_t TileOrder::GetHilbertSize(size_t countX, size_t countY)
+{
+	uint32_t n = 1;
+	while ((n < countX) || (n < countY))
+	{
+		n *= 2;
+	}
+	return n;
+}
+
+/// <summary>
+/// Order of tiles in grid countX x countY along curve.
+/// Tile index is x + y * countX
+/// </summary>
+/// <param name="countX"></param>
+/// <param name="countY"></param>
+/// <param name="order">ROW_MAJOR, MORTON or HILBERT</param>
+/// <returns>tile indices in traversal order</returns>
+std::vector<size_t> TileOrder::CreateCurveOrder(size_t countX, size_t countY, TILE_ORDER order)
+{
+	std::vector<size_t> res(countX * countY);
+	std::iota(res.begin(), res.end(), 0);
+
+	if ((order != TILE_ORDER::MORTON) && (order != TILE_ORDER::HILBERT))
+	{
+		return res;
+	}
+
+	uint32_t n = GetHilbertSize(countX, countY);
+
+	std::vector<uint64_t> keys(res.size());
+	for (size_t i = 0; i < res.size(); i++)
+	{
+		uint32_t x = static_cast<uint32_t>(i % countX);
+		uint32_t y = static_cast<uint32_t>(i / countX);
+		keys[i] = (order == TILE_ORDER::MORTON) ? GetMortonIndex(x, y) : GetHilbertIndex(x, y, n);
+	}
+
+	std::sort(res.begin(), res.end(), [&](size_t a, size_t b) {
+		return keys[a] < keys[b];
+	});
+
+	return res;
+}
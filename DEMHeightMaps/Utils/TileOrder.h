@@ -0,0 +1,34 @@
+#ifndef TILE_ORDER_H
+#define TILE_ORDER_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+/// <summary>
+/// Traversal order of output tiles
+/// ROW_MAJOR - rows from top, tiles in row from left
+/// MORTON - Z-order curve over tile grid
+/// HILBERT - Hilbert curve over tile grid (consecutive tiles are always neighbours)
+/// SOURCE_MAJOR - tiles grouped by DEM tile they fall into
+/// </summary>
+enum class TILE_ORDER { ROW_MAJOR = 0, MORTON = 1, HILBERT = 2, SOURCE_MAJOR = 3 };
+
+/// <summary>
+/// Space-filling curves used to order tiles of grid
+/// </summary>
+class TileOrder
+{
+	public:
+		static const TILE_ORDER ALL[4];
+
+		static const char * GetName(TILE_ORDER order);
+
+		static uint64_t GetMortonIndex(uint32_t x, uint32_t y);
+		static uint64_t GetHilbertIndex(uint32_t x, uint32_t y, uint32_t n);
+		static uint32_t GetHilbertSize(size_t countX, size_t countY);
+
+		static std::vector<size_t> CreateCurveOrder(size_t countX, size_t countY, TILE_ORDER order);
+};
+
+#endif
@@ -0,0 +1,168 @@
+#include "./WorkStealingPool.h"
+
+#include <algorithm>
+
+/// <summary>
+/// ctor
+/// </summary>
+/// <param name="threadsCount">number of workers, 0 = number of HW threads</param>
+WorkStealingPool::WorkStealingPool(size_t threadsCount) :
+	threadsCount(threadsCount),
+	stealsCount(0)
+{
+	if (this->threadsCount == 0)
+	{
+		this->threadsCount = std::thread::hardware_concurrency();
+		if (this->threadsCount == 0)
+		{
+			this->threadsCount = 4;
+		}
+	}
+}
+
+size_t WorkStealingPool::GetThreadsCount() const
+{
+	return this->threadsCount;
+}
+
+/// <summary>
+/// Number of successful steals during last Run
+/// </summary>
+/// <returns></returns>
+size_t WorkStealingPool::GetStealsCount() const
+{
+	return this->stealsCount;
+}
+
+/// <summary>
+/// Call func for every index in [0, count) and wait until all calls are finished.
+/// func is called from more threads at once, worker is in [0, GetThreadsCount())
+/// and it is the same for all calls running on the same thread
+/// </summary>
+/// <param name="count">number of indices</param>
+/// <param name="func">callback (index, worker)</param>
+void WorkStealingPool::Run(size_t count, std::function<void(size_t index, size_t worker)> func)
+{
+	this->stealsCount = 0;
+
+	if (count == 0)
+	{
+		return;
+	}
+
+	size_t workersCount = std::min(this->threadsCount, count);
+
+	std::unique_ptr<WorkRange[]> ranges(new WorkRange[workersCount]);
+	for (size_t i = 0; i < workersCount; i++)
+	{
+		ranges[i].begin = (count * i) / workersCount;
+		ranges[i].end = (count * (i + 1)) / workersCount;
+	}
+
+	std::vector<std::thread> workers;
+	workers.reserve(workersCount - 1);
+	for (size_t i = 1; i < workersCount; i++)
+	{
+		workers.emplace_back(&WorkStealingPool::WorkerLoop, this, i, ranges.get(), workersCount, std::cref(func));
+	}
+
+	this->WorkerLoop(0, ranges.get(), workersCount, func);
+
+	for (auto & w : workers)
+	{
+		w.join();
+	}
+}
+
+void WorkStealingPool::WorkerLoop(size_t worker, WorkRange * ranges, size_t rangesCount,
+	const std::function<void(size_t index, size_t worker)> & func)
+{
+	WorkRange & own = ranges[worker];
+
+	while (true)
+	{
+		size_t index = 0;
+		bool hasWork = false;
+		{
+			std::lock_guard<std::mutex> lock(own.lock);
+			if (own.begin < own.end)
+			{
+				index = own.begin;
+				own.begin++;
+				hasWork = true;
+			}
+		}
+
+		if (hasWork)
+		{
+			func(index, worker);
+			continue;
+		}
+
+		if (this->Steal(worker, ranges, rangesCount) == false)
+		{
+			//no work is left (work is never added during Run)
+			return;
+		}
+	}
+}
+
+/// <summary>
+/// Move upper half of the largest remaining range to range of worker.
+/// Only one lock is held at a time
+/// </summary>
+/// <param name="worker">thief</param>
+/// <param name="ranges">ranges of all workers</param>
+/// <param name="rangesCount">number of ranges</param>
+/// <returns>false if there is nothing to steal</returns>
+bool WorkStealingPool::Steal(size_t worker, WorkRange * ranges, size_t rangesCount)
+{
+	while (true)
+	{
+		size_t victim = worker;
+		size_t victimSize = 0;
+
+		for (size_t i = 1; i < rangesCount; i++)
+		{
+			size_t v = (worker + i) % rangesCount;
+
+			std::lock_guard<std::mutex> lock(ranges[v].lock);
+			size_t size = ranges[v].end - ranges[v].begin;
+			if (size > victimSize)
+			{
+				victim = v;
+				victimSize = size;
+			}
+		}
+
+		if (victimSize == 0)
+		{
+			return false;
+		}
+
+		size_t begin = 0;
+		size_t end = 0;
+		{
+			std::lock_guard<std::mutex> lock(ranges[victim].lock);
+			size_t size = ranges[victim].end - ranges[victim].begin;
+			if (size == 0)
+			{
+				//victim finished its work in the meantime
+				continue;
+			}
+
+			end = ranges[victim].end;
+			begin = end - (size + 1) / 2;
+			ranges[victim].end = begin;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(ranges[worker].lock);
+			ranges[worker].begin = begin;
+			ranges[worker].end = end;
+		}
+
+		this->stealsCount++;
+		return true;
+	}
+}
@@ -0,0 +1,48 @@
+#ifndef WORK_STEALING_POOL_H
+#define WORK_STEALING_POOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <functional>
+#include <memory>
+#include <atomic>
+
+/// <summary>
+/// Parallel loop over range of indices with work stealing.
+/// Range is split to continuous parts, one for each worker
+/// (neighbouring indices stay on the same thread).
+/// Worker takes indices from the front of its own part,
+/// worker without work steals upper half of the largest remaining part.
+///
+/// Workers are started for each Run, calling thread is worker 0
+/// </summary>
+class WorkStealingPool
+{
+	public:
+		WorkStealingPool(size_t threadsCount = 0);
+		~WorkStealingPool() = default;
+
+		size_t GetThreadsCount() const;
+		size_t GetStealsCount() const;
+
+		void Run(size_t count, std::function<void(size_t index, size_t worker)> func);
+
+	private:
+		typedef struct WorkRange
+		{
+			std::mutex lock;
+			size_t begin;
+			size_t end;
+		} WorkRange;
+
+		size_t threadsCount;
+		std::atomic<size_t> stealsCount;
+
+		void WorkerLoop(size_t worker, WorkRange * ranges, size_t rangesCount,
+			const std::function<void(size_t index, size_t worker)> & func);
+
+		bool Steal(size_t worker, WorkRange * ranges, size_t rangesCount);
+};
+
+#endif
@@ -0,0 +1,132 @@
+#include "./MappedFile.h"
+
+#include <cstdio>
+#include <limits>
+
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+#endif
+
+MappedFile::MappedFile() :
+	data(nullptr),
+	size(0)
+#ifdef _WIN32
+	, fileHandle(INVALID_HANDLE_VALUE),
+	mappingHandle(nullptr)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef _WIN32
+	if (this->data != nullptr)
+	{
+		UnmapViewOfFile(this->data);
+	}
+	if (this->mappingHandle != nullptr)
+	{
+		CloseHandle(this->mappingHandle);
+	}
+	if (this->fileHandle != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(this->fileHandle);
+	}
+#else
+	if (this->data != nullptr)
+	{
+		munmap(const_cast<uint8_t *>(this->data), static_cast<size_t>(this->size));
+	}
+#endif
+}
+
+/*-----------------------------------------------------------
+Function:	Open
+Parameters:
+	[in] path - OS path to file
+Returns:
+	mapped file or nullptr if mapping failed
+
+Map entire file to memory (read-only)
+Mapping fails for empty files or for files larger than
+address space (32-bit builds)
+-------------------------------------------------------------*/
+std::shared_ptr<MappedFile> MappedFile::Open(const MyStringAnsi & path)
+{
+	std::shared_ptr<MappedFile> mf = std::shared_ptr<MappedFile>(new MappedFile());
+
+#ifdef _WIN32
+	HANDLE fh = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (fh == INVALID_HANDLE_VALUE)
+	{
+		return nullptr;
+	}
+	mf->fileHandle = fh;
+
+	LARGE_INTEGER fileSize;
+	if ((GetFileSizeEx(fh, &fileSize) == FALSE) || (fileSize.QuadPart == 0) ||
+		(static_cast<uint64_t>(fileSize.QuadPart) > std::numeric_limits<size_t>::max()))
+	{
+		return nullptr;
+	}
+	mf->size = static_cast<uint64_t>(fileSize.QuadPart);
+
+	mf->mappingHandle = CreateFileMappingA(fh, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mf->mappingHandle == nullptr)
+	{
+		return nullptr;
+	}
+
+	mf->data = static_cast<const uint8_t *>(MapViewOfFile(mf->mappingHandle, FILE_MAP_READ, 0, 0, 0));
+#else
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		return nullptr;
+	}
+
+	struct stat sb;
+	if ((fstat(fd, &sb) != 0) || (sb.st_size == 0) ||
+		(static_cast<uint64_t>(sb.st_size) > std::numeric_limits<size_t>::max()))
+	{
+		close(fd);
+		return nullptr;
+	}
+	mf->size = static_cast<uint64_t>(sb.st_size);
+
+	void * ptr = mmap(nullptr, static_cast<size_t>(mf->size), PROT_READ, MAP_SHARED, fd, 0);
+
+	//mapping keeps its own reference to file
+	close(fd);
+
+	if (ptr == MAP_FAILED)
+	{
+		return nullptr;
+	}
+	mf->data = static_cast<const uint8_t *>(ptr);
+#endif
+
+	if (mf->data == nullptr)
+	{
+		printf("[VFS Error] Failed to map file %s\n", path.c_str());
+		return nullptr;
+	}
+
+	return mf;
+}
+
+const uint8_t * MappedFile::GetData() const
+{
+	return this->data;
+}
+
+uint64_t MappedFile::GetSize() const
+{
+	return this->size;
+}
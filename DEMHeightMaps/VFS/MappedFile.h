@@ -0,0 +1,37 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstdint>
+#include <memory>
+
+#include "../Strings/MyString.h"
+
+/*-----------------------------------------------------------
+Class:	MappedFile
+
+Read-only memory mapping of entire OS file.
+Mapping is released, when last shared_ptr is destroyed
+-------------------------------------------------------------*/
+class MappedFile
+{
+	public:
+		static std::shared_ptr<MappedFile> Open(const MyStringAnsi & path);
+
+		~MappedFile();
+
+		const uint8_t * GetData() const;
+		uint64_t GetSize() const;
+
+	private:
+		const uint8_t * data;
+		uint64_t size;
+
+#ifdef _WIN32
+		void * fileHandle;
+		void * mappingHandle;
+#endif
+
+		MappedFile();
+};
+
+#endif
@@ -0,0 +1,887 @@
+#include "./PackedFS.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include <zlib.h>
+
+#ifdef _MSC_VER
+	#include <io.h>
+#else
+	#include <unistd.h>
+#endif
+
+#define PACKED_FS_BUFFER_SIZE (1024 * 1024)
+
+//============================================================================
+//=========================== Writer =========================================
+//============================================================================
+
+PackedFSWriter::PackedFSWriter(const MyStringAnsi & fileName, uint32_t alignment, uint32_t frameSize) :
+	f(nullptr),
+	alignment(alignment),
+	pos(0),
+	entryStart(0),
+	endPos(0),
+	fileOpened(false),
+	zs(nullptr),
+	frameSize(frameSize),
+	frameFill(0)
+{
+	if (this->alignment == 0)
+	{
+		this->alignment = 1;
+	}
+	if (this->frameSize == 0)
+	{
+		this->frameSize = PACKED_FS_FRAME_SIZE;
+	}
+
+	my_fopen(&this->f, fileName.c_str(), "wb");
+	if (this->f == nullptr)
+	{
+		printf("[VFS Error] Failed to create packed file %s\n", fileName.c_str());
+		return;
+	}
+
+	//header placeholder - it is rewritten in Finish,
+	//once directory position is known
+	char header[30];
+	memset(header, 0, sizeof(header));
+	this->WriteRaw(header, sizeof(header));
+}
+
+PackedFSWriter::~PackedFSWriter()
+{
+	if (this->zs != nullptr)
+	{
+		deflateEnd(static_cast<z_stream *>(this->zs));
+		delete static_cast<z_stream *>(this->zs);
+	}
+
+	if (this->f != nullptr)
+	{
+		fclose(this->f);
+	}
+}
+
+bool PackedFSWriter::IsOpened() const
+{
+	return this->f != nullptr;
+}
+
+const PackedFSEntry & PackedFSWriter::GetLastEntry() const
+{
+	return this->entries.back();
+}
+
+bool PackedFSWriter::WriteRaw(const void * data, size_t dataSize)
+{
+	if (fwrite(data, sizeof(uint8_t), dataSize, this->f) != dataSize)
+	{
+		return false;
+	}
+
+	this->pos += dataSize;
+	this->endPos = std::max(this->endPos, this->pos);
+	return true;
+}
+
+/*-----------------------------------------------------------
+Function:	BeginFile
+Parameters:
+	[in] path - VFS path of new file
+	[in] compression - how data are stored in archive
+Returns:
+	true if OK
+
+Start new file. Data are aligned to archive alignment,
+so stored files can be directly mapped
+-------------------------------------------------------------*/
+bool PackedFSWriter::BeginFile(const MyStringAnsi & path, VFS_COMPRESSION compression)
+{
+	if ((this->f == nullptr) || (this->fileOpened))
+	{
+		return false;
+	}
+
+	this->entryStart = this->pos;
+
+	uint64_t padding = (this->alignment - (this->pos % this->alignment)) % this->alignment;
+	if (padding != 0)
+	{
+		std::vector<uint8_t> zeros(static_cast<size_t>(padding), 0);
+		if (this->WriteRaw(zeros.data(), zeros.size()) == false)
+		{
+			this->Rewind(this->entryStart);
+			return false;
+		}
+	}
+
+	PackedFSEntry e;
+	e.path = path;
+	e.offset = this->pos;
+	e.size = 0;
+	e.storedSize = 0;
+	e.compression = compression;
+
+	if ((compression == VFS_COMPRESSION::DEFLATE) || (compression == VFS_COMPRESSION::DEFLATE_FRAMES))
+	{
+		if (this->zs == nullptr)
+		{
+			this->zs = new z_stream;
+		}
+		z_stream * s = static_cast<z_stream *>(this->zs);
+		memset(s, 0, sizeof(z_stream));
+
+		//raw deflate without zlib header - same as data in zip
+		if (deflateInit2(s, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+		{
+			this->Rewind(this->entryStart);
+			return false;
+		}
+
+		this->outBuffer.resize(PACKED_FS_BUFFER_SIZE);
+
+		this->frameFill = 0;
+		this->frameOffsets.clear();
+		this->frameOffsets.push_back(0);
+	}
+
+	this->entries.push_back(e);
+	this->fileOpened = true;
+
+	return true;
+}
+
+bool PackedFSWriter::WriteCompressed(const void * data, size_t dataSize, bool finish)
+{
+	z_stream * s = static_cast<z_stream *>(this->zs);
+	s->next_in = static_cast<Bytef *>(const_cast<void *>(data));
+	s->avail_in = static_cast<uInt>(dataSize);
+
+	do
+	{
+		s->next_out = this->outBuffer.data();
+		s->avail_out = static_cast<uInt>(this->outBuffer.size());
+
+		int res = deflate(s, finish ? Z_FINISH : Z_NO_FLUSH);
+		if (res == Z_STREAM_ERROR)
+		{
+			return false;
+		}
+
+		size_t written = this->outBuffer.size() - s->avail_out;
+		if (this->WriteRaw(this->outBuffer.data(), written) == false)
+		{
+			return false;
+		}
+		this->entries.back().storedSize += written;
+
+	} while (s->avail_out == 0);
+
+	return true;
+}
+
+/*-----------------------------------------------------------
+Function:	WriteData
+Parameters:
+	[in] data - part of file data
+	[in] dataSize - size of data
+Returns:
+	true if OK
+
+Append data to currently opened file
+-------------------------------------------------------------*/
+bool PackedFSWriter::WriteData(const void * data, size_t dataSize)
+{
+	if (this->fileOpened == false)
+	{
+		return false;
+	}
+
+	PackedFSEntry & e = this->entries.back();
+	e.size += dataSize;
+
+	if (e.compression == VFS_COMPRESSION::DEFLATE_FRAMES)
+	{
+		return this->WriteFrames(data, dataSize);
+	}
+
+	if (e.compression == VFS_COMPRESSION::DEFLATE)
+	{
+		//WriteCompressed uses uInt counts - split very large blocks
+		const uint8_t * ptr = static_cast<const uint8_t *>(data);
+		while (dataSize > 0)
+		{
+			size_t block = std::min<size_t>(dataSize, PACKED_FS_BUFFER_SIZE);
+			if (this->WriteCompressed(ptr, block, false) == false)
+			{
+				return false;
+			}
+			ptr += block;
+			dataSize -= block;
+		}
+		return true;
+	}
+
+	e.storedSize += dataSize;
+	return this->WriteRaw(data, dataSize);
+}
+
+/*-----------------------------------------------------------
+Function:	WriteFrames
+Parameters:
+	[in] data - part of file data
+	[in] dataSize - size of data
+Returns:
+	true if OK
+
+Compress data to independent frames. Each frame is finished
+after frameSize uncompressed bytes and deflate is reset,
+so every frame can be inflated separately
+-------------------------------------------------------------*/
+bool PackedFSWriter::WriteFrames(const void * data, size_t dataSize)
+{
+	const uint8_t * ptr = static_cast<const uint8_t *>(data);
+	while (dataSize > 0)
+	{
+		size_t block = static_cast<size_t>(std::min<uint64_t>(dataSize, this->frameSize - this->frameFill));
+		bool frameFull = (this->frameFill + block == this->frameSize);
+
+		if (this->WriteCompressed(ptr, block, frameFull) == false)
+		{
+			return false;
+		}
+
+		this->frameFill += block;
+		ptr += block;
+		dataSize -= block;
+
+		if (frameFull)
+		{
+			this->frameOffsets.push_back(this->entries.back().storedSize);
+			this->frameFill = 0;
+			deflateReset(static_cast<z_stream *>(this->zs));
+		}
+	}
+
+	return true;
+}
+
+/*-----------------------------------------------------------
+Function:	FinishFrames
+Returns:
+	true if OK
+
+Finish last (partial) frame and write frame index
+and trailer at the end of entry data
+-------------------------------------------------------------*/
+bool PackedFSWriter::FinishFrames()
+{
+	bool ok = true;
+	if (this->frameFill > 0)
+	{
+		ok &= this->WriteCompressed(nullptr, 0, true);
+		this->frameOffsets.push_back(this->entries.back().storedSize);
+		this->frameFill = 0;
+	}
+
+	uint32_t frameCount = static_cast<uint32_t>(this->frameOffsets.size() - 1);
+
+	ok &= this->WriteRaw(this->frameOffsets.data(), this->frameOffsets.size() * sizeof(uint64_t));
+	ok &= this->WriteRaw(&this->frameSize, sizeof(uint32_t));
+	ok &= this->WriteRaw(&frameCount, sizeof(uint32_t));
+
+	this->entries.back().storedSize += this->frameOffsets.size() * sizeof(uint64_t) + 2 * sizeof(uint32_t);
+
+	return ok;
+}
+
+bool PackedFSWriter::EndFile()
+{
+	if (this->fileOpened == false)
+	{
+		return false;
+	}
+
+	this->fileOpened = false;
+
+	if (this->entries.back().compression == VFS_COMPRESSION::DEFLATE)
+	{
+		bool res = this->WriteCompressed(nullptr, 0, true);
+		deflateEnd(static_cast<z_stream *>(this->zs));
+		return res;
+	}
+
+	if (this->entries.back().compression == VFS_COMPRESSION::DEFLATE_FRAMES)
+	{
+		bool res = this->FinishFrames();
+		deflateEnd(static_cast<z_stream *>(this->zs));
+		return res;
+	}
+
+	return true;
+}
+
+/*-----------------------------------------------------------
+Function:	DiscardFile
+
+Remove last file from archive. Must be called only for
+file started by successful BeginFile (and not discarded yet).
+Write position is moved before padding of the file, so its
+data are overwritten by the next file (or cut off in Finish)
+-------------------------------------------------------------*/
+void PackedFSWriter::DiscardFile()
+{
+	if (this->fileOpened)
+	{
+		this->EndFile();
+	}
+
+	if (this->entries.empty())
+	{
+		return;
+	}
+
+	this->entries.pop_back();
+	this->Rewind(this->entryStart);
+}
+
+void PackedFSWriter::Rewind(uint64_t position)
+{
+	this->pos = position;
+	my_fseek(this->f, this->pos, SEEK_SET);
+}
+
+/*-----------------------------------------------------------
+Function:	Finish
+Returns:
+	true if OK
+
+Write directory and close the archive
+-------------------------------------------------------------*/
+bool PackedFSWriter::Finish()
+{
+	if ((this->f == nullptr) || (this->fileOpened))
+	{
+		return false;
+	}
+
+	uint64_t directoryOffset = this->pos;
+
+	bool ok = true;
+	for (const auto & e : this->entries)
+	{
+		uint16_t nameLength = static_cast<uint16_t>(e.path.length());
+
+		ok &= this->WriteRaw(&e.offset, sizeof(uint64_t));
+		ok &= this->WriteRaw(&e.size, sizeof(uint64_t));
+		ok &= this->WriteRaw(&e.storedSize, sizeof(uint64_t));
+		ok &= this->WriteRaw(&e.compression, sizeof(uint8_t));
+		ok &= this->WriteRaw(&nameLength, sizeof(uint16_t));
+		ok &= this->WriteRaw(e.path.c_str(), nameLength);
+	}
+
+	uint64_t archiveSize = this->pos;
+
+	//rewrite header
+	my_fseek(this->f, 0, SEEK_SET);
+
+	uint32_t marker = PACKED_FS_V2_MARKER;
+	uint32_t version = PACKED_FS_VERSION;
+	uint64_t fileCount = this->entries.size();
+
+	ok &= fwrite("VD", sizeof(char), 2, this->f) == 2;
+	ok &= fwrite(&marker, sizeof(uint32_t), 1, this->f) == 1;
+	ok &= fwrite(&version, sizeof(uint32_t), 1, this->f) == 1;
+	ok &= fwrite(&this->alignment, sizeof(uint32_t), 1, this->f) == 1;
+	ok &= fwrite(&fileCount, sizeof(uint64_t), 1, this->f) == 1;
+	ok &= fwrite(&directoryOffset, sizeof(uint64_t), 1, this->f) == 1;
+
+	//cut off data of discarded files behind directory
+	if (this->endPos > archiveSize)
+	{
+		ok &= fflush(this->f) == 0;
+		ok &= my_ftruncate(this->f, archiveSize) == 0;
+	}
+
+	ok &= fclose(this->f) == 0;
+	this->f = nullptr;
+
+	return ok;
+}
+
+//============================================================================
+//=========================== Reader =========================================
+//============================================================================
+
+PackedFSReader::PackedFSReader(const MyStringAnsi & fileName) :
+	f(nullptr),
+	version(0),
+	fileCount(0),
+	directoryOffset(0)
+{
+	my_fopen(&this->f, fileName.c_str(), "rb");
+	if (this->f == nullptr)
+	{
+		return;
+	}
+
+	char header[2];
+	uint32_t count = 0;
+	if ((fread(header, sizeof(char), 2, this->f) != 2) ||
+		(header[0] != 'V') || (header[1] != 'D') ||
+		(fread(&count, sizeof(uint32_t), 1, this->f) != 1))
+	{
+		fclose(this->f);
+		this->f = nullptr;
+		return;
+	}
+
+	if (count != PACKED_FS_V2_MARKER)
+	{
+		this->version = 1;
+		this->fileCount = count;
+		return;
+	}
+
+	uint32_t alignment = 0;
+	if ((fread(&this->version, sizeof(uint32_t), 1, this->f) != 1) ||
+		(fread(&alignment, sizeof(uint32_t), 1, this->f) != 1) ||
+		(fread(&this->fileCount, sizeof(uint64_t), 1, this->f) != 1) ||
+		(fread(&this->directoryOffset, sizeof(uint64_t), 1, this->f) != 1))
+	{
+		printf("[VFS Error] Truncated packed file header %s\n", fileName.c_str());
+		fclose(this->f);
+		this->f = nullptr;
+		return;
+	}
+
+	if (this->version != PACKED_FS_VERSION)
+	{
+		printf("[VFS Error] Unsupported packed file version %u\n", this->version);
+		fclose(this->f);
+		this->f = nullptr;
+	}
+}
+
+PackedFSReader::~PackedFSReader()
+{
+	if (this->f != nullptr)
+	{
+		fclose(this->f);
+	}
+}
+
+bool PackedFSReader::IsOpened() const
+{
+	return this->f != nullptr;
+}
+
+bool PackedFSReader::ReadEntryV2(PackedFSEntry & e)
+{
+	uint16_t nameLength = 0;
+
+	if ((fread(&e.offset, sizeof(uint64_t), 1, this->f) != 1) ||
+		(fread(&e.size, sizeof(uint64_t), 1, this->f) != 1) ||
+		(fread(&e.storedSize, sizeof(uint64_t), 1, this->f) != 1) ||
+		(fread(&e.compression, sizeof(uint8_t), 1, this->f) != 1) ||
+		(fread(&nameLength, sizeof(uint16_t), 1, this->f) != 1))
+	{
+		return false;
+	}
+
+	char * n = new char[nameLength + 1];
+	if (fread(n, sizeof(char), nameLength, this->f) != nameLength)
+	{
+		delete[] n;
+		return false;
+	}
+	n[nameLength] = 0;
+
+	e.path = MyStringAnsi::CreateFromMoveMemory(n, nameLength + 1, nameLength);
+
+	return true;
+}
+
+/*-----------------------------------------------------------
+Function:	ReadDirectory
+Parameters:
+	[out] entries - all files in archive
+Returns:
+	true if OK
+
+Read all entries of v1 or v2 archive
+-------------------------------------------------------------*/
+bool PackedFSReader::ReadDirectory(std::vector<PackedFSEntry> & entries)
+{
+	if (this->f == nullptr)
+	{
+		return false;
+	}
+
+	entries.reserve(entries.size() + static_cast<size_t>(this->fileCount));
+
+	if (this->version == 1)
+	{
+		my_fseek(this->f, 2 + sizeof(uint32_t), SEEK_SET);
+
+		for (uint64_t fi = 0; fi < this->fileCount; fi++)
+		{
+			uint32_t fileSize = 0;
+			uint32_t dataOffset = 0;
+			uint16_t nameLength = 0;
+
+			fread(&fileSize, sizeof(uint32_t), 1, this->f);
+			fread(&dataOffset, sizeof(uint32_t), 1, this->f);
+			fread(&nameLength, sizeof(uint16_t), 1, this->f);
+
+			char * n = new char[nameLength + 1];
+			if (fread(n, sizeof(char), nameLength, this->f) != nameLength)
+			{
+				delete[] n;
+				return false;
+			}
+			n[nameLength] = 0;
+
+			PackedFSEntry e;
+			e.path = MyStringAnsi::CreateFromMoveMemory(n, nameLength + 1, nameLength);
+			e.offset = dataOffset;
+			e.size = fileSize;
+			e.storedSize = fileSize;
+			e.compression = VFS_COMPRESSION::STORED;
+
+			entries.push_back(std::move(e));
+		}
+
+		return true;
+	}
+
+	my_fseek(this->f, this->directoryOffset, SEEK_SET);
+	for (uint64_t fi = 0; fi < this->fileCount; fi++)
+	{
+		PackedFSEntry e;
+		if (this->ReadEntryV2(e) == false)
+		{
+			return false;
+		}
+		entries.push_back(std::move(e));
+	}
+
+	return true;
+}
+
+//============================================================================
+//=========================== Stream =========================================
+//============================================================================
+
+PackedFSStream::PackedFSStream() :
+	f(nullptr),
+	zs(nullptr),
+	storedRemaining(0),
+	finished(false),
+	frames(false)
+{
+}
+
+PackedFSStream::~PackedFSStream()
+{
+	if (this->zs != nullptr)
+	{
+		inflateEnd(static_cast<z_stream *>(this->zs));
+		delete static_cast<z_stream *>(this->zs);
+	}
+
+	if (this->f != nullptr)
+	{
+		fclose(this->f);
+	}
+}
+
+/*-----------------------------------------------------------
+Function:	Open
+Parameters:
+	[in] archivePath - OS path of packed archive
+	[in] file - compressed file within archive
+Returns:
+	opened stream or NULL
+
+Open compressed entry for sequential reading
+Stream must be released with Close
+-------------------------------------------------------------*/
+PackedFSStream * PackedFSStream::Open(const MyStringAnsi & archivePath, const VFS_FILE * file)
+{
+	if ((file->compression != VFS_COMPRESSION::DEFLATE) && (file->compression != VFS_COMPRESSION::DEFLATE_FRAMES))
+	{
+		return nullptr;
+	}
+
+	PackedFSStream * s = new PackedFSStream();
+
+	my_fopen(&s->f, archivePath.c_str(), "rb");
+	if (s->f == nullptr)
+	{
+		delete s;
+		return nullptr;
+	}
+
+	s->storedRemaining = file->storedSize;
+
+	if (file->compression == VFS_COMPRESSION::DEFLATE_FRAMES)
+	{
+		//frames are read one after another, index is skipped
+		uint32_t frameCount = 0;
+		my_fseek(s->f, file->dataOffset + file->storedSize - sizeof(uint32_t), SEEK_SET);
+		if ((file->storedSize < 2 * sizeof(uint32_t) + sizeof(uint64_t)) ||
+			(fread(&frameCount, sizeof(uint32_t), 1, s->f) != 1))
+		{
+			delete s;
+			return nullptr;
+		}
+
+		s->frames = true;
+		s->storedRemaining = file->storedSize - 2 * sizeof(uint32_t) - (frameCount + 1) * sizeof(uint64_t);
+		s->finished = (frameCount == 0);
+	}
+
+	my_fseek(s->f, file->dataOffset, SEEK_SET);
+
+	z_stream * z = new z_stream;
+	memset(z, 0, sizeof(z_stream));
+	s->zs = z;
+
+	if (inflateInit2(z, -MAX_WBITS) != Z_OK)
+	{
+		delete z;
+		s->zs = nullptr;
+		delete s;
+		return nullptr;
+	}
+
+	s->inBuffer.resize(static_cast<size_t>(std::min<uint64_t>(file->storedSize, PACKED_FS_BUFFER_SIZE)) + 1);
+
+	return s;
+}
+
+void PackedFSStream::Close(PackedFSStream * stream)
+{
+	delete stream;
+}
+
+/*-----------------------------------------------------------
+Function:	Read
+Parameters:
+	[out] buffer - output buffer
+	[in] bytesCount - number of bytes to read
+Returns:
+	number of decompressed bytes
+
+Decompress next part of file
+-------------------------------------------------------------*/
+size_t PackedFSStream::Read(void * buffer, size_t bytesCount)
+{
+	z_stream * z = static_cast<z_stream *>(this->zs);
+
+	z->next_out = static_cast<Bytef *>(buffer);
+	z->avail_out = static_cast<uInt>(bytesCount);
+
+	while ((z->avail_out > 0) && (this->finished == false))
+	{
+		if ((z->avail_in == 0) && (this->storedRemaining > 0))
+		{
+			size_t toRead = static_cast<size_t>(std::min<uint64_t>(this->storedRemaining, this->inBuffer.size()));
+			size_t read = fread(this->inBuffer.data(), sizeof(uint8_t), toRead, this->f);
+			if (read == 0)
+			{
+				break;
+			}
+
+			this->storedRemaining -= read;
+			z->next_in = this->inBuffer.data();
+			z->avail_in = static_cast<uInt>(read);
+		}
+
+		int res = inflate(z, Z_NO_FLUSH);
+		if ((res == Z_STREAM_END) && (this->frames) && ((z->avail_in > 0) || (this->storedRemaining > 0)))
+		{
+			//end of frame - next frame is independent stream
+			inflateReset(z);
+		}
+		else if (res == Z_STREAM_END)
+		{
+			this->finished = true;
+		}
+		else if (res != Z_OK)
+		{
+			printf("[VFS Error] Failed to inflate packed file: %i\n", res);
+			this->finished = true;
+		}
+	}
+
+	return bytesCount - z->avail_out;
+}
+
+//============================================================================
+//=========================== Frames =========================================
+//============================================================================
+
+/*-----------------------------------------------------------
+Function:	PackedFSFrames
+Parameters:
+	[in] data - entry data (frames, index and trailer)
+	[in] storedSize - size of entry data
+	[in] fileSize - uncompressed size of file
+
+Parse frame index of DEFLATE_FRAMES entry
+-------------------------------------------------------------*/
+PackedFSFrames::PackedFSFrames(const uint8_t * data, uint64_t storedSize, uint64_t fileSize) :
+	data(data),
+	index(nullptr),
+	fileSize(fileSize),
+	frameSize(0),
+	frameCount(0)
+{
+	if ((data == nullptr) || (storedSize < 2 * sizeof(uint32_t) + sizeof(uint64_t)))
+	{
+		return;
+	}
+
+	const uint8_t * trailer = data + storedSize - 2 * sizeof(uint32_t);
+	memcpy(&this->frameSize, trailer, sizeof(uint32_t));
+	memcpy(&this->frameCount, trailer + sizeof(uint32_t), sizeof(uint32_t));
+
+	uint64_t indexSize = (static_cast<uint64_t>(this->frameCount) + 1) * sizeof(uint64_t);
+	if ((this->frameSize == 0) || (indexSize + 2 * sizeof(uint32_t) > storedSize) ||
+		(static_cast<uint64_t>(this->frameCount) * this->frameSize < fileSize))
+	{
+		this->frameCount = 0;
+		return;
+	}
+
+	this->index = trailer - indexSize;
+}
+
+bool PackedFSFrames::IsValid() const
+{
+	return this->index != nullptr;
+}
+
+uint32_t PackedFSFrames::GetFrameSize() const
+{
+	return this->frameSize;
+}
+
+uint64_t PackedFSFrames::GetFrameOffset(uint32_t frame) const
+{
+	uint64_t offset = 0;
+	memcpy(&offset, this->index + frame * sizeof(uint64_t), sizeof(uint64_t));
+	return offset;
+}
+
+/*-----------------------------------------------------------
+Function:	Read
+Parameters:
+	[in] offset - offset within uncompressed file
+	[out] buffer - output buffer
+	[in] bytesCount - number of bytes to read
+Returns:
+	number of bytes read
+
+Decompress only frames covering requested range.
+Frames fully covered by range are inflated directly to buffer
+-------------------------------------------------------------*/
+size_t PackedFSFrames::Read(uint64_t offset, void * buffer, size_t bytesCount) const
+{
+	if ((this->IsValid() == false) || (offset >= this->fileSize))
+	{
+		return 0;
+	}
+
+	bytesCount = static_cast<size_t>(std::min<uint64_t>(bytesCount, this->fileSize - offset));
+	if (bytesCount == 0)
+	{
+		return 0;
+	}
+
+	z_stream z;
+	memset(&z, 0, sizeof(z_stream));
+	if (inflateInit2(&z, -MAX_WBITS) != Z_OK)
+	{
+		return 0;
+	}
+
+	std::vector<uint8_t> frameBuffer;
+	uint8_t * out = static_cast<uint8_t *>(buffer);
+	size_t written = 0;
+
+	uint32_t firstFrame = static_cast<uint32_t>(offset / this->frameSize);
+	uint32_t lastFrame = static_cast<uint32_t>((offset + bytesCount - 1) / this->frameSize);
+
+	for (uint32_t i = firstFrame; i <= lastFrame; i++)
+	{
+		uint64_t frameStart = static_cast<uint64_t>(i) * this->frameSize;
+		uint64_t frameLength = std::min<uint64_t>(this->frameSize, this->fileSize - frameStart);
+
+		uint64_t copyStart = std::max<uint64_t>(offset, frameStart) - frameStart;
+		uint64_t copyEnd = std::min<uint64_t>(offset + bytesCount, frameStart + frameLength) - frameStart;
+
+		uint8_t * dst = out + written;
+		if ((copyStart != 0) || (copyEnd != frameLength))
+		{
+			//partially covered frame - decompress to temporary buffer
+			frameBuffer.resize(static_cast<size_t>(frameLength));
+			dst = frameBuffer.data();
+		}
+
+		uint64_t compressedStart = this->GetFrameOffset(i);
+		uint64_t compressedEnd = this->GetFrameOffset(i + 1);
+
+		inflateReset(&z);
+		z.next_in = const_cast<Bytef *>(this->data + compressedStart);
+		z.avail_in = static_cast<uInt>(compressedEnd - compressedStart);
+		z.next_out = dst;
+		z.avail_out = static_cast<uInt>(frameLength);
+
+		int res = inflate(&z, Z_FINISH);
+		if ((res != Z_STREAM_END) || (z.avail_out != 0))
+		{
+			printf("[VFS Error] Failed to inflate frame %u: %i\n", i, res);
+			break;
+		}
+
+		if (dst != out + written)
+		{
+			memcpy(out + written, dst + copyStart, static_cast<size_t>(copyEnd - copyStart));
+		}
+		written += static_cast<size_t>(copyEnd - copyStart);
+	}
+
+	inflateEnd(&z);
+
+	return written;
+}
+
+/*-----------------------------------------------------------
+Function:	GetStoredSize
+Parameters:
+	[in] offset - offset within uncompressed file
+	[in] bytesCount - number of bytes
+Returns:
+	size of compressed frames covering range
+-------------------------------------------------------------*/
+uint64_t PackedFSFrames::GetStoredSize(uint64_t offset, size_t bytesCount) const
+{
+	if ((this->IsValid() == false) || (offset >= this->fileSize) || (bytesCount == 0))
+	{
+		return 0;
+	}
+
+	uint64_t end = std::min<uint64_t>(offset + bytesCount, this->fileSize);
+
+	uint32_t firstFrame = static_cast<uint32_t>(offset / this->frameSize);
+	uint32_t lastFrame = static_cast<uint32_t>((end - 1) / this->frameSize);
+
+	return this->GetFrameOffset(lastFrame + 1) - this->GetFrameOffset(firstFrame);
+}
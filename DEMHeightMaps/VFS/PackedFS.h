@@ -0,0 +1,191 @@
+#ifndef PACKED_FS_H
+#define PACKED_FS_H
+
+#include <cstdio>
+#include <cstdint>
+#include <vector>
+
+#include "./VFS.h"
+
+#include "../Strings/MyString.h"
+
+/*====================================
+
+PACKED_FS archive
+
+v1 layout:
+	"VD"
+	uint32 fileCount
+	fileCount x { uint32 size, uint32 offset, uint16 nameLength, name }
+	data
+
+v2 layout:
+	"VD"
+	uint32 marker (0xFFFFFFFF - v1 file count can never have this value)
+	uint32 version
+	uint32 alignment
+	uint64 fileCount
+	uint64 directoryOffset
+	data - each entry starts at multiple of alignment
+	directory - fileCount x { uint64 offset, uint64 size, uint64 storedSize,
+	                          uint8 compression, uint16 nameLength, name }
+	(directory is always read whole - VFS tree is built from it)
+
+DEFLATE_FRAMES entry data:
+	frames - frameCount x raw deflate stream of frameSize uncompressed bytes
+	         (last frame can be shorter)
+	index - (frameCount + 1) x uint64 frame offset relative to entry data start
+	        (last value is end of frames)
+	uint32 frameSize
+	uint32 frameCount
+
+=====================================*/
+
+#define PACKED_FS_V2_MARKER 0xFFFFFFFF
+#define PACKED_FS_VERSION 2
+#define PACKED_FS_ALIGNMENT 4096
+#define PACKED_FS_FRAME_SIZE (64 * 1024)
+
+/*-----------------------------------------------------------
+Struct:	PackedFSEntry
+
+Single file within packed archive
+-------------------------------------------------------------*/
+typedef struct PackedFSEntry
+{
+	MyStringAnsi path;		//full VFS path of file
+	uint64_t offset;		//absolute offset of data within archive
+	uint64_t size;			//uncompressed size of file
+	uint64_t storedSize;	//size of data within archive
+	uint8_t compression;	//VFS_COMPRESSION
+
+} PackedFSEntry;
+
+/*-----------------------------------------------------------
+Class:	PackedFSWriter
+
+Streaming writer of v2 archives. Files are added one by one
+with BeginFile / WriteData / EndFile, only directory
+is kept in memory until Finish is called
+-------------------------------------------------------------*/
+class PackedFSWriter
+{
+	public:
+		PackedFSWriter(const MyStringAnsi & fileName, uint32_t alignment = PACKED_FS_ALIGNMENT,
+			uint32_t frameSize = PACKED_FS_FRAME_SIZE);
+		~PackedFSWriter();
+
+		bool IsOpened() const;
+
+		bool BeginFile(const MyStringAnsi & path, VFS_COMPRESSION compression);
+		bool WriteData(const void * data, size_t dataSize);
+		bool EndFile();
+		void DiscardFile();
+
+		const PackedFSEntry & GetLastEntry() const;
+
+		bool Finish();
+
+	private:
+		FILE * f;
+		uint32_t alignment;
+		uint64_t pos;
+		uint64_t entryStart;	//position before padding of last begun file
+		uint64_t endPos;		//largest written position (data after discarded files)
+		bool fileOpened;
+
+		void * zs;
+		std::vector<uint8_t> outBuffer;
+
+		uint32_t frameSize;
+		uint64_t frameFill;				//uncompressed bytes in current frame
+		std::vector<uint64_t> frameOffsets;	//index of current DEFLATE_FRAMES entry
+
+		std::vector<PackedFSEntry> entries;
+
+		bool WriteRaw(const void * data, size_t dataSize);
+		void Rewind(uint64_t position);
+		bool WriteCompressed(const void * data, size_t dataSize, bool finish);
+		bool WriteFrames(const void * data, size_t dataSize);
+		bool FinishFrames();
+};
+
+/*-----------------------------------------------------------
+Class:	PackedFSReader
+
+Reader of v1 and v2 archives
+-------------------------------------------------------------*/
+class PackedFSReader
+{
+	public:
+		PackedFSReader(const MyStringAnsi & fileName);
+		~PackedFSReader();
+
+		bool IsOpened() const;
+
+		bool ReadDirectory(std::vector<PackedFSEntry> & entries);
+
+	private:
+		FILE * f;
+		uint32_t version;
+		uint64_t fileCount;
+		uint64_t directoryOffset;
+
+		bool ReadEntryV2(PackedFSEntry & entry);
+};
+
+/*-----------------------------------------------------------
+Class:	PackedFSStream
+
+Sequential reader of single compressed entry
+(DEFLATE or DEFLATE_FRAMES)
+-------------------------------------------------------------*/
+class PackedFSStream
+{
+	public:
+		static PackedFSStream * Open(const MyStringAnsi & archivePath, const VFS_FILE * file);
+		static void Close(PackedFSStream * stream);
+
+		size_t Read(void * buffer, size_t bytesCount);
+
+	private:
+		FILE * f;
+		void * zs;
+		uint64_t storedRemaining;
+		bool finished;
+		bool frames;
+		std::vector<uint8_t> inBuffer;
+
+		PackedFSStream();
+		~PackedFSStream();
+};
+
+/*-----------------------------------------------------------
+Class:	PackedFSFrames
+
+Random access into DEFLATE_FRAMES entry held in memory
+(usually mapped archive). Only frames covering requested
+range are decompressed
+-------------------------------------------------------------*/
+class PackedFSFrames
+{
+	public:
+		PackedFSFrames(const uint8_t * data, uint64_t storedSize, uint64_t fileSize);
+
+		bool IsValid() const;
+		uint32_t GetFrameSize() const;
+
+		size_t Read(uint64_t offset, void * buffer, size_t bytesCount) const;
+		uint64_t GetStoredSize(uint64_t offset, size_t bytesCount) const;
+
+	private:
+		const uint8_t * data;
+		const uint8_t * index;
+		uint64_t fileSize;
+		uint32_t frameSize;
+		uint32_t frameCount;
+
+		uint64_t GetFrameOffset(uint32_t frame) const;
+};
+
+#endif
@@ -2,10 +2,17 @@
 
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <algorithm>
 #include <errno.h>
 #include <unordered_map>
 
+#include <zlib.h>
+
 #include "./minizip/unzip.h"
+#include "./PackedFS.h"
+#include "./MappedFile.h"
 
 #ifdef _WIN32
 	#include "./win_dirent.h"
@@ -21,6 +28,8 @@
 	#include "../../OS_Android/AndroidUtils.h"
 #endif
 
+#define VFS_PACK_BUFFER_SIZE (1024 * 1024)
+
 //singleton instance of VFS
 VFS * VFS::single = nullptr;
 
@@ -29,7 +38,8 @@ Function:	ctor
 
 VFS Singleton private ctor
 -------------------------------------------------------------*/
-VFS::VFS()
+VFS::VFS() : 
+	hasRawDirs(false)
 {
 	this->fileSystem = new VFSTree();	
 }
@@ -51,6 +61,10 @@ Release VFS from memory
 -------------------------------------------------------------*/
 void VFS::Release()
 {		
+	this->archiveMappings.clear();
+	this->archiveMappingsFailed.clear();
+	this->resolved.clear();
+
 	delete this->fileSystem;
 	this->fileSystem = nullptr;	
 }
@@ -123,12 +137,12 @@ std::vector<VFS_FILE *> VFS::GetMainFiles() const
 
 const char * VFS::GetFileName(VFS_FILE * f) const
 {
-	return f->name;
+	return this->fileSystem->GetFileName(f);
 }
 
 const char * VFS::GetFileExt(VFS_FILE * f) const
 {
-	const char * n = f->name;
+	const char * n = this->fileSystem->GetFileName(f);
 	int i = strlen(n) - 1;
 	while ((i > 0) && (n[i] != '.') && (n[i] != '/') && (n[i] != '\\'))
 	{
@@ -389,90 +403,96 @@ int VFS::CopyAllFilesFromRawDir(const MyStringAnsi & dirPath, const MyStringAnsi
 	return 0;
 }
 
-void VFS::PackStructure(const MyStringAnsi & outputFile) const
-{	
+/*-----------------------------------------------------------
+Function:	PackStructure
+Parametrs:
+	[in] outputFile - path to created archive
+	[in] compression - compression of packed files
+
+Pack all files from VFS into single PACKED_FS (v2) archive.
+Files are streamed one by one, so only the directory is
+kept in memory. If compressed file is not smaller than
+the original one, it is stored uncompressed.
+DEFLATE_FRAMES creates seekable entries (see ReadAt)
+-------------------------------------------------------------*/
+void VFS::PackStructure(const MyStringAnsi & outputFile, VFS_COMPRESSION compression) const
+{
 	auto allFiles = this->GetAllFiles();
 
-
-	typedef struct FileInfo
-	{
-		size_t dataSize;
-		char * data;
-	} FileInfo;
-
-	std::unordered_map<MyStringAnsi, FileInfo> data;
-	for (auto vf : allFiles)
+	PackedFSWriter writer(outputFile);
+	if (writer.IsOpened() == false)
 	{
-		MyStringAnsi path = this->GetFilePath(vf);
-		FileInfo fi;
-		fi.data = this->GetFileContent(path, &fi.dataSize);
-
-		data[path] = fi;
+		return;
 	}
 
-	//=====================================================
-
-	//file size - uint32 nebo uint16 podle max velikosti
+	std::vector<char> buffer(VFS_PACK_BUFFER_SIZE);
 
-	uint32_t HEADER_SIZE = 0; //spocitat velikost "hlavicky"
-
-	HEADER_SIZE += 2 * sizeof(char); //header identification as "VD"
-
-	HEADER_SIZE += sizeof(uint32_t); //count of files
-
-
-	for (auto vf : allFiles)
-	{
-		MyStringAnsi tmp = this->GetFilePath(vf);
-
-		HEADER_SIZE += sizeof(uint32_t); //file size
-		HEADER_SIZE += sizeof(uint32_t); //data offset
-		HEADER_SIZE += sizeof(uint16_t); //file name length
-
-		HEADER_SIZE += tmp.length();
-		//HEADER_SIZE += sizeof(char); //ending block
+	auto packFile = [&](const MyStringAnsi & path, VFS_COMPRESSION c) -> bool {
+		VFS_FILE tmp;
+		VFS_FILE * f = this->OpenFile(path, &tmp);
+		if (f == nullptr)
+		{
+			return false;
+		}
 
-	}
+		if (writer.BeginFile(path, c) == false)
+		{
+			this->CloseFile(f);
+			return false;
+		}
 
-	//===================================================
+		bool ok = true;
+		size_t remaining = f->fileSize;
+		while ((ok) && (remaining > 0))
+		{
+			size_t toRead = std::min(remaining, buffer.size());
+			int read = this->Read(buffer.data(), sizeof(char), toRead, f);
+			if (read <= 0)
+			{
+				ok = false;
+				break;
+			}
 
-	FILE * f = nullptr;
-	my_fopen(&f, outputFile.c_str(), "wb");
+			ok = writer.WriteData(buffer.data(), static_cast<size_t>(read));
+			remaining -= static_cast<size_t>(read);
+		}
 
-	//header
-	fwrite("V", sizeof(char), 1, f);
-	fwrite("D", sizeof(char), 1, f);
+		this->CloseFile(f);
 
-	uint32_t s = static_cast<uint32_t>(allFiles.size());
-	fwrite(&s, sizeof(uint32_t), 1, f);
+		ok &= writer.EndFile();
+		if (ok == false)
+		{
+			//only begun file is removed, previous files stay in archive
+			writer.DiscardFile();
+		}
+		return ok;
+	};
 
-	uint32_t packedOffset = HEADER_SIZE;
 	for (auto vf : allFiles)
 	{
-		MyStringAnsi tmp = this->GetFilePath(vf);
+		MyStringAnsi path = this->GetFilePath(vf);
 
-		const FileInfo & fi = data[tmp];
-        uint32_t dataSize = static_cast<uint32_t>(fi.dataSize);
-		fwrite(&dataSize, sizeof(uint32_t), 1, f);
-		fwrite(&packedOffset, sizeof(uint32_t), 1, f);
-		packedOffset += fi.dataSize;
+		if (packFile(path, compression) == false)
+		{
+			printf("[VFS Error] Failed to pack file %s\n", path.c_str());
+			continue;
+		}
 
-		uint16_t fl = static_cast<uint16_t>(tmp.length());
-		fwrite(&fl, sizeof(uint16_t), 1, f);
-		fwrite(tmp.c_str(), sizeof(char), tmp.length(), f);
+		if ((compression != VFS_COMPRESSION::STORED) &&
+			(writer.GetLastEntry().storedSize >= writer.GetLastEntry().size))
+		{
+			writer.DiscardFile();
+			if (packFile(path, VFS_COMPRESSION::STORED) == false)
+			{
+				printf("[VFS Error] Failed to pack file %s\n", path.c_str());
+			}
+		}
 	}
 
-	for (auto vf : allFiles)
+	if (writer.Finish() == false)
 	{
-		MyStringAnsi tmp = this->GetFilePath(vf);
-
-		const FileInfo & fi = data[tmp];
-
-		fwrite(fi.data, sizeof(uint8_t), fi.dataSize, f);
+		printf("[VFS Error] Failed to finish packed file %s\n", outputFile.c_str());
 	}
-
-
-	fclose(f);
 }
 
 
@@ -499,115 +519,234 @@ bool VFS::IsFileInArchive(const MyStringAnsi & fileName) const
 	return file->archiveType != 0;
 }
 
+/*-----------------------------------------------------------
+Function:	GetRawFile
+Parametrs:
+	[in] path - file path within VFS
+Returns:
+	opened OS file or NULL (file is not in OS file system)
+
+Open file from OS file system. Location of file is taken
+from resolution cache, so there are no stat calls for
+already known files (including files from archives)
+-------------------------------------------------------------*/
 FILE * VFS::GetRawFile(const MyStringAnsi &path) const
 {
-#ifdef __ANDROID_API__
-	std::vector<MyStringAnsi> paths; //(this->initDirs.size());
-#endif
-
-	struct stat sb;
+	VFS_RESOLVED r = this->Resolve(path);
+	if (r.source != VFS_RESOLVED::RAW)
+	{
+		return nullptr;
+	}
 
-	for (MyStringAnsi p : this->initDirs)
+	if (FILE * tmpFile = this->OpenRawPath(r.fullPath))
 	{
-		p += '/';
-		p += path;
-		
-		if (stat(p.c_str(), &sb) == 0)
-		{			
-			FILE * tmpFile = nullptr;
-			my_fopen(&tmpFile, p.c_str(), "rb");
+		return tmpFile;
+	}
 
-			if (tmpFile)
-			{
-				return tmpFile;
-			}
-		}
+	//file was removed from OS file system since resolution
+	this->InvalidateResolved(path);
 
-#ifdef __ANDROID_API__
-		paths.push_back(p);
-#endif
+	r = this->Resolve(path);
+	if (r.source != VFS_RESOLVED::RAW)
+	{
+		return nullptr;
 	}
+	return this->OpenRawPath(r.fullPath);
+}
 
-    //try open file directly
-    //this allows us to use full file paths within VFS
-    //like: C:/dir/other_dir/file.txt
-    if (stat(path.c_str(), &sb) == 0)
-    {
-        FILE * tmpFile = nullptr;
-        my_fopen(&tmpFile, path.c_str(), "rb");
+MyStringAnsi VFS::GetRawFileFullPath(const MyStringAnsi &path) const
+{
+	VFS_RESOLVED r = this->Resolve(path);
+	if (r.source != VFS_RESOLVED::RAW)
+	{
+		return "";
+	}
+	
+	return r.fullPath;
+}
 
-        if (tmpFile)
-        {
-            return tmpFile;
-        }
-    }
-#ifdef __ANDROID_API__
-    paths.push_back(path);
-#endif
+FILE * VFS::OpenRawPath(const MyStringAnsi &fullPath) const
+{
+	FILE * tmpFile = nullptr;
+	my_fopen(&tmpFile, fullPath.c_str(), "rb");
 
-	
 #ifdef __ANDROID_API__
-	for (auto p : paths)
+	if (tmpFile == nullptr)
 	{
-        FILE * tmpFile = AndroidUtils::AssetFopen(p.c_str(), "rb");
-        if (tmpFile)
-        {
-            return tmpFile;
-        }
+		tmpFile = AndroidUtils::AssetFopen(fullPath.c_str(), "rb");
 	}
 #endif
-			
-	return nullptr;
+
+	return tmpFile;
 }
 
-MyStringAnsi VFS::GetRawFileFullPath(const MyStringAnsi &path) const
+/*-----------------------------------------------------------
+Function:	Resolve
+Parametrs:
+	[in] path - file path within VFS
+Returns:
+	location of file data
+
+Get location of file from cache. Unknown paths are resolved
+and added to cache. Method is thread-safe
+-------------------------------------------------------------*/
+VFS_RESOLVED VFS::Resolve(const MyStringAnsi &path) const
 {
-	for (auto p : this->initDirs)
 	{
-		p += '/';
-		p += path;
+		std::lock_guard<std::mutex> lock(this->resolvedLock);
 
-		struct stat sb;
-		if (stat(p.c_str(), &sb) == 0)
+		auto it = this->resolved.find(path);
+		if (it != this->resolved.end())
 		{
-			return p;
+			return it->second;
 		}
 	}
 
+	VFS_RESOLVED r = this->ResolveUncached(path);
 
-#ifdef __ANDROID_API__
-	for (auto p : this->initDirs)
+	std::lock_guard<std::mutex> lock(this->resolvedLock);
+	this->resolved[path] = r;
+
+	return r;
+}
+
+/*-----------------------------------------------------------
+Function:	ResolveUncached
+Parametrs:
+	[in] path - file path within VFS
+Returns:
+	location of file data
+
+Find file in OS file system (all init dirs, then path itself
+as full OS path). If not found, find it in VFS tree
+-------------------------------------------------------------*/
+VFS_RESOLVED VFS::ResolveUncached(const MyStringAnsi &path) const
+{
+	VFS_RESOLVED r;
+	r.source = VFS_RESOLVED::MISSING;
+	r.file = this->fileSystem->GetFile(path);
+
+	std::vector<MyStringAnsi> paths;
+	paths.reserve(this->initDirs.size() + 1);
+	for (MyStringAnsi p : this->initDirs)
 	{
 		p += '/';
 		p += path;
+		paths.push_back(p);
+	}
+
+	//try file directly
+	//this allows us to use full file paths within VFS
+	//like: C:/dir/other_dir/file.txt
+	paths.push_back(path);
+
+	struct stat sb;
+	for (auto & p : paths)
+	{
+		if (stat(p.c_str(), &sb) == 0)
+		{
+			//raw file hides archived file with the same path
+			r.source = VFS_RESOLVED::RAW;
+			r.fullPath = p;
+			r.file = nullptr;
+			return r;
+		}
+	}
 
+#ifdef __ANDROID_API__
+	for (auto & p : paths)
+	{
 		FILE * tmpFile = AndroidUtils::AssetFopen(p.c_str(), "rb");
 		if (tmpFile)
 		{
 			fclose(tmpFile);
-			return p;
+
+			r.source = VFS_RESOLVED::RAW;
+			r.fullPath = p;
+			r.file = nullptr;
+			return r;
 		}
 	}
 #endif
-	
-	return "";
+
+	if ((r.file != nullptr) && (r.file->archiveType != VFS_ARCHIVE_TYPE::NONE))
+	{
+		r.source = VFS_RESOLVED::ARCHIVE;
+	}
+	else
+	{
+		r.file = nullptr;
+	}
+
+	return r;
+}
+
+/*-----------------------------------------------------------
+Function:	AddResolved
+Parametrs:
+	[in] path - file path within VFS
+	[in] source - where data are located
+	[in] fullPath - OS path for RAW file
+	[in] file - file in VFS tree
+
+Add file found during directory scan to resolution cache.
+Files from OS file system have priority over files from archives,
+the first found file wins otherwise (same as in VFS tree).
+If there are raw directories, scanned files can be hidden by
+them - cache is filled lazily in that case
+-------------------------------------------------------------*/
+void VFS::AddResolved(const MyStringAnsi &path, VFS_RESOLVED::SOURCE source, const MyStringAnsi &fullPath, VFS_FILE * file)
+{
+	if (this->hasRawDirs)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(this->resolvedLock);
+
+	auto it = this->resolved.find(path);
+	if ((it != this->resolved.end()) &&
+		(it->second.source != VFS_RESOLVED::MISSING) &&
+		((it->second.source != VFS_RESOLVED::ARCHIVE) || (source != VFS_RESOLVED::RAW)))
+	{
+		return;
+	}
+
+	VFS_RESOLVED & r = this->resolved[path];
+	r.source = source;
+	r.fullPath = fullPath;
+	r.file = file;
+}
+
+void VFS::InvalidateResolved(const MyStringAnsi &path) const
+{
+	std::lock_guard<std::mutex> lock(this->resolvedLock);
+	this->resolved.erase(path);
 }
 
 
 VFS_FILE * VFS::OpenFile(const MyStringAnsi &path, VFS_FILE * temporary) const
 {
+	VFS_RESOLVED r = this->Resolve(path);
+	this->stats.RecordOpen(this->GetStatsSource(r));
+
 	VFS_FILE * f = nullptr;
-	if (FILE * ff = this->GetRawFile(path))
+	if (FILE * ff = (r.source == VFS_RESOLVED::RAW) ? this->GetRawFile(path) : nullptr)
 	{
 		//open file directly from OS file system
 
-		temporary->archiveFileIndex = std::numeric_limits<uint16_t>::max();
+		temporary->archiveFileIndex = VFS_NOT_ARCHIVED;
 		temporary->archiveType = VFS_ARCHIVE_TYPE::NONE;
+		temporary->compression = VFS_COMPRESSION::STORED;
 		temporary->filePtr = ff;
 
 		fseek(ff, 0L, SEEK_END);
 		temporary->fileSize = static_cast<size_t>(ftell(ff));
 		fseek(ff, 0L, SEEK_SET);
+
+		temporary->archiveOffset = 0;
+		temporary->dataOffset = 0;
+		temporary->storedSize = temporary->fileSize;
 		
 		//can directly return		
 		return temporary;
@@ -615,9 +754,8 @@ VFS_FILE * VFS::OpenFile(const MyStringAnsi &path, VFS_FILE * temporary) const
 	else
 	{
 		//failed to open directly from OS file system
-		//find file in VFS tree
-		//this is probably file in archive
-		f = this->fileSystem->GetFile(path);
+		//file is in archive
+		f = r.file;
 	}
 
 	if (f == nullptr)
@@ -627,7 +765,7 @@ VFS_FILE * VFS::OpenFile(const MyStringAnsi &path, VFS_FILE * temporary) const
 	}
 
 
-	if (f->archiveFileIndex == std::numeric_limits<uint16_t>::max())
+	if (f->archiveFileIndex == VFS_NOT_ARCHIVED)
 	{
 		printf("Problem - should not happed. This file should already be opened by OS file system");
 		/*
@@ -644,9 +782,25 @@ VFS_FILE * VFS::OpenFile(const MyStringAnsi &path, VFS_FILE * temporary) const
 	}
 	else 
 	{
-		//file is zipped archive
+		//file is in archive
+
+		if (f->compression == VFS_COMPRESSION::STORED)
+		{
+			//uncompressed data (PACKED_FS or STORED zip entry)
+			//are read directly from archive without minizip
+			FILE * tmpFile = nullptr;
+			my_fopen(&tmpFile, this->archiveFiles[f->archiveFileIndex].c_str(), "rb");
 
-		if (f->archiveType == VFS_ARCHIVE_TYPE::ZIP)
+			if (tmpFile == nullptr)
+			{
+				return nullptr;
+			}
+
+			my_fseek(tmpFile, f->dataOffset, SEEK_SET);
+
+			f->filePtr = tmpFile;
+		}
+		else if (f->archiveType == VFS_ARCHIVE_TYPE::ZIP)
 		{
 			f->filePtr = unzOpen(this->archiveFiles[f->archiveFileIndex].c_str());
 
@@ -660,17 +814,11 @@ VFS_FILE * VFS::OpenFile(const MyStringAnsi &path, VFS_FILE * temporary) const
 		}
 		else if (f->archiveType == VFS_ARCHIVE_TYPE::PACKED_FS)
 		{
-			FILE * tmpFile = nullptr;
-			my_fopen(&tmpFile, this->archiveFiles[f->archiveFileIndex].c_str(), "rb");
-
-			if (tmpFile == nullptr)
+			f->filePtr = PackedFSStream::Open(this->archiveFiles[f->archiveFileIndex], f);
+			if (f->filePtr == nullptr)
 			{
 				return nullptr;
 			}
-
-			fseek(tmpFile, f->archiveOffset, SEEK_SET);
-
-			f->filePtr = tmpFile;
 		}
 	}
 
@@ -684,21 +832,18 @@ void VFS::CloseFile(VFS_FILE * file) const
 		return;
 	}
 
-	if (file->archiveFileIndex == std::numeric_limits<uint16_t>::max())
+	if (file->compression == VFS_COMPRESSION::STORED)
 	{
 		fclose(static_cast<FILE *>(file->filePtr));
 	}
-	else 
+	else if (file->archiveType == VFS_ARCHIVE_TYPE::ZIP)
 	{
-		if (file->archiveType == VFS_ARCHIVE_TYPE::ZIP)
-		{
-			unzCloseCurrentFile(file->filePtr);
-			unzClose(file->filePtr);
-		}
-		else if (file->archiveType == VFS_ARCHIVE_TYPE::PACKED_FS)
-		{
-			fclose(static_cast<FILE *>(file->filePtr));
-		}
+		unzCloseCurrentFile(file->filePtr);
+		unzClose(file->filePtr);
+	}
+	else if (file->archiveType == VFS_ARCHIVE_TYPE::PACKED_FS)
+	{
+		PackedFSStream::Close(static_cast<PackedFSStream *>(file->filePtr));
 	}
 
 	file->filePtr = nullptr;
@@ -719,6 +864,8 @@ If file open failed, returns NULL
 -------------------------------------------------------------*/
 char * VFS::GetFileContent(const MyStringAnsi &path, size_t * fileSize) const
 {
+	VFSStatsRecord rec(this->stats, "GetFileContent", path);
+
 	VFS_FILE tmp;
 	VFS_FILE * f = this->OpenFile(path, &tmp);
 
@@ -728,9 +875,25 @@ char * VFS::GetFileContent(const MyStringAnsi &path, size_t * fileSize) const
 	}
 	
 	char * buf = new char[f->fileSize];
-	this->Read(buf, sizeof(char), f->fileSize, f);
+	if (f->compression != VFS_COMPRESSION::STORED)
+	{
+		//streamed decompression can not be separated from reading
+		rec.BeginDecompress();
+		this->Read(buf, sizeof(char), f->fileSize, f);
+		rec.EndDecompress();
+	}
+	else
+	{
+		this->Read(buf, sizeof(char), f->fileSize, f);
+	}
 	*fileSize = f->fileSize;
 
+	if (rec.IsActive())
+	{
+		rec.SetSource(this->GetStatsSource(this->Resolve(path)));
+		rec.SetBytes(f->storedSize, f->fileSize);
+	}
+
 	this->CloseFile(f);
 
 	return buf;
@@ -739,100 +902,717 @@ char * VFS::GetFileContent(const MyStringAnsi &path, size_t * fileSize) const
 
 
 /*-----------------------------------------------------------
-Function:	GetFileString
+Function:	GetFileView
 Parametrs:
 	[in] path - file path within VFS
 Returns:
-	loaded string
+	read-only view of file data
 
-Open file and return openeded data as string
-If file open failed, returns ""
+Return view directly into memory mapped archive without copying.
+Only uncompressed files from archives (PACKED_FS or STORED zip entries)
+can be viewed, for other files, view.data is NULL
+and GetFileContent must be used.
+Archive is mapped once and kept mapped while any view owner is alive
 -------------------------------------------------------------*/
-MyStringAnsi VFS::GetFileString(const MyStringAnsi &path) const
+VFS_VIEW VFS::GetFileView(const MyStringAnsi &path) const
 {
-	VFS_FILE tmp;
-	VFS_FILE * f = this->OpenFile(path, &tmp);
+	VFS_VIEW view;
+	view.data = nullptr;
+	view.size = 0;
 
-	if (f == nullptr)
+	VFS_RESOLVED r = this->Resolve(path);
+	if (r.source != VFS_RESOLVED::ARCHIVE)
 	{
-		return "";
+		//raw files are read by GetFileContent / ReadFileData
+		return view;
 	}
 
-
-	char * buf = new char[f->fileSize + 1];
-	int ret = this->Read(buf, sizeof(char), f->fileSize, f);
-	buf[f->fileSize] = 0;
-	MyStringAnsi str = MyStringAnsi::CreateFromMoveMemory(buf, f->fileSize + 1, f->fileSize);
-
-	//MyStringAnsi str(buf);	
-	//delete[] buf;
-
-	this->CloseFile(f);
-
-	return str;
-}
-
-int VFS::Read(void * buffer, size_t elementSize, size_t bytesCount, VFS_FILE * file) const
-{
-	if ((file == nullptr) && (file->filePtr == nullptr))
+	VFS_FILE * f = r.file;
+	if ((f == nullptr) ||
+		(f->archiveType == VFS_ARCHIVE_TYPE::NONE) ||
+		(f->compression != VFS_COMPRESSION::STORED))
 	{
-		return -1;
+		return view;
 	}
 
-	if (file->archiveType != VFS_ARCHIVE_TYPE::ZIP)
+	std::shared_ptr<MappedFile> mf = this->GetArchiveMapping(f->archiveFileIndex);
+	if ((mf == nullptr) || (f->dataOffset + f->fileSize > mf->GetSize()))
 	{
-		return static_cast<int>(fread(buffer, elementSize, bytesCount, static_cast<FILE *>(file->filePtr)));
+		return view;
 	}
-	return unzReadCurrentFile(file->filePtr, buffer, static_cast<unsigned>(elementSize * bytesCount));
-}
 
-int VFS::ReadString(char * buffer, size_t bytesCount, VFS_FILE * file) const
-{
-	if ((file == nullptr) && (file->filePtr == nullptr))
-	{
-		return -1;
-	}
+	view.data = reinterpret_cast<const char *>(mf->GetData() + f->dataOffset);
+	view.size = f->fileSize;
+	view.owner = mf;
 
-	int read = 0;
-	if (file->archiveType != VFS_ARCHIVE_TYPE::ZIP)
+	if (VFS_SOURCE_STATS * s = this->GetStatsSource(r))
 	{
-		read = static_cast<int>(fread(buffer, sizeof(char), bytesCount, static_cast<FILE *>(file->filePtr)));
-	}
-	else 
-	{ 
-		read = unzReadCurrentFile(file->filePtr, buffer, static_cast<unsigned>(bytesCount));
+		//mapped data are not read now, view is counted as read without latency
+		this->stats.RecordOpen(s);
+		this->stats.RecordRead(s, "GetFileView", path, 0, view.size, view.size, 0, 0);
 	}
 
-	buffer[bytesCount] = 0;
-	return read;
+	return view;
 }
 
 /*-----------------------------------------------------------
-Function:	ReadEntireFile
+Function:	GetFileSize
 Parametrs:
-	[out] buffer - loaded file
-	[in] file - file to be read
+	[in] path - file path within VFS
 Returns:
-	number of read bytes
+	raw size of file in bytes, 0 if file not found
 
-Read entire file and fill it to buffer
-Buffer must be dealocated with free(buffer) !!!
+Files from OS file system have priority over archived files
+(same as in OpenFile)
 -------------------------------------------------------------*/
-int VFS::ReadEntireFile(void ** buffer, VFS_FILE * file) const
+size_t VFS::GetFileSize(const MyStringAnsi &path) const
 {
-	*buffer = malloc(file->fileSize);
+	VFS_RESOLVED r = this->Resolve(path);
 
-	if (file->archiveType != VFS_ARCHIVE_TYPE::ZIP)
+	if (FILE * ff = (r.source == VFS_RESOLVED::RAW) ? this->GetRawFile(path) : nullptr)
 	{
-		return static_cast<int>(fread(*buffer, 1, file->fileSize, static_cast<FILE *>(file->filePtr)));
+		fseek(ff, 0L, SEEK_END);
+		size_t fileSize = static_cast<size_t>(ftell(ff));
+		fclose(ff);
+
+		return fileSize;
 	}
 
-	return unzReadCurrentFile(file->filePtr, *buffer, static_cast<unsigned>(file->fileSize));
+	VFS_FILE * f = r.file;
+	if (f == nullptr)
+	{
+		return 0;
+	}
+
+	return f->fileSize;
+}
+
+/*-----------------------------------------------------------
+Function:	ReadFileData
+Parametrs:
+	[in] path - file path within VFS
+	[out] buffer - pre-allocated output buffer
+	[in] bufferSize - size of buffer in bytes (at least file size)
+Returns:
+	true if entire file was read
+
+Read entire file into caller owned buffer.
+DEFLATE compressed files from archives are inflated with single
+call directly from mapped archive into buffer (no temporary buffers).
+VFS tree is not modified, so method can be called from multiple
+threads at once. Returns false for unsupported compression methods
+(eg. encrypted zip entries) - use GetFileContent for them
+-------------------------------------------------------------*/
+bool VFS::ReadFileData(const MyStringAnsi &path, void * buffer, size_t bufferSize) const
+{
+	VFSStatsRecord rec(this->stats, "ReadFileData", path);
+
+	VFS_RESOLVED r = this->Resolve(path);
+	rec.SetSource(this->GetStatsSource(r));
+	this->stats.RecordOpen(this->GetStatsSource(r));
+
+	if (FILE * ff = (r.source == VFS_RESOLVED::RAW) ? this->GetRawFile(path) : nullptr)
+	{
+		//file from OS file system
+		fseek(ff, 0L, SEEK_END);
+		size_t fileSize = static_cast<size_t>(ftell(ff));
+		fseek(ff, 0L, SEEK_SET);
+
+		bool res = (fileSize <= bufferSize) && (fread(buffer, sizeof(char), fileSize, ff) == fileSize);
+		fclose(ff);
+
+		rec.SetBytes(fileSize, fileSize);
+		return res;
+	}
+
+	VFS_FILE * f = r.file;
+	if ((f == nullptr) || (f->archiveType == VFS_ARCHIVE_TYPE::NONE) || (f->fileSize > bufferSize))
+	{
+		return false;
+	}
+
+	if (f->compression == VFS_COMPRESSION::STORED)
+	{
+		FILE * tmpFile = nullptr;
+		my_fopen(&tmpFile, this->archiveFiles[f->archiveFileIndex].c_str(), "rb");
+		if (tmpFile == nullptr)
+		{
+			return false;
+		}
+
+		my_fseek(tmpFile, f->dataOffset, SEEK_SET);
+		bool res = (fread(buffer, sizeof(char), f->fileSize, tmpFile) == f->fileSize);
+		fclose(tmpFile);
+
+		rec.SetBytes(f->fileSize, f->fileSize);
+		return res;
+	}
+
+	if (f->compression == VFS_COMPRESSION::DEFLATE_FRAMES)
+	{
+		return this->ReadFramesAt(f, 0, f->fileSize, buffer, rec) == f->fileSize;
+	}
+
+	if ((f->compression != VFS_COMPRESSION::DEFLATE) ||
+		(f->storedSize > std::numeric_limits<uInt>::max()) ||
+		(f->fileSize > std::numeric_limits<uInt>::max()))
+	{
+		return false;
+	}
+
+	//compressed input - from mapped archive if possible
+	std::shared_ptr<MappedFile> mf = this->GetArchiveMapping(f->archiveFileIndex);
+
+	std::vector<uint8_t> compressed;
+	const uint8_t * input = nullptr;
+
+	if ((mf != nullptr) && (f->dataOffset + f->storedSize <= mf->GetSize()))
+	{
+		input = mf->GetData() + f->dataOffset;
+	}
+	else
+	{
+		FILE * tmpFile = nullptr;
+		my_fopen(&tmpFile, this->archiveFiles[f->archiveFileIndex].c_str(), "rb");
+		if (tmpFile == nullptr)
+		{
+			return false;
+		}
+
+		compressed.resize(static_cast<size_t>(f->storedSize));
+		my_fseek(tmpFile, f->dataOffset, SEEK_SET);
+		size_t readSize = fread(compressed.data(), sizeof(uint8_t), compressed.size(), tmpFile);
+		fclose(tmpFile);
+
+		if (readSize != compressed.size())
+		{
+			return false;
+		}
+		input = compressed.data();
+	}
+
+	//zip and PACKED_FS both store raw deflate stream without header
+	z_stream z;
+	memset(&z, 0, sizeof(z_stream));
+	if (inflateInit2(&z, -MAX_WBITS) != Z_OK)
+	{
+		return false;
+	}
+
+	z.next_in = const_cast<Bytef *>(input);
+	z.avail_in = static_cast<uInt>(f->storedSize);
+	z.next_out = static_cast<Bytef *>(buffer);
+	z.avail_out = static_cast<uInt>(f->fileSize);
+
+	rec.BeginDecompress();
+	int res = inflate(&z, Z_FINISH);
+	rec.EndDecompress();
+	inflateEnd(&z);
+
+	rec.SetBytes(f->storedSize, z.total_out);
+
+	if ((res != Z_STREAM_END) || (z.total_out != f->fileSize))
+	{
+		printf("[VFS Error] Failed to inflate %s (%i)\n", path.c_str(), res);
+		return false;
+	}
+
+	return true;
+}
+
+/*-----------------------------------------------------------
+Function:	IsFileRandomAccess
+Parametrs:
+	[in] path - file path within VFS
+Returns:
+	true if small parts of file can be cheaply read by ReadAt
+
+DEFLATE_FRAMES archived files (single frame is decompressed)
+and STORED files from mapped archives (data are copied from mapping).
+OS files and unmapped archives are seekable as well, but each ReadAt
+opens the file, so it is cheaper to read them at once
+-------------------------------------------------------------*/
+bool VFS::IsFileRandomAccess(const MyStringAnsi &path) const
+{
+	VFS_RESOLVED r = this->Resolve(path);
+	if (r.source != VFS_RESOLVED::ARCHIVE)
+	{
+		return false;
+	}
+
+	VFS_FILE * f = r.file;
+
+	if (f->compression == VFS_COMPRESSION::DEFLATE_FRAMES)
+	{
+		return true;
+	}
+
+	if (f->compression != VFS_COMPRESSION::STORED)
+	{
+		return false;
+	}
+
+	std::shared_ptr<MappedFile> mf = this->GetArchiveMapping(f->archiveFileIndex);
+	return (mf != nullptr) && (f->dataOffset + f->fileSize <= mf->GetSize());
+}
+
+/*-----------------------------------------------------------
+Function:	ReadAt
+Parametrs:
+	[in] path - file path within VFS
+	[in] offset - offset within uncompressed file
+	[in] bytesCount - number of bytes to read
+	[out] buffer - output buffer
+Returns:
+	number of bytes read
+
+Read part of file. For DEFLATE_FRAMES files, only frames
+covering requested range are decompressed.
+For DEFLATE files, file must be decompressed from its beginning,
+so use ReadFileData if more parts of file are needed.
+VFS tree is not modified, method is thread-safe
+-------------------------------------------------------------*/
+size_t VFS::ReadAt(const MyStringAnsi &path, uint64_t offset, size_t bytesCount, void * buffer) const
+{
+	VFSStatsRecord rec(this->stats, "ReadAt", path, offset);
+
+	VFS_RESOLVED r = this->Resolve(path);
+	VFS_FILE * f = r.file;
+
+	if (r.source != VFS_RESOLVED::ARCHIVE)
+	{
+		FILE * ff = this->GetRawFile(path);
+		if (ff == nullptr)
+		{
+			return 0;
+		}
+
+		my_fseek(ff, offset, SEEK_SET);
+		size_t read = fread(buffer, sizeof(char), bytesCount, ff);
+		fclose(ff);
+
+		rec.SetSource(this->GetStatsSource(r));
+		return rec.Finish(read, read);
+	}
+
+	if (offset >= f->fileSize)
+	{
+		return 0;
+	}
+	bytesCount = static_cast<size_t>(std::min<uint64_t>(bytesCount, f->fileSize - offset));
+
+	if (f->compression == VFS_COMPRESSION::STORED)
+	{
+		std::shared_ptr<MappedFile> mf = this->GetArchiveMapping(f->archiveFileIndex);
+		rec.SetSource(this->GetStatsSource(r));
+
+		if ((mf != nullptr) && (f->dataOffset + f->fileSize <= mf->GetSize()))
+		{
+			memcpy(buffer, mf->GetData() + f->dataOffset + offset, bytesCount);
+			return rec.Finish(bytesCount, bytesCount);
+		}
+
+		FILE * tmpFile = nullptr;
+		my_fopen(&tmpFile, this->archiveFiles[f->archiveFileIndex].c_str(), "rb");
+		if (tmpFile == nullptr)
+		{
+			return 0;
+		}
+
+		my_fseek(tmpFile, f->dataOffset + offset, SEEK_SET);
+		size_t read = fread(buffer, sizeof(char), bytesCount, tmpFile);
+		fclose(tmpFile);
+
+		return rec.Finish(read, read);
+	}
+
+	if (f->compression == VFS_COMPRESSION::DEFLATE_FRAMES)
+	{
+		rec.SetSource(this->GetStatsSource(r));
+		return this->ReadFramesAt(f, offset, bytesCount, buffer, rec);
+	}
+
+	//not seekable - decompress entire file
+	//(recorded by ReadFileData)
+	std::vector<char> tmp(f->fileSize);
+	if (this->ReadFileData(path, tmp.data(), tmp.size()) == false)
+	{
+		return 0;
+	}
+
+	memcpy(buffer, tmp.data() + offset, bytesCount);
+	return bytesCount;
+}
+
+/*-----------------------------------------------------------
+Function:	GetFileLocation
+Parametrs:
+	[in] path - file path within VFS
+	[out] location - physical location of file data
+Returns:
+	true if file was found
+
+location.uncompressed is true if data are stored in single
+uncompressed block and can be read directly by OS
+(OS files or STORED archive files)
+-------------------------------------------------------------*/
+bool VFS::GetFileLocation(const MyStringAnsi &path, VFS_LOCATION & location) const
+{
+	VFS_RESOLVED r = this->Resolve(path);
+	if (r.source == VFS_RESOLVED::RAW)
+	{
+		location.osPath = r.fullPath;
+		location.dataOffset = 0;
+		location.dataSize = std::numeric_limits<uint64_t>::max();
+		location.uncompressed = true;
+	}
+	else if (r.source == VFS_RESOLVED::ARCHIVE)
+	{
+		location.osPath = this->archiveFiles[r.file->archiveFileIndex];
+		location.dataOffset = r.file->dataOffset;
+		location.dataSize = (r.file->compression == VFS_COMPRESSION::STORED) ? r.file->fileSize : r.file->storedSize;
+		location.uncompressed = (r.file->compression == VFS_COMPRESSION::STORED);
+	}
+	else
+	{
+		return false;
+	}
+
+	location.device = this->GetDeviceId(location.osPath);
+
+	return true;
+}
+
+/*-----------------------------------------------------------
+Function:	GetDeviceId
+Parametrs:
+	[in] osPath - OS path of file
+Returns:
+	id of physical device (drive) with file
+
+Device is detected once for each directory
+(st_dev on POSIX, drive letter on Windows)
+-------------------------------------------------------------*/
+uint64_t VFS::GetDeviceId(const MyStringAnsi &osPath) const
+{
+#ifdef _WIN32
+	if ((osPath.length() > 1) && (osPath[1] == ':'))
+	{
+		return static_cast<uint64_t>(toupper(osPath[0]));
+	}
+	return 0;
+#else
+	int i = osPath.length() - 1;
+	while ((i > 0) && (osPath[i] != '/'))
+	{
+		i--;
+	}
+	MyStringAnsi dir = ".";
+	if (i > 0)
+	{
+		dir = osPath.SubString(0, i);
+	}
+	else if ((osPath.length() > 0) && (osPath[0] == '/'))
+	{
+		dir = "/";
+	}
+
+	std::lock_guard<std::mutex> lock(this->dirDevicesLock);
+
+	auto it = this->dirDevices.find(dir);
+	if (it != this->dirDevices.end())
+	{
+		return it->second;
+	}
+
+	struct stat sb;
+	uint64_t device = (stat(dir.c_str(), &sb) == 0) ? static_cast<uint64_t>(sb.st_dev) : 0;
+	this->dirDevices[dir] = device;
+
+	return device;
+#endif
+}
+
+/*-----------------------------------------------------------
+Function:	ReadFramesAt
+Parametrs:
+	[in] f - DEFLATE_FRAMES file from archive
+	[in] offset - offset within uncompressed file
+	[in] bytesCount - number of bytes to read
+	[out] buffer - output buffer
+	[in] rec - statistics of request
+Returns:
+	number of bytes read
+
+Frames are decompressed directly from mapped archive.
+If archive can not be mapped, entry data are read to memory
+-------------------------------------------------------------*/
+size_t VFS::ReadFramesAt(const VFS_FILE * f, uint64_t offset, size_t bytesCount, void * buffer, VFSStatsRecord & rec) const
+{
+	std::shared_ptr<MappedFile> mf = this->GetArchiveMapping(f->archiveFileIndex);
+
+	std::vector<uint8_t> stored;
+	const uint8_t * data = nullptr;
+
+	if ((mf != nullptr) && (f->dataOffset + f->storedSize <= mf->GetSize()))
+	{
+		data = mf->GetData() + f->dataOffset;
+	}
+	else
+	{
+		FILE * tmpFile = nullptr;
+		my_fopen(&tmpFile, this->archiveFiles[f->archiveFileIndex].c_str(), "rb");
+		if (tmpFile == nullptr)
+		{
+			return 0;
+		}
+
+		stored.resize(static_cast<size_t>(f->storedSize));
+		my_fseek(tmpFile, f->dataOffset, SEEK_SET);
+		size_t readSize = fread(stored.data(), sizeof(uint8_t), stored.size(), tmpFile);
+		fclose(tmpFile);
+
+		if (readSize != stored.size())
+		{
+			return 0;
+		}
+		data = stored.data();
+	}
+
+	PackedFSFrames frames(data, f->storedSize, f->fileSize);
+	if (frames.IsValid() == false)
+	{
+		printf("[VFS Error] Invalid frame index\n");
+		return 0;
+	}
+
+	rec.BeginDecompress();
+	size_t read = frames.Read(offset, buffer, bytesCount);
+	rec.EndDecompress();
+
+	return rec.Finish(frames.GetStoredSize(offset, read), read);
+}
+
+/*-----------------------------------------------------------
+Function:	GetStats
+Returns:
+	VFS I/O statistics
+
+Statistics are disabled by default, enable them with
+GetStats().SetEnabled(true)
+-------------------------------------------------------------*/
+VFSStats & VFS::GetStats() const
+{
+	return this->stats;
+}
+
+/*-----------------------------------------------------------
+Function:	GetStatsSource
+Parametrs:
+	[in] path - file path within VFS
+Returns:
+	counters of archive or root directory with file
+	or nullptr if statistics are disabled
+-------------------------------------------------------------*/
+VFS_SOURCE_STATS * VFS::GetStatsSource(const MyStringAnsi &path) const
+{
+	if (this->stats.IsEnabled() == false)
+	{
+		return nullptr;
+	}
+
+	return this->GetStatsSource(this->Resolve(path));
+}
+
+/*-----------------------------------------------------------
+Function:	GetStatsSource
+Parametrs:
+	[in] r - resolved file
+Returns:
+	counters of source or nullptr if statistics are disabled
+
+Files from archives are counted per archive, OS files
+per init directory (or per OS directory for full paths)
+-------------------------------------------------------------*/
+VFS_SOURCE_STATS * VFS::GetStatsSource(const VFS_RESOLVED & r) const
+{
+	if ((this->stats.IsEnabled() == false) || (r.source == VFS_RESOLVED::MISSING))
+	{
+		return nullptr;
+	}
+
+	if (r.source == VFS_RESOLVED::ARCHIVE)
+	{
+		return this->stats.GetSource(this->archiveFiles[r.file->archiveFileIndex]);
+	}
+
+	for (const MyStringAnsi & d : this->initDirs)
+	{
+		if ((r.fullPath.length() > d.length()) &&
+			(strncmp(r.fullPath.c_str(), d.c_str(), d.length()) == 0))
+		{
+			return this->stats.GetSource(d);
+		}
+	}
+
+	int i = static_cast<int>(r.fullPath.length()) - 1;
+	while ((i > 0) && (r.fullPath[i] != '/') && (r.fullPath[i] != '\\'))
+	{
+		i--;
+	}
+
+	return this->stats.GetSource((i > 0) ? r.fullPath.SubString(0, i) : MyStringAnsi("."));
+}
+
+/*-----------------------------------------------------------
+Function:	GetArchiveMapping
+Parametrs:
+	[in] archiveFileIndex - index of archive
+Returns:
+	mapped archive or nullptr
+
+Get memory mapping of archive. Archive is mapped
+during the first call. If mapping fails, it is not
+tried again and callers read archive by stdio
+-------------------------------------------------------------*/
+std::shared_ptr<MappedFile> VFS::GetArchiveMapping(uint32_t archiveFileIndex) const
+{
+	std::lock_guard<std::mutex> lock(this->archiveMappingsLock);
+
+	if (this->archiveMappings.size() < this->archiveFiles.size())
+	{
+		this->archiveMappings.resize(this->archiveFiles.size());
+		this->archiveMappingsFailed.resize(this->archiveFiles.size(), false);
+	}
+
+	std::shared_ptr<MappedFile> & mf = this->archiveMappings[archiveFileIndex];
+	if ((mf == nullptr) && (this->archiveMappingsFailed[archiveFileIndex] == false))
+	{
+		mf = MappedFile::Open(this->archiveFiles[archiveFileIndex]);
+		this->archiveMappingsFailed[archiveFileIndex] = (mf == nullptr);
+	}
+
+	return mf;
+}
+
+/*-----------------------------------------------------------
+Function:	GetFileString
+Parametrs:
+	[in] path - file path within VFS
+Returns:
+	loaded string
+
+Open file and return openeded data as string
+If file open failed, returns ""
+-------------------------------------------------------------*/
+MyStringAnsi VFS::GetFileString(const MyStringAnsi &path) const
+{
+	VFSStatsRecord rec(this->stats, "GetFileString", path);
+
+	VFS_FILE tmp;
+	VFS_FILE * f = this->OpenFile(path, &tmp);
+
+	if (f == nullptr)
+	{
+		return "";
+	}
+
+
+	char * buf = new char[f->fileSize + 1];
+	int ret = this->Read(buf, sizeof(char), f->fileSize, f);
+	if (rec.IsActive())
+	{
+		rec.SetSource(this->GetStatsSource(this->Resolve(path)));
+		rec.SetBytes(f->storedSize, f->fileSize);
+	}
+	buf[f->fileSize] = 0;
+	MyStringAnsi str = MyStringAnsi::CreateFromMoveMemory(buf, f->fileSize + 1, f->fileSize);
+
+	//MyStringAnsi str(buf);	
+	//delete[] buf;
+
+	this->CloseFile(f);
+
+	return str;
+}
+
+int VFS::Read(void * buffer, size_t elementSize, size_t bytesCount, VFS_FILE * file) const
+{
+	if ((file == nullptr) && (file->filePtr == nullptr))
+	{
+		return -1;
+	}
+
+	if (file->compression == VFS_COMPRESSION::STORED)
+	{
+		return static_cast<int>(fread(buffer, elementSize, bytesCount, static_cast<FILE *>(file->filePtr)));
+	}
+	if (file->archiveType == VFS_ARCHIVE_TYPE::PACKED_FS)
+	{
+		PackedFSStream * s = static_cast<PackedFSStream *>(file->filePtr);
+		return static_cast<int>(s->Read(buffer, elementSize * bytesCount) / elementSize);
+	}
+	return unzReadCurrentFile(file->filePtr, buffer, static_cast<unsigned>(elementSize * bytesCount));
+}
+
+int VFS::ReadString(char * buffer, size_t bytesCount, VFS_FILE * file) const
+{
+	if ((file == nullptr) && (file->filePtr == nullptr))
+	{
+		return -1;
+	}
+
+	int read = 0;
+	if (file->compression == VFS_COMPRESSION::STORED)
+	{
+		read = static_cast<int>(fread(buffer, sizeof(char), bytesCount, static_cast<FILE *>(file->filePtr)));
+	}
+	else if (file->archiveType == VFS_ARCHIVE_TYPE::PACKED_FS)
+	{
+		read = static_cast<int>(static_cast<PackedFSStream *>(file->filePtr)->Read(buffer, bytesCount));
+	}
+	else 
+	{ 
+		read = unzReadCurrentFile(file->filePtr, buffer, static_cast<unsigned>(bytesCount));
+	}
+
+	buffer[bytesCount] = 0;
+	return read;
+}
+
+/*-----------------------------------------------------------
+Function:	ReadEntireFile
+Parametrs:
+	[out] buffer - loaded file
+	[in] file - file to be read
+Returns:
+	number of read bytes
+
+Read entire file and fill it to buffer
+Buffer must be dealocated with free(buffer) !!!
+-------------------------------------------------------------*/
+int VFS::ReadEntireFile(void ** buffer, VFS_FILE * file) const
+{
+	*buffer = malloc(file->fileSize);
+
+	if (file->compression == VFS_COMPRESSION::STORED)
+	{
+		return static_cast<int>(fread(*buffer, 1, file->fileSize, static_cast<FILE *>(file->filePtr)));
+	}
+	if (file->archiveType == VFS_ARCHIVE_TYPE::PACKED_FS)
+	{
+		return static_cast<int>(static_cast<PackedFSStream *>(file->filePtr)->Read(*buffer, file->fileSize));
+	}
+
+	return unzReadCurrentFile(file->filePtr, *buffer, static_cast<unsigned>(file->fileSize));
 }
 
 
 void VFS::RefreshFile(const MyStringAnsi &path)
 {
+	//file could be moved to / from OS file system
+	this->InvalidateResolved(path);
+
 	VFS_FILE tmp;
 	if (VFS_FILE * f = this->OpenFile(path, &tmp))
 	{
@@ -843,7 +1623,7 @@ void VFS::RefreshFile(const MyStringAnsi &path)
 			return;
 		}
 
-		if (f->archiveFileIndex == std::numeric_limits<uint16_t>::max())
+		if (f->archiveFileIndex == VFS_NOT_ARCHIVED)
 		{
 			VFS_ARCHIVE_TYPE arch;
 			size_t fs = 0;
@@ -874,6 +1654,13 @@ void VFS::AddDirectory(const MyStringAnsi &dirName)
         this->AddDirectory(dirName, startDirName);
         failed = false;
     }
+
+	if (this->hasRawDirs)
+	{
+		//new files can hide previously missing ones
+		std::lock_guard<std::mutex> lock(this->resolvedLock);
+		this->resolved.clear();
+	}
 #ifdef __ANDROID_API__
 
     if (AAssetDir* dir = AAssetManager_openDir(AndroidUtils::android_asset_manager, dirName.c_str()))
@@ -908,6 +1695,14 @@ void VFS::AddHighPriorityRawDirectory(const MyStringAnsi &dirName)
 
 void VFS::AddRawDirectory(const MyStringAnsi &dirName, int priority)
 {
+	//files from raw directory are not known in advance
+	//and they can hide already resolved files
+	this->hasRawDirs = true;
+	{
+		std::lock_guard<std::mutex> lock(this->resolvedLock);
+		this->resolved.clear();
+	}
+
 	if (DIR * dir = opendir(dirName.c_str()))
     {
         MyStringAnsi startDirName = dirName;
@@ -977,6 +1772,31 @@ void VFS::AddRawDirectory(const MyStringAnsi &dirName, int priority)
 }
 
 
+/*-----------------------------------------------------------
+Function:	CreateVFSPath
+Parametrs:
+	[in] fullPath - OS path of file
+	[in] startDirName - root directory of file
+Returns:
+	VFS path of file
+
+VFS path always starts with single '/' (same as paths
+from GetFilePath), so it does not depend on trailing
+separators of root directory
+-------------------------------------------------------------*/
+MyStringAnsi VFS::CreateVFSPath(const MyStringAnsi & fullPath, const MyStringAnsi & startDirName)
+{
+	size_t start = startDirName.length();
+	while ((start < fullPath.length()) && ((fullPath[start] == '/') || (fullPath[start] == '\\')))
+	{
+		start++;
+	}
+
+	MyStringAnsi vfsPath = "/";
+	vfsPath += fullPath.SubString(start, fullPath.length() - start);
+	return vfsPath;
+}
+
 void VFS::AddDirectory(const MyStringAnsi &dirName, const MyStringAnsi &startDirName)
 {
 	
@@ -1022,9 +1842,7 @@ void VFS::AddDirectory(const MyStringAnsi &dirName, const MyStringAnsi &startDir
 
 			fullPath.Replace("\\", "/");
 
-			vfsPath = fullPath;
-			vfsPath = vfsPath.SubString(startDirName.length(),
-				fullPath.length() - startDirName.length());
+			vfsPath = CreateVFSPath(fullPath, startDirName);
 
 
 			//printf("Full file path: %s\n", fullPath.c_str());
@@ -1079,8 +1897,7 @@ void VFS::AddDirectoryAndroid(const MyStringAnsi &dirName, const MyStringAnsi &s
 
         fullPath += filename;
 
-        MyStringAnsi vfsPath = fullPath;
-        vfsPath = vfsPath.SubString(startDirName.length(), fullPath.length() - startDirName.length());
+        MyStringAnsi vfsPath = CreateVFSPath(fullPath, startDirName);
 
 
 
@@ -1133,70 +1950,86 @@ bool VFS::FileInfo(const MyStringAnsi &fileName, VFS_ARCHIVE_TYPE &archiveType,
 	return true;
 }
 
-void VFS::ScanPackedFS(const MyStringAnsi & vfsPath, const MyStringAnsi &fullPath)
-{
-	this->archiveFiles.push_back(fullPath);
+/*-----------------------------------------------------------
+Function:	ScanPackedFS
+Parametrs:
+	[in] fullPath - OS path of archive
 
-	int i = vfsPath.length() - 1;
-	while ((i > 0) && (vfsPath[i] != '/') && (vfsPath[i] != '\\'))
+Add all files from PACKED_FS archive (v1 or v2) to the VFS tree.
+Packed files are stored with their full VFS paths
+-------------------------------------------------------------*/
+void VFS::ScanPackedFS(const MyStringAnsi &fullPath)
+{
+	PackedFSReader reader(fullPath);
+	if (reader.IsOpened() == false)
 	{
-		i--;
+		printf("[VFS Error] Failed to open packed file %s\n", fullPath.c_str());
+		return;
 	}
 
-	MyStringAnsi archiveVfsDir = vfsPath;
-	archiveVfsDir[i + 1] = 0; //cut-off file name
-
-	FILE * f = nullptr;
-	my_fopen(&f, fullPath.c_str(), "rb");
-	if (f == nullptr)
+	std::vector<PackedFSEntry> entries;
+	if (reader.ReadDirectory(entries) == false)
 	{
-		return;
+		printf("[VFS Error] Corrupted packed file %s\n", fullPath.c_str());
 	}
 
-	char header[2];
-	fread(header, sizeof(char), 2, f);
-	
-	uint32_t fileCount = 0;
-	fread(&fileCount, sizeof(uint32_t), 1, f);
+	this->archiveFiles.push_back(fullPath);
 
-	for (uint32_t fi = 0; fi < fileCount; fi++)
+	for (auto & e : entries)
 	{
-		uint32_t fileSize = 0;
-		uint32_t dataOffset = 0;
-		uint16_t nameLength = 0;
-
-		fread(&fileSize, sizeof(uint32_t), 1, f);
-		fread(&dataOffset, sizeof(uint32_t), 1, f);
-		fread(&nameLength, sizeof(uint16_t), 1, f);
+		MyStringAnsi & path = e.path;
 
-		char * n = new char[nameLength + 1];
-		fread(n, sizeof(char), nameLength, f);
-		n[nameLength] = 0;
-
-		MyStringAnsi path = MyStringAnsi::CreateFromMoveMemory(n, nameLength + 1, nameLength);
+		int i = path.length() - 1;
+		while ((i > 0) && (path[i] != '/') && (path[i] != '\\'))
+		{
+			i--;
+		}
 
-		VFS_FILE * vfsFile = new VFS_FILE;
-		vfsFile->fileSize = static_cast<size_t>(fileSize);
-		vfsFile->archiveOffset = dataOffset;
-		vfsFile->archiveFileIndex = static_cast<uint16_t>(this->archiveFiles.size() - 1);
+		VFS_FILE * vfsFile = this->fileSystem->NewFile(path.c_str() + i + 1);
+		vfsFile->fileSize = static_cast<size_t>(e.size);
+		vfsFile->archiveOffset = e.offset;
+		vfsFile->dataOffset = e.offset;
+		vfsFile->storedSize = e.storedSize;
+		vfsFile->compression = e.compression;
+		vfsFile->archiveFileIndex = static_cast<uint32_t>(this->archiveFiles.size() - 1);
 		vfsFile->filePtr = nullptr;
 		vfsFile->archiveType = VFS_ARCHIVE_TYPE::PACKED_FS;
-		//vfsFile->filePath = my_strdup(path.c_str()); //NEED RELEASE !
-
-		//arch->parent = file;
 
-
-		int i = path.length() - 1;
-		while ((i > 0) && (path[i] != '/') && (path[i] != '\\'))
+		if (this->fileSystem->AddFile(path, vfsFile))
 		{
-			i--;
+			this->AddResolved(path, VFS_RESOLVED::ARCHIVE, "", vfsFile);
 		}
-		vfsFile->name = my_strdup(path.c_str() + i + 1);
+	}
+}
+
+/*-----------------------------------------------------------
+Function:	GetZipDataOffset
+Parametrs:
+	[in] zipFile - opened zip with selected current file
+	[out] offset - absolute offset of current file data within archive
+Returns:
+	false if offset can not be obtained
 
-		this->fileSystem->AddFile(path, vfsFile);
+Local file header has variable length (name and extra field),
+so it is opened in raw mode (no decompression is initialized)
+to obtain position of data
+-------------------------------------------------------------*/
+bool VFS::GetZipDataOffset(void * zipFile, uint64_t & offset) const
+{
+	offset = 0;
+
+	int method = 0;
+	int level = 0;
+	if (unzOpenCurrentFile2(zipFile, &method, &level, 1) != UNZ_OK)
+	{
+		return false;
 	}
 
-	fclose(f);
+	offset = static_cast<uint64_t>(unzGetCurrentFileZStreamPos64(zipFile));
+
+	unzCloseCurrentFile(zipFile);
+
+	return offset != 0;
 }
 
 void VFS::ScanZipArchive(const MyStringAnsi & vfsPath, const MyStringAnsi &fullPath)
@@ -1231,26 +2064,35 @@ void VFS::ScanZipArchive(const MyStringAnsi & vfsPath, const MyStringAnsi &fullP
 
 			path += fileNameInArchive;
 			
+			int i = path.length() - 1;
+			while ((i > 0) && (path[i] != '/') && (path[i] != '\\'))
+			{
+				i--;
+			}
 			
-			VFS_FILE * vfsFile = new VFS_FILE;
+			VFS_FILE * vfsFile = this->fileSystem->NewFile(path.c_str() + i + 1);
 			vfsFile->fileSize = static_cast<size_t>(info.uncompressed_size);
 			vfsFile->archiveOffset = unzGetOffset(zipFile);
-			vfsFile->archiveFileIndex = static_cast<uint16_t>(this->archiveFiles.size() - 1);
+			vfsFile->storedSize = static_cast<uint64_t>(info.compressed_size);
+			vfsFile->compression = static_cast<uint8_t>(info.compression_method);
+
+			bool hasOffset = this->GetZipDataOffset(zipFile, vfsFile->dataOffset);
+			if ((hasOffset == false) || ((info.flag & 1) != 0))
+			{
+				//encrypted data or data at unknown position must go through minizip
+				vfsFile->compression = VFS_COMPRESSION::ZIP_MINIZIP;
+			}
+			vfsFile->archiveFileIndex = static_cast<uint32_t>(this->archiveFiles.size() - 1);
 			vfsFile->filePtr = nullptr;
 			vfsFile->archiveType = VFS_ARCHIVE_TYPE::ZIP;
 			//vfsFile->filePath = my_strdup(path.c_str()); //NEED RELEASE !
 			
 			//arch->parent = file;
 
-			
-			int i = path.length() - 1;
-			while ((i > 0) && (path[i] != '/') && (path[i] != '\\'))
+			if (this->fileSystem->AddFile(path, vfsFile))
 			{
-				i--;
+				this->AddResolved(path, VFS_RESOLVED::ARCHIVE, "", vfsFile);
 			}
-			vfsFile->name = my_strdup(path.c_str() + i + 1);
-
-			this->fileSystem->AddFile(path, vfsFile);
 		}
 			
 		res = unzGoToNextFile(zipFile);
@@ -1277,26 +2119,31 @@ void VFS::CreateVFSFile(MyStringAnsi & vfsPath, const MyStringAnsi & fullPath)
 
 	if (archiveType == VFS_ARCHIVE_TYPE::PACKED_FS)
 	{
-		this->ScanPackedFS(vfsPath, fullPath);
+		this->ScanPackedFS(fullPath);
 		return;
 	}
 	
-	VFS_FILE * vfsFile = new VFS_FILE;
-	vfsFile->fileSize = fileSize;
-	vfsFile->archiveFileIndex = std::numeric_limits<uint16_t>::max();
-	vfsFile->archiveOffset = std::numeric_limits<unsigned long>::max();
-	vfsFile->filePtr = nullptr;	
-	vfsFile->archiveType = VFS_ARCHIVE_TYPE::NONE;
-	//vfsFile->filePath = my_strdup(vfsPath.c_str()); //NEED RELEASE !
-
 	int i = vfsPath.length() - 1;
 	while ((i > 0) && (vfsPath[i] != '/') && (vfsPath[i] != '\\'))
 	{
 		i--;
 	} 
-	vfsFile->name = my_strdup(vfsPath.c_str() + i + 1);
+
+	VFS_FILE * vfsFile = this->fileSystem->NewFile(vfsPath.c_str() + i + 1);
+	vfsFile->fileSize = fileSize;
+	vfsFile->archiveFileIndex = VFS_NOT_ARCHIVED;
+	vfsFile->archiveOffset = std::numeric_limits<uint64_t>::max();
+	vfsFile->dataOffset = 0;
+	vfsFile->storedSize = fileSize;
+	vfsFile->compression = VFS_COMPRESSION::STORED;
+	vfsFile->filePtr = nullptr;	
+	vfsFile->archiveType = VFS_ARCHIVE_TYPE::NONE;
+	//vfsFile->filePath = my_strdup(vfsPath.c_str()); //NEED RELEASE !
 	
 	this->fileSystem->AddFile(vfsPath, vfsFile);
+
+	//raw file has priority even if the same path is already in archive
+	this->AddResolved(vfsPath, VFS_RESOLVED::RAW, fullPath, nullptr);
 	
 }
 
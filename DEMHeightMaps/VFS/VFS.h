@@ -16,6 +16,12 @@
 	#ifndef my_strdup
 		#define my_strdup(a) _strdup(a)
 	#endif
+	#ifndef my_fseek
+		#define my_fseek(a, b, c) _fseeki64(a, b, c)
+	#endif
+	#ifndef my_ftruncate
+		#define my_ftruncate(a, b) _chsize_s(_fileno(a), b)
+	#endif
 #else	
 	#ifndef my_fopen 
 		#define my_fopen(a, b, c) (*a = fopen(b, c))
@@ -23,10 +29,21 @@
 	#ifndef my_strdup
 		#define my_strdup(a) strdup(a)
 	#endif
+	#ifndef my_fseek
+		#define my_fseek(a, b, c) fseeko(a, b, c)
+	#endif
+	#ifndef my_ftruncate
+		#define my_ftruncate(a, b) ftruncate(fileno(a), b)
+	#endif
 #endif
 
 #include <vector>
+#include <deque>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
 #include "../Strings/MyString.h"
+#include "./VFSStats.h"
 
 /*====================================
 
@@ -42,6 +59,9 @@ Martin Perry
 =====================================*/
 
 struct VFS_DIR;
+class MappedFile;
+
+#define VFS_NOT_ARCHIVED 0xFFFFFFFF	//archiveFileIndex of files from OS file system
 
 typedef enum VFS_ARCHIVE_TYPE {
 	NONE = 0,
@@ -50,6 +70,16 @@ typedef enum VFS_ARCHIVE_TYPE {
 
 } VFS_ARCHIVE_TYPE;
 
+typedef enum VFS_COMPRESSION {
+	STORED = 0,
+	DEFLATE = 8,	//same values as zip compression methods
+	DEFLATE_FRAMES = 128,	//independent deflate frames with index (PACKED_FS only)
+							//allows random access without decompressing entire file
+	ZIP_MINIZIP = 255		//zip entry that can be read only through minizip
+							//(encrypted or position of data is unknown)
+
+} VFS_COMPRESSION;
+
 /*-----------------------------------------------------------
 Struct:	VFS_FILE
 
@@ -57,21 +87,69 @@ File within VFS
 -------------------------------------------------------------*/
 typedef struct VFS_FILE 
 {
-	const char * name;	//file name with extension (eg. Sample.txt)
-						//must be released with free()
-	
 	VFS_DIR * dir;		//pointer to parent directory
-		
-	uint16_t archiveFileIndex; //index to archive file path
-	uint8_t archiveType;
-	unsigned long archiveOffset; //ofset within archived file to the actual file
 
 	void * filePtr;			//pointer to the opened file in OS file system or inside archive
 
+	uint64_t archiveOffset; //ofset within archived file to the actual file
+	uint64_t dataOffset;		//absolute offset of file data within archive
+	uint64_t storedSize;		//size of data inside archive (differs from fileSize for compressed data)
+
 	size_t fileSize;			//raw size of file
 
+	uint32_t archiveFileIndex; //index to archive file path (VFS_NOT_ARCHIVED for OS files)
+	uint32_t nameOffset;		//offset of file name with extension (eg. Sample.txt)
+								//in VFSTree names arena - use GetFileName
+	uint8_t archiveType;
+	uint8_t compression;		//VFS_COMPRESSION of data inside archive
+
 } VFS_FILE;
 
+/*-----------------------------------------------------------
+Struct:	VFS_VIEW
+
+Read-only view into file data mapped in memory
+Data are valid as long as owner is alive
+-------------------------------------------------------------*/
+typedef struct VFS_VIEW
+{
+	const char * data;				//file data, nullptr if view is not available
+	size_t size;					//size of data
+
+	std::shared_ptr<void> owner;	//lifetime handle of underlying mapping
+
+} VFS_VIEW;
+
+/*-----------------------------------------------------------
+Struct:	VFS_RESOLVED
+
+Where the data of VFS path are located
+-------------------------------------------------------------*/
+typedef struct VFS_RESOLVED
+{
+	enum SOURCE { RAW = 0, ARCHIVE = 1, MISSING = 2 };
+
+	SOURCE source;
+	MyStringAnsi fullPath;	//OS path of RAW file
+	VFS_FILE * file;		//file in VFS tree (always set for ARCHIVE, nullptr otherwise)
+
+} VFS_RESOLVED;
+
+/*-----------------------------------------------------------
+Struct:	VFS_LOCATION
+
+Physical location of file data
+-------------------------------------------------------------*/
+typedef struct VFS_LOCATION
+{
+	MyStringAnsi osPath;	//OS file with data (file itself or archive)
+	uint64_t dataOffset;	//offset of data within OS file
+	uint64_t dataSize;		//size of data within OS file (max value for raw files - read until EOF)
+	uint64_t device;		//id of physical device with OS file
+	bool uncompressed;		//data can be read directly by OS
+
+} VFS_LOCATION;
+
 /*-----------------------------------------------------------
 Struct:	VFS_DIR
 
@@ -93,6 +171,8 @@ Class:	VFSTree
 
 FileSystem Tree
 All files withinf VFS are stored in this tree
+Files are allocated in blocks and their names are stored
+in single arena, so there is no allocation per file
 Files from archives are stored as if archive will be
 unarchived
 Eg: VFS/example.zip (file: a.txt, b.txt)
@@ -109,11 +189,13 @@ class VFSTree
 		void Release();
 		
 		//bool AddFile(const MyStringAnsi &filePath);
+		VFS_FILE * NewFile(const char * name);
 		bool AddFile(MyStringAnsi & vfsPath, VFS_FILE * file); 
 		VFS_FILE * GetFile(const MyStringAnsi &path) const;
 		VFS_DIR * GetDir(const MyStringAnsi &path) const;
 		
 		MyStringAnsi GetFilePath(VFS_FILE * f) const;
+		const char * GetFileName(const VFS_FILE * f) const;
 
 		std::vector<VFS_FILE *> GetAllFiles(bool withFilesFromArchives) const;
 
@@ -122,6 +204,9 @@ class VFSTree
 	private:		
 		VFS_DIR * root;
 
+		std::deque<VFS_FILE> files;	//storage of all files (pointers are stable)
+		std::vector<char> names;	//arena of zero terminated file names
+
 		VFS_DIR * AddDir(VFS_DIR * node, const char * dirName);
 		VFS_DIR * GetDir(VFS_DIR * node, const char * dirName) const;
 
@@ -167,12 +252,21 @@ class VFS
 		FILE * GetRawFile(const MyStringAnsi &path) const;
 		
 		char * GetFileContent(const MyStringAnsi &path, size_t * fileSize) const;
+		VFS_VIEW GetFileView(const MyStringAnsi &path) const;
+		size_t GetFileSize(const MyStringAnsi &path) const;
+		bool ReadFileData(const MyStringAnsi &path, void * buffer, size_t bufferSize) const;
+		bool IsFileRandomAccess(const MyStringAnsi &path) const;
+		size_t ReadAt(const MyStringAnsi &path, uint64_t offset, size_t bytesCount, void * buffer) const;
+		bool GetFileLocation(const MyStringAnsi &path, VFS_LOCATION & location) const;
+		uint64_t GetDeviceId(const MyStringAnsi &osPath) const;
 		MyStringAnsi GetFileString(const MyStringAnsi &path) const;
+		VFSStats & GetStats() const;
+		VFS_SOURCE_STATS * GetStatsSource(const MyStringAnsi &path) const;
 		void CloseFile(VFS_FILE * file) const;
 
 		bool CopySingleFile(const MyStringAnsi & src, const MyStringAnsi & dest) const;
 		int CopyAllFilesFromDir(const MyStringAnsi & dirPath, const MyStringAnsi & destPath) const;
-		void PackStructure(const MyStringAnsi & outputFile) const;
+		void PackStructure(const MyStringAnsi & outputFile, VFS_COMPRESSION compression = VFS_COMPRESSION::STORED) const;
 
 		void RefreshFile(const MyStringAnsi &path);
 
@@ -191,6 +285,19 @@ class VFS
 
 		std::vector<MyStringAnsi> archiveFiles; //store all "archive" full OS file paths that are used in VFS
 
+		mutable std::vector<std::shared_ptr<MappedFile>> archiveMappings; //[archive index] = mapped archive (lazy created)
+		mutable std::vector<bool> archiveMappingsFailed; //[archive index] = archive can not be mapped
+		mutable std::mutex archiveMappingsLock;
+
+		mutable std::unordered_map<MyStringAnsi, VFS_RESOLVED> resolved; //[vfs path] = data source
+		mutable std::mutex resolvedLock;
+		bool hasRawDirs;	//raw directories are not scanned, paths are resolved lazily
+
+		mutable std::unordered_map<MyStringAnsi, uint64_t> dirDevices; //[OS dir] = device id
+		mutable std::mutex dirDevicesLock;
+
+		mutable VFSStats stats;	//I/O counters, disabled by default
+
 		
 	
 
@@ -199,6 +306,16 @@ class VFS
 
 		void Release();
 
+		std::shared_ptr<MappedFile> GetArchiveMapping(uint32_t archiveFileIndex) const;
+
+		VFS_RESOLVED Resolve(const MyStringAnsi &path) const;
+		VFS_RESOLVED ResolveUncached(const MyStringAnsi &path) const;
+		void AddResolved(const MyStringAnsi &path, VFS_RESOLVED::SOURCE source, const MyStringAnsi &fullPath, VFS_FILE * file);
+		void InvalidateResolved(const MyStringAnsi &path) const;
+		FILE * OpenRawPath(const MyStringAnsi &fullPath) const;
+		size_t ReadFramesAt(const VFS_FILE * f, uint64_t offset, size_t bytesCount, void * buffer, VFSStatsRecord & rec) const;
+		VFS_SOURCE_STATS * GetStatsSource(const VFS_RESOLVED & r) const;
+
 		void SaveDirStructure(VFS_DIR * d, const MyStringAnsi & dirPath, MyStringAnsi & data) const;
 
 		int CopyAllFilesFromDir(VFS_DIR * d, const MyStringAnsi & destPath) const;
@@ -210,10 +327,12 @@ class VFS
 		void AddDirectory(const MyStringAnsi &dir, const MyStringAnsi &startDirName);
 		
 		void ScanZipArchive(const MyStringAnsi & vfsPath, const MyStringAnsi &fullPath);
-		void ScanPackedFS(const MyStringAnsi & vfsPath, const MyStringAnsi &fullPath);
+		bool GetZipDataOffset(void * zipFile, uint64_t & offset) const;
+		void ScanPackedFS(const MyStringAnsi &fullPath);
 		
 		bool FileInfo(const MyStringAnsi &fileName, VFS_ARCHIVE_TYPE &archiveType, size_t &fileSize) const;
 		void CreateVFSFile(MyStringAnsi & vfsPath, const MyStringAnsi & fullPath);
+		static MyStringAnsi CreateVFSPath(const MyStringAnsi & fullPath, const MyStringAnsi & startDirName);
 		
 
 #ifdef __ANDROID_API__
@@ -0,0 +1,427 @@
+#include "./VFSAsyncReader.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <limits>
+
+#include "./VFS.h"
+
+#ifndef _WIN32
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+#define VFS_ASYNC_MAX_DESCRIPTORS 256	//max number of cached opened files
+
+VFSAsyncReader::VFSAsyncReader(size_t threadsCount, size_t deviceConcurrency) :
+	defaultConcurrency(std::max<size_t>(deviceConcurrency, 1)),
+	submitted(0),
+	unfinished(0),
+	pool(threadsCount)
+{
+}
+
+VFSAsyncReader::~VFSAsyncReader()
+{
+	this->WaitForAll();
+
+#ifndef _WIN32
+	for (auto & it : this->descriptors)
+	{
+		close(it.second);
+	}
+#endif
+}
+
+bool VFSAsyncReader::ReadKey::operator <(const ReadKey & k) const
+{
+	if (this->osPath == k.osPath)
+	{
+		if (this->offset == k.offset)
+		{
+			return this->order < k.order;
+		}
+		return this->offset < k.offset;
+	}
+	return this->osPath < k.osPath;
+}
+
+/*-----------------------------------------------------------
+Function:	SetDeviceConcurrency
+Parameters:
+	[in] osPath - any OS path on device (eg. root dir of VFS)
+	[in] limit - max number of parallel reads from device
+
+Set concurrency of device. Use low values for rotational
+drives (1 - 2) and higher values for SSD
+-------------------------------------------------------------*/
+void VFSAsyncReader::SetDeviceConcurrency(const MyStringAnsi & osPath, size_t limit)
+{
+	MyStringAnsi p = osPath;
+	if (p.GetLastChar() != '/')
+	{
+		p += '/'; //device is detected from file directory
+	}
+	uint64_t device = VFS::GetInstance()->GetDeviceId(p);
+
+	std::lock_guard<std::mutex> lock(this->queueLock);
+	this->GetDeviceQueue(device).maxActive = std::max<size_t>(limit, 1);
+}
+
+/*-----------------------------------------------------------
+Function:	Submit
+Parameters:
+	[in] request - read request
+Returns:
+	future with number of bytes read
+
+Submit single read
+-------------------------------------------------------------*/
+std::future<size_t> VFSAsyncReader::Submit(const VFS_READ_REQUEST & request)
+{
+	std::vector<PendingRead> reads;
+	reads.push_back(this->CreatePendingRead(request));
+
+	std::future<size_t> res = reads.back().result->get_future();
+	this->Enqueue(reads);
+
+	return res;
+}
+
+/*-----------------------------------------------------------
+Function:	Submit
+Parameters:
+	[in] batch - read requests
+Returns:
+	futures with number of bytes read, in the same order as batch
+
+Submit batch of reads. All reads are queued at once,
+so they can be reordered by their physical position
+-------------------------------------------------------------*/
+std::vector<std::future<size_t>> VFSAsyncReader::Submit(const std::vector<VFS_READ_REQUEST> & batch)
+{
+	std::vector<PendingRead> reads;
+	reads.reserve(batch.size());
+
+	std::vector<std::future<size_t>> res;
+	res.reserve(batch.size());
+
+	for (const auto & r : batch)
+	{
+		reads.push_back(this->CreatePendingRead(r));
+		res.push_back(reads.back().result->get_future());
+	}
+
+	this->Enqueue(reads);
+
+	return res;
+}
+
+/*-----------------------------------------------------------
+Function:	Submit
+Parameters:
+	[in] batch - read requests
+	[in] callback - called from worker thread after each read
+
+Submit batch of reads with completion callback.
+Callback can be called from more threads at once
+-------------------------------------------------------------*/
+void VFSAsyncReader::Submit(const std::vector<VFS_READ_REQUEST> & batch, ReadCallback callback)
+{
+	std::vector<PendingRead> reads;
+	reads.reserve(batch.size());
+
+	for (const auto & r : batch)
+	{
+		reads.push_back(this->CreatePendingRead(r));
+		reads.back().result = nullptr;
+		reads.back().callback = callback;
+	}
+
+	this->Enqueue(reads);
+}
+
+/*-----------------------------------------------------------
+Function:	WaitForAll
+
+Block until all submitted reads are finished
+-------------------------------------------------------------*/
+void VFSAsyncReader::WaitForAll()
+{
+	std::unique_lock<std::mutex> lock(this->queueLock);
+	this->finishedCondition.wait(lock, [this]() {
+		return this->unfinished == 0;
+	});
+}
+
+/*-----------------------------------------------------------
+Function:	Read
+Parameters:
+	[in] request - read request
+Returns:
+	number of bytes read
+
+Synchronous read on caller thread (device queues are not used)
+-------------------------------------------------------------*/
+size_t VFSAsyncReader::Read(const VFS_READ_REQUEST & request)
+{
+	VFS_LOCATION location;
+	bool located = VFS::GetInstance()->GetFileLocation(request.path, location);
+
+	return this->ReadLocated(request, location, located);
+}
+
+VFSAsyncReader::PendingRead VFSAsyncReader::CreatePendingRead(const VFS_READ_REQUEST & request)
+{
+	PendingRead pr;
+	pr.request = request;
+	pr.located = VFS::GetInstance()->GetFileLocation(request.path, pr.location);
+	if (pr.located == false)
+	{
+		pr.location.dataOffset = 0;
+		pr.location.device = 0;
+	}
+	pr.result = std::make_shared<std::promise<size_t>>();
+
+	return pr;
+}
+
+VFSAsyncReader::DeviceQueue & VFSAsyncReader::GetDeviceQueue(uint64_t device)
+{
+	auto it = this->devices.find(device);
+	if (it != this->devices.end())
+	{
+		return it->second;
+	}
+
+	DeviceQueue & q = this->devices[device];
+	q.head.offset = 0;
+	q.head.order = 0;
+	q.active = 0;
+	q.maxActive = this->defaultConcurrency;
+
+	return q;
+}
+
+/*-----------------------------------------------------------
+Function:	Enqueue
+Parameters:
+	[in] reads - reads to be queued (content is moved)
+
+Add reads to queues of their devices and start them
+-------------------------------------------------------------*/
+void VFSAsyncReader::Enqueue(std::vector<PendingRead> & reads)
+{
+	std::lock_guard<std::mutex> lock(this->queueLock);
+
+	std::vector<uint64_t> usedDevices;
+
+	for (auto & pr : reads)
+	{
+		ReadKey key;
+		key.osPath = pr.location.osPath;
+		key.offset = pr.location.dataOffset + ((pr.location.uncompressed) ? pr.request.offset : 0);
+		key.order = this->submitted++;
+
+		uint64_t device = pr.location.device;
+		this->GetDeviceQueue(device).pending.emplace(std::move(key), std::move(pr));
+
+		if (std::find(usedDevices.begin(), usedDevices.end(), device) == usedDevices.end())
+		{
+			usedDevices.push_back(device);
+		}
+	}
+
+	this->unfinished += reads.size();
+
+	for (uint64_t d : usedDevices)
+	{
+		this->Dispatch(d);
+	}
+}
+
+/*-----------------------------------------------------------
+Function:	Dispatch
+Parameters:
+	[in] device - device id
+
+Start queued reads of device up to its concurrency limit.
+Reads are taken in one direction from the last position
+(C-SCAN), when the end is reached, they continue from the start.
+Must be called with queueLock locked
+-------------------------------------------------------------*/
+void VFSAsyncReader::Dispatch(uint64_t device)
+{
+	DeviceQueue & q = this->GetDeviceQueue(device);
+
+	while ((q.active < q.maxActive) && (q.pending.empty() == false))
+	{
+		auto it = q.pending.lower_bound(q.head);
+		if (it == q.pending.end())
+		{
+			it = q.pending.begin();
+		}
+
+		q.head = it->first;
+		PendingRead pr = std::move(it->second);
+		q.pending.erase(it);
+
+		q.active++;
+
+		this->pool.AddTask([this, device, pr]() {
+			//read must be finished even if callback throws,
+			//otherwise WaitForAll would block forever
+			try
+			{
+				size_t read = this->ReadLocated(pr.request, pr.location, pr.located);
+
+				if (pr.callback)
+				{
+					pr.callback(pr.request, read);
+				}
+				if (pr.result)
+				{
+					pr.result->set_value(read);
+				}
+			}
+			catch (...)
+			{
+				if (pr.result)
+				{
+					pr.result->set_exception(std::current_exception());
+				}
+				else
+				{
+					printf("[VFS Error] Read of %s failed in callback\n", pr.request.path.c_str());
+				}
+			}
+
+			this->Finish(device);
+		});
+	}
+}
+
+void VFSAsyncReader::Finish(uint64_t device)
+{
+	{
+		std::lock_guard<std::mutex> lock(this->queueLock);
+
+		this->GetDeviceQueue(device).active--;
+		this->unfinished--;
+
+		this->Dispatch(device);
+	}
+
+	this->finishedCondition.notify_all();
+}
+
+/*-----------------------------------------------------------
+Function:	ReadLocated
+Parameters:
+	[in] request - read request
+	[in] location - location of file data
+	[in] located - location is valid
+Returns:
+	number of bytes read
+
+Uncompressed data are read with pread, so opened
+descriptors can be shared between threads
+-------------------------------------------------------------*/
+size_t VFSAsyncReader::ReadLocated(const VFS_READ_REQUEST & request, const VFS_LOCATION & location, bool located)
+{
+	if (located == false)
+	{
+		return 0;
+	}
+
+#ifndef _WIN32
+	if (location.uncompressed)
+	{
+		if (request.offset >= location.dataSize)
+		{
+			return 0;
+		}
+
+		size_t toRead = static_cast<size_t>(std::min<uint64_t>(request.size, location.dataSize - request.offset));
+
+		VFSStatsRecord rec(VFS::GetInstance()->GetStats(), "AsyncRead", request.path, request.offset);
+		if (rec.IsActive())
+		{
+			rec.SetSource(VFS::GetInstance()->GetStatsSource(request.path));
+		}
+
+		bool cached = false;
+		int fd = this->AcquireDescriptor(location.osPath, cached);
+		if (fd < 0)
+		{
+			return 0;
+		}
+
+		uint8_t * dst = static_cast<uint8_t *>(request.buffer);
+		size_t read = 0;
+		while (read < toRead)
+		{
+			ssize_t res = pread(fd, dst + read, toRead - read, static_cast<off_t>(location.dataOffset + request.offset + read));
+			if (res <= 0)
+			{
+				break;
+			}
+			read += static_cast<size_t>(res);
+		}
+
+		if (cached == false)
+		{
+			close(fd);
+		}
+
+		return rec.Finish(read, read);
+	}
+#endif
+
+	return VFS::GetInstance()->ReadAt(request.path, request.offset, request.size, request.buffer);
+}
+
+/*-----------------------------------------------------------
+Function:	AcquireDescriptor
+Parameters:
+	[in] osPath - OS path of file
+	[out] cached - true if descriptor is cached and must not be closed
+Returns:
+	opened descriptor or -1
+
+Get opened descriptor of file. Only limited number of
+descriptors is kept opened, other files are opened
+for single read only
+-------------------------------------------------------------*/
+int VFSAsyncReader::AcquireDescriptor(const MyStringAnsi & osPath, bool & cached)
+{
+#ifdef _WIN32
+	cached = false;
+	return -1;
+#else
+	std::lock_guard<std::mutex> lock(this->descriptorsLock);
+
+	auto it = this->descriptors.find(osPath);
+	if (it != this->descriptors.end())
+	{
+		cached = true;
+		return it->second;
+	}
+
+	int fd = open(osPath.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		printf("[VFS Error] Failed to open %s\n", osPath.c_str());
+		cached = false;
+		return -1;
+	}
+
+	cached = (this->descriptors.size() < VFS_ASYNC_MAX_DESCRIPTORS);
+	if (cached)
+	{
+		this->descriptors[osPath] = fd;
+	}
+
+	return fd;
+#endif
+}
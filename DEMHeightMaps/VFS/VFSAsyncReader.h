@@ -0,0 +1,121 @@
+#ifndef VFS_ASYNC_READER_H
+#define VFS_ASYNC_READER_H
+
+#include <cstdint>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+
+#include "./VFS.h"
+#include "../Strings/MyString.h"
+#include "../Utils/ThreadPool.h"
+
+#define VFS_ASYNC_DEVICE_CONCURRENCY 4	//default max number of parallel reads from single device
+
+/*-----------------------------------------------------------
+Struct:	VFS_READ_REQUEST
+
+Single read of part of VFS file
+-------------------------------------------------------------*/
+typedef struct VFS_READ_REQUEST
+{
+	MyStringAnsi path;	//file path within VFS
+	uint64_t offset;	//offset within uncompressed file
+	size_t size;		//number of bytes to read
+	void * buffer;		//output buffer (at least size bytes), must be valid
+						//until read is finished
+
+} VFS_READ_REQUEST;
+
+/*-----------------------------------------------------------
+Class:	VFSAsyncReader
+
+Asynchronous reads from VFS. Requests are submitted in batches
+and executed on own thread pool, so many reads can be in flight
+at once. Uncompressed data (OS files, STORED archive files)
+are read with pread from cached descriptors, other files
+are read via VFS::ReadAt (only needed frames are decompressed
+for DEFLATE_FRAMES files)
+
+Each physical device (drive) has its own queue with limited
+number of parallel reads, so all devices are busy, but none of
+them is overloaded. Queued reads are dispatched in order of
+their physical position (elevator over OS file and offset)
+-------------------------------------------------------------*/
+class VFSAsyncReader
+{
+	public:
+		typedef std::function<void(const VFS_READ_REQUEST & request, size_t bytesRead)> ReadCallback;
+
+		VFSAsyncReader(size_t threadsCount = 0, size_t deviceConcurrency = VFS_ASYNC_DEVICE_CONCURRENCY);
+		~VFSAsyncReader();
+
+		void SetDeviceConcurrency(const MyStringAnsi & osPath, size_t limit);
+
+		std::future<size_t> Submit(const VFS_READ_REQUEST & request);
+		std::vector<std::future<size_t>> Submit(const std::vector<VFS_READ_REQUEST> & batch);
+		void Submit(const std::vector<VFS_READ_REQUEST> & batch, ReadCallback callback);
+
+		void WaitForAll();
+
+		size_t Read(const VFS_READ_REQUEST & request);
+
+	private:
+		typedef struct PendingRead
+		{
+			VFS_READ_REQUEST request;
+			VFS_LOCATION location;
+			bool located;
+			std::shared_ptr<std::promise<size_t>> result;
+			ReadCallback callback;
+
+		} PendingRead;
+
+		typedef struct ReadKey
+		{
+			MyStringAnsi osPath;
+			uint64_t offset;	//physical offset within OS file
+			uint64_t order;		//submission order for reads at the same position
+
+			bool operator <(const ReadKey & k) const;
+
+		} ReadKey;
+
+		typedef struct DeviceQueue
+		{
+			std::map<ReadKey, PendingRead> pending;	//sorted by physical position
+			ReadKey head;							//position of last dispatched read
+			size_t active;
+			size_t maxActive;
+
+		} DeviceQueue;
+
+		std::unordered_map<uint64_t, DeviceQueue> devices; //[device id] = queue
+		size_t defaultConcurrency;
+		uint64_t submitted;
+		size_t unfinished;
+		std::mutex queueLock;
+		std::condition_variable finishedCondition;
+
+		std::unordered_map<MyStringAnsi, int> descriptors;	//[OS path] = opened file
+		std::mutex descriptorsLock;
+
+		ThreadPool pool;	//must be destroyed first - running reads use members
+
+		void Enqueue(std::vector<PendingRead> & reads);
+		DeviceQueue & GetDeviceQueue(uint64_t device);
+		void Dispatch(uint64_t device);
+		void Finish(uint64_t device);
+
+		PendingRead CreatePendingRead(const VFS_READ_REQUEST & request);
+		size_t ReadLocated(const VFS_READ_REQUEST & request, const VFS_LOCATION & location, bool located);
+
+		int AcquireDescriptor(const MyStringAnsi & osPath, bool & cached);
+};
+
+#endif
@@ -0,0 +1,376 @@
+#include "./VFSStats.h"
+
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <cinttypes>
+
+#include "./VFS.h"
+
+VFSStats::VFSStats() :
+	enabled(false),
+	trace(nullptr),
+	startTimeUs(GetTimeUs())
+{
+}
+
+VFSStats::~VFSStats()
+{
+	if (this->trace)
+	{
+		fclose(this->trace);
+	}
+}
+
+void VFSStats::SetEnabled(bool val)
+{
+	this->enabled = val;
+}
+
+bool VFSStats::IsEnabled() const
+{
+	return this->enabled;
+}
+
+uint64_t VFSStats::GetTimeUs()
+{
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+/*-----------------------------------------------------------
+Function:	SetTraceFile
+Parameters:
+	[in] fileName - OS path of trace log, empty to stop tracing
+Returns:
+	true if trace log was opened
+
+Write each request to trace log (CSV, one request per line).
+Tracing is active only if statistics are enabled
+-------------------------------------------------------------*/
+bool VFSStats::SetTraceFile(const MyStringAnsi & fileName)
+{
+	std::lock_guard<std::mutex> lock(this->traceLock);
+
+	if (this->trace)
+	{
+		fclose(this->trace);
+		this->trace = nullptr;
+	}
+
+	if (fileName.length() == 0)
+	{
+		return true;
+	}
+
+	FILE * f = nullptr;
+	my_fopen(&f, fileName.c_str(), "w");
+	if (f == nullptr)
+	{
+		printf("[VFS Error] Failed to open trace file %s\n", fileName.c_str());
+		return false;
+	}
+
+	fprintf(f, "time_us;op;source;path;offset;stored_bytes;bytes;read_us;decompress_us\n");
+	this->trace = f;
+
+	return true;
+}
+
+/*-----------------------------------------------------------
+Function:	GetSource
+Parameters:
+	[in] name - archive OS path or root directory
+Returns:
+	counters of source (created if not exist)
+
+Returned pointer is valid until VFSStats is destroyed
+-------------------------------------------------------------*/
+VFS_SOURCE_STATS * VFSStats::GetSource(const MyStringAnsi & name)
+{
+	std::lock_guard<std::mutex> lock(this->sourcesLock);
+
+	std::unique_ptr<VFS_SOURCE_STATS> & s = this->sources[name];
+	if (s == nullptr)
+	{
+		s = std::unique_ptr<VFS_SOURCE_STATS>(new VFS_SOURCE_STATS());
+		s->name = name;
+		s->opens = 0;
+		s->reads = 0;
+		s->storedBytes = 0;
+		s->bytes = 0;
+		s->readTimeUs = 0;
+		s->decompressTimeUs = 0;
+		for (auto & l : s->latency)
+		{
+			l = 0;
+		}
+	}
+
+	return s.get();
+}
+
+void VFSStats::RecordOpen(VFS_SOURCE_STATS * s)
+{
+	if ((this->enabled == false) || (s == nullptr))
+	{
+		return;
+	}
+
+	s->opens++;
+}
+
+/*-----------------------------------------------------------
+Function:	RecordRead
+Parameters:
+	[in] s - source counters
+	[in] op - name of VFS operation
+	[in] path - file path within VFS
+	[in] offset - offset within file
+	[in] storedBytes - bytes read from OS file
+	[in] bytes - bytes returned to caller
+	[in] readTimeUs - duration of read (including decompression)
+	[in] decompressTimeUs - duration of decompression
+
+Update counters and write request to trace log
+-------------------------------------------------------------*/
+void VFSStats::RecordRead(VFS_SOURCE_STATS * s, const char * op, const MyStringAnsi & path, uint64_t offset,
+	uint64_t storedBytes, uint64_t bytes, uint64_t readTimeUs, uint64_t decompressTimeUs)
+{
+	if ((this->enabled == false) || (s == nullptr))
+	{
+		return;
+	}
+
+	s->reads++;
+	s->storedBytes += storedBytes;
+	s->bytes += bytes;
+	s->readTimeUs += readTimeUs;
+	s->decompressTimeUs += decompressTimeUs;
+	s->latency[GetLatencyBucket(readTimeUs)]++;
+
+	std::lock_guard<std::mutex> lock(this->traceLock);
+	if (this->trace)
+	{
+		fprintf(this->trace, "%" PRIu64 ";%s;%s;%s;%" PRIu64 ";%" PRIu64 ";%" PRIu64 ";%" PRIu64 ";%" PRIu64 "\n",
+			GetTimeUs() - this->startTimeUs, op, s->name.c_str(), path.c_str(),
+			offset, storedBytes, bytes, readTimeUs, decompressTimeUs);
+	}
+}
+
+/*-----------------------------------------------------------
+Function:	Reset
+
+Clear all counters (sources are kept, so pointers obtained
+by GetSource stay valid)
+-------------------------------------------------------------*/
+void VFSStats::Reset()
+{
+	std::lock_guard<std::mutex> lock(this->sourcesLock);
+
+	for (auto & it : this->sources)
+	{
+		VFS_SOURCE_STATS * s = it.second.get();
+		s->opens = 0;
+		s->reads = 0;
+		s->storedBytes = 0;
+		s->bytes = 0;
+		s->readTimeUs = 0;
+		s->decompressTimeUs = 0;
+		for (auto & l : s->latency)
+		{
+			l = 0;
+		}
+	}
+
+	this->startTimeUs = GetTimeUs();
+}
+
+int VFSStats::GetLatencyBucket(uint64_t us)
+{
+	int bucket = 0;
+	while ((us > 0) && (bucket < VFS_STATS_LATENCY_BUCKETS - 1))
+	{
+		us >>= 1;
+		bucket++;
+	}
+	return bucket;
+}
+
+/*-----------------------------------------------------------
+Function:	GetPercentile
+Parameters:
+	[in] histogram - latency histogram
+	[in] count - number of values in histogram
+	[in] p - percentile <0, 1>
+Returns:
+	upper bound of bucket with percentile in us
+-------------------------------------------------------------*/
+uint64_t VFSStats::GetPercentile(const uint64_t * histogram, uint64_t count, double p)
+{
+	uint64_t limit = static_cast<uint64_t>(count * p);
+	uint64_t sum = 0;
+	for (int i = 0; i < VFS_STATS_LATENCY_BUCKETS; i++)
+	{
+		sum += histogram[i];
+		if (sum > limit)
+		{
+			return (i == 0) ? 1 : (static_cast<uint64_t>(1) << i);
+		}
+	}
+	return static_cast<uint64_t>(1) << (VFS_STATS_LATENCY_BUCKETS - 1);
+}
+
+/*-----------------------------------------------------------
+Function:	PrintSummary
+Parameters:
+	[in] f - output (stdout by default)
+
+Print counters of all sources sorted by amount of read data
+and latency histogram of all reads
+-------------------------------------------------------------*/
+void VFSStats::PrintSummary(FILE * f) const
+{
+	std::lock_guard<std::mutex> lock(this->sourcesLock);
+
+	std::vector<const VFS_SOURCE_STATS *> sorted;
+	for (auto & it : this->sources)
+	{
+		if ((it.second->opens > 0) || (it.second->reads > 0))
+		{
+			sorted.push_back(it.second.get());
+		}
+	}
+
+	std::sort(sorted.begin(), sorted.end(), [](const VFS_SOURCE_STATS * a, const VFS_SOURCE_STATS * b) {
+		return a->storedBytes > b->storedBytes;
+	});
+
+	fprintf(f, "===== VFS I/O statistics =====\n");
+	fprintf(f, "%10s %10s %12s %12s %10s %10s %8s %8s  %s\n",
+		"opens", "reads", "stored MB", "raw MB", "read ms", "infl. ms", "p50 us", "p99 us", "source");
+
+	uint64_t total[VFS_STATS_LATENCY_BUCKETS] = { 0 };
+	uint64_t totalReads = 0;
+	uint64_t totalStored = 0;
+	uint64_t totalBytes = 0;
+	uint64_t totalTime = 0;
+
+	for (const VFS_SOURCE_STATS * s : sorted)
+	{
+		uint64_t histogram[VFS_STATS_LATENCY_BUCKETS];
+		for (int i = 0; i < VFS_STATS_LATENCY_BUCKETS; i++)
+		{
+			histogram[i] = s->latency[i];
+			total[i] += histogram[i];
+		}
+
+		uint64_t reads = s->reads;
+		totalReads += reads;
+		totalStored += s->storedBytes;
+		totalBytes += s->bytes;
+		totalTime += s->readTimeUs;
+
+		fprintf(f, "%10" PRIu64 " %10" PRIu64 " %12.2f %12.2f %10.2f %10.2f %8" PRIu64 " %8" PRIu64 "  %s\n",
+			s->opens.load(), reads,
+			s->storedBytes / (1024.0 * 1024.0), s->bytes / (1024.0 * 1024.0),
+			s->readTimeUs / 1000.0, s->decompressTimeUs / 1000.0,
+			GetPercentile(histogram, reads, 0.5), GetPercentile(histogram, reads, 0.99),
+			s->name.c_str());
+	}
+
+	if (totalTime > 0)
+	{
+		fprintf(f, "Total: %" PRIu64 " reads, %.2f MB stored, %.2f MB raw, %.2f MB/s\n",
+			totalReads, totalStored / (1024.0 * 1024.0), totalBytes / (1024.0 * 1024.0),
+			(totalBytes / (1024.0 * 1024.0)) / (totalTime / 1000000.0));
+	}
+
+	fprintf(f, "Read latency histogram:\n");
+	for (int i = 0; i < VFS_STATS_LATENCY_BUCKETS; i++)
+	{
+		if (total[i] == 0)
+		{
+			continue;
+		}
+		uint64_t from = (i == 0) ? 0 : (static_cast<uint64_t>(1) << (i - 1));
+		fprintf(f, "  >= %8" PRIu64 " us: %" PRIu64 "\n", from, total[i]);
+	}
+}
+
+//=============================================================================
+
+VFSStatsRecord::VFSStatsRecord(VFSStats & stats, const char * op, const MyStringAnsi & path, uint64_t offset) :
+	stats(stats.IsEnabled() ? &stats : nullptr),
+	source(nullptr),
+	op(op),
+	path(path),
+	offset(offset),
+	storedBytes(0),
+	bytes(0),
+	startUs(0),
+	decompressStartUs(0),
+	decompressUs(0)
+{
+	if (this->stats)
+	{
+		this->startUs = VFSStats::GetTimeUs();
+	}
+}
+
+VFSStatsRecord::~VFSStatsRecord()
+{
+	if ((this->stats == nullptr) || (this->source == nullptr))
+	{
+		return;
+	}
+
+	this->stats->RecordRead(this->source, this->op, this->path, this->offset,
+		this->storedBytes, this->bytes, VFSStats::GetTimeUs() - this->startUs, this->decompressUs);
+}
+
+bool VFSStatsRecord::IsActive() const
+{
+	return this->stats != nullptr;
+}
+
+void VFSStatsRecord::SetSource(VFS_SOURCE_STATS * s)
+{
+	this->source = s;
+}
+
+void VFSStatsRecord::SetBytes(uint64_t storedBytes, uint64_t bytes)
+{
+	this->storedBytes = storedBytes;
+	this->bytes = bytes;
+}
+
+/*-----------------------------------------------------------
+Function:	Finish
+Parameters:
+	[in] storedBytes - bytes read from OS file
+	[in] bytes - bytes returned to caller
+Returns:
+	bytes (so it can be used in return statement)
+-------------------------------------------------------------*/
+size_t VFSStatsRecord::Finish(uint64_t storedBytes, size_t bytes)
+{
+	this->SetBytes(storedBytes, bytes);
+	return bytes;
+}
+
+void VFSStatsRecord::BeginDecompress()
+{
+	if (this->stats)
+	{
+		this->decompressStartUs = VFSStats::GetTimeUs();
+	}
+}
+
+void VFSStatsRecord::EndDecompress()
+{
+	if (this->stats)
+	{
+		this->decompressUs += VFSStats::GetTimeUs() - this->decompressStartUs;
+	}
+}
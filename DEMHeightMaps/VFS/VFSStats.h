@@ -0,0 +1,114 @@
+#ifndef VFS_STATS_H
+#define VFS_STATS_H
+
+#include <cstdio>
+#include <cstdint>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "../Strings/MyString.h"
+
+#define VFS_STATS_LATENCY_BUCKETS 24	//[0] = < 1us, [i] = <2^(i-1), 2^i) us, last bucket is open
+
+/*-----------------------------------------------------------
+Struct:	VFS_SOURCE_STATS
+
+I/O counters of single data source (archive or root directory)
+All counters can be updated from more threads at once
+-------------------------------------------------------------*/
+typedef struct VFS_SOURCE_STATS
+{
+	MyStringAnsi name;	//archive OS path or root directory
+
+	std::atomic<uint64_t> opens;
+	std::atomic<uint64_t> reads;
+	std::atomic<uint64_t> storedBytes;		//bytes read from OS file (compressed)
+	std::atomic<uint64_t> bytes;			//bytes returned to caller (uncompressed)
+	std::atomic<uint64_t> readTimeUs;		//total time of reads including decompression
+	std::atomic<uint64_t> decompressTimeUs;
+	std::atomic<uint64_t> latency[VFS_STATS_LATENCY_BUCKETS];	//histogram of read latencies
+
+} VFS_SOURCE_STATS;
+
+/*-----------------------------------------------------------
+Class:	VFSStats
+
+VFS I/O instrumentation. Counters are kept per archive
+and per root directory. Optionally, each request can be written
+to trace log (CSV). Statistics are disabled by default
+and disabled statistics cost only single atomic load per request
+-------------------------------------------------------------*/
+class VFSStats
+{
+	public:
+		VFSStats();
+		~VFSStats();
+
+		void SetEnabled(bool val);
+		bool IsEnabled() const;
+
+		bool SetTraceFile(const MyStringAnsi & fileName);
+
+		VFS_SOURCE_STATS * GetSource(const MyStringAnsi & name);
+
+		void RecordOpen(VFS_SOURCE_STATS * s);
+		void RecordRead(VFS_SOURCE_STATS * s, const char * op, const MyStringAnsi & path, uint64_t offset,
+			uint64_t storedBytes, uint64_t bytes, uint64_t readTimeUs, uint64_t decompressTimeUs);
+
+		void Reset();
+		void PrintSummary(FILE * f = stdout) const;
+
+		static uint64_t GetTimeUs();
+
+	private:
+		std::atomic<bool> enabled;
+
+		std::unordered_map<MyStringAnsi, std::unique_ptr<VFS_SOURCE_STATS>> sources; //[name] = counters
+		mutable std::mutex sourcesLock;
+
+		FILE * trace;
+		std::mutex traceLock;
+		uint64_t startTimeUs;
+
+		static int GetLatencyBucket(uint64_t us);
+		static uint64_t GetPercentile(const uint64_t * histogram, uint64_t count, double p);
+};
+
+/*-----------------------------------------------------------
+Class:	VFSStatsRecord
+
+Measurement of single VFS request. Result is recorded
+when record is destroyed. If statistics are disabled,
+nothing is measured
+-------------------------------------------------------------*/
+class VFSStatsRecord
+{
+	public:
+		VFSStatsRecord(VFSStats & stats, const char * op, const MyStringAnsi & path, uint64_t offset = 0);
+		~VFSStatsRecord();
+
+		bool IsActive() const;
+
+		void SetSource(VFS_SOURCE_STATS * s);
+		void SetBytes(uint64_t storedBytes, uint64_t bytes);
+		size_t Finish(uint64_t storedBytes, size_t bytes);
+
+		void BeginDecompress();
+		void EndDecompress();
+
+	private:
+		VFSStats * stats;	//nullptr if statistics are disabled
+		VFS_SOURCE_STATS * source;
+		const char * op;
+		const MyStringAnsi & path;
+		uint64_t offset;
+		uint64_t storedBytes;
+		uint64_t bytes;
+		uint64_t startUs;
+		uint64_t decompressStartUs;
+		uint64_t decompressUs;
+};
+
+#endif
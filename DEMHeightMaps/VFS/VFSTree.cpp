@@ -2,6 +2,7 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <stack>
 
 VFSTree::VFSTree()
@@ -33,6 +34,10 @@ void VFSTree::Release()
 	free((char *)this->root->name);
 	delete this->root;
 	this->root = nullptr;
+
+	this->files.clear();
+	this->names.clear();
+	this->names.shrink_to_fit();
 }
 
 void VFSTree::Release(VFS_DIR * node)
@@ -60,9 +65,46 @@ void VFSTree::ReleaseFile(VFS_FILE * file)
 	{			
 		return;
 	}
-								
-	free((char *)file->name);
-	delete file;	
+
+	//file memory is owned by files storage
+	//and it is released with the entire tree
+	file->dir = nullptr;
+}
+
+/*-----------------------------------------------------------
+Function:	NewFile
+Parameters:	
+	[in] name - file name with extension (eg. Sample.txt)
+Returns:
+	new file, not yet inserted into tree (use AddFile)
+
+Create new file in files storage. Name is copied to names arena
+-------------------------------------------------------------*/
+VFS_FILE * VFSTree::NewFile(const char * name)
+{
+	this->files.emplace_back();
+
+	VFS_FILE * file = &this->files.back();
+	memset(file, 0, sizeof(VFS_FILE));
+
+	file->nameOffset = static_cast<uint32_t>(this->names.size());
+	this->names.insert(this->names.end(), name, name + strlen(name) + 1);
+
+	return file;
+}
+
+/*-----------------------------------------------------------
+Function:	GetFileName
+Parameters:	
+	[in] f - file from tree
+Returns:
+	file name with extension
+
+Returned pointer is valid until new file is created
+-------------------------------------------------------------*/
+const char * VFSTree::GetFileName(const VFS_FILE * f) const
+{
+	return this->names.data() + f->nameOffset;
 }
 
 std::vector<VFS_FILE *> VFSTree::GetAllFiles(bool withFilesFromArchives) const
@@ -157,7 +199,7 @@ void VFSTree::PrintStructure(VFS_DIR * node, int depth) const
 			printf("%s[FILE] <unknown NULL VFS_FILE>\n", zanoreni);
 			continue;
 		}
-		printf("%s[FILE] %s\n", zanoreni, f->name);
+		printf("%s[FILE] %s\n", zanoreni, this->GetFileName(f));
 	}
 
 	delete[] zanoreni;
@@ -167,7 +209,7 @@ MyStringAnsi VFSTree::GetFilePath(VFS_FILE * f) const
 {
 	
 	std::stack<const char *> names;
-	names.push(f->name);
+	names.push(this->GetFileName(f));
 
 	VFS_DIR * d = f->dir;
 	while ((d != nullptr))
@@ -339,7 +381,7 @@ VFS_FILE * VFSTree::GetFile(const MyStringAnsi &path) const
 
 	for (auto f : node->files)
 	{
-		if (strcmp(f->name, fileName) == 0)
+		if (strcmp(this->GetFileName(f), fileName) == 0)
 		{
 			free(pathStr);
 			return f;
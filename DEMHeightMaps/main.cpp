@@ -1,5 +1,6 @@
 
 #include <memory>
+#include <mutex>
 #include <lodepng.h>
 
 #include "./VFS/VFS.h"
@@ -8,6 +9,12 @@
 #include "DEMTile.h"
 #include "DEMData.h"
 #include "BorderRenderer.h"
+#include "TileGenerator.h"
+#include "TilePipeline.h"
+#include "MBTilesWriter.h"
+
+#include "./Benchmarks/VFSBenchmark.h"
+#include "./Benchmarks/BuildMapBenchmark.h"
 
 #include <Projections.h>
 #include <MapProjection.h>
@@ -107,11 +114,34 @@ void CreateBackgroundMaps()
 
 	dd.SetMinMaxElevation(0, 5000);
 	dd.SetElevationMappingEnabled(true);
+	dd.SetSkipEmptyTilesEnabled(true);
 
 	//int zoomLevel = 2;
 
 	//BorderRenderer<Projections::Mercator> br("I://hranice//", dd.GetProjection());
 
+	//completed tiles are recorded, so interrupted run can continue
+	TileManifest manifest("F:/DEM/manifest.txt");
+	if (manifest.Open() == false)
+	{
+		return;
+	}
+
+	TilePipelineSettings pipelineSettings;
+	TilePipeline<uint8_t, Projections::Mercator> pipeline(&dd, pipelineSettings);
+	pipeline.SetVerboseEnabled(true);
+	pipeline.SetManifest(&manifest);
+
+#ifdef USE_SQLITE
+	//all zooms in single MBTiles file, identical tiles are stored once
+	MBTilesWriter mbtiles("F:/DEM/dem.mbtiles");
+	if (mbtiles.Open("dem") == false)
+	{
+		return;
+	}
+	pipeline.SetWriter(&mbtiles);
+#endif
+
 	for (int zoomLevel = 3; zoomLevel <= 9; zoomLevel++)
 	{
 
@@ -124,82 +154,173 @@ void CreateBackgroundMaps()
 		//double stepLat = (MERCATOR_MAX - MERCATOR_MIN) / (std::pow(2.0, zoomLevel));
 		//double stepLon = (180.0 - -180.0) / (std::pow(2.0, zoomLevel));
 
-		auto tiles = dd.BuildTileMap(totalW, totalH,
-			tilesCountX, tilesCountY,
-			{ GeoCoordinate::deg(-180.0), GeoCoordinate::deg(MERCATOR_MIN) },
-			{ GeoCoordinate::deg(180.0), GeoCoordinate::deg(MERCATOR_MAX) });
-		
 		MyStringAnsi zoomPath = "F:/DEM/";
 		zoomPath += zoomLevel;
 		zoomPath += '/';
 
 		OSUtils::Instance()->CreateDir(zoomPath);
 
-		for (auto & tDir : tiles)
+		//sampling, PNG encoding and writing run in parallel stages
+#ifdef USE_SQLITE
+		pipeline.Run(totalW, totalH,
+			tilesCountX, tilesCountY,
+			{ GeoCoordinate::deg(-180.0), GeoCoordinate::deg(MERCATOR_MIN) },
+			{ GeoCoordinate::deg(180.0), GeoCoordinate::deg(MERCATOR_MAX) },
+			zoomLevel);
+#else
+		pipeline.Run(totalW, totalH,
+			tilesCountX, tilesCountY,
+			{ GeoCoordinate::deg(-180.0), GeoCoordinate::deg(MERCATOR_MIN) },
+			{ GeoCoordinate::deg(180.0), GeoCoordinate::deg(MERCATOR_MAX) },
+			zoomPath, zoomLevel);
+#endif
+	}
+}
+
+/// <summary>
+/// Same output as CreateBackgroundMaps, but only the deepest zoom
+/// is built from DEM, upper zooms are downsampled from it
+/// </summary>
+void CreateBackgroundMapsPyramid()
+{
+	DEMData<uint8_t, Projections::Mercator> dd({ "E://DEM_Voidfill//", "E://DEM_srtm//" });
+	
+	dd.SetVerboseEnabled(false);
+
+	printf("Data inited\n");
+
+	dd.SetMinMaxElevation(0, 5000);
+	dd.SetElevationMappingEnabled(true);
+
+	TileGeneratorSettings settings;
+	settings.minZoom = 3;
+	settings.maxZoom = 9;
+	settings.tileSize = 512;
+	settings.min = { GeoCoordinate::deg(-180.0), GeoCoordinate::deg(MERCATOR_MIN) };
+	settings.max = { GeoCoordinate::deg(180.0), GeoCoordinate::deg(MERCATOR_MAX) };
+
+	TileGenerator<uint8_t, Projections::Mercator> generator(&dd, settings);
+	generator.SetVerboseEnabled(true);
+
+	PNGEncoder png;
+	DirectoryTileWriter writer("F:/DEM/");
+
+	generator.Generate([&](int z, int x, int y, int w, int h, const uint8_t * data) {
+		std::vector<uint8_t> file;
+		if (png.EncodeGrey8(w, h, data, file))
 		{
-			//int x = tiles.size() - tDir.first - 1;
-			int x = tDir.first;
+			writer.Write(z, x, y, file);
+		}
+	});
+}
 
-			MyStringAnsi outPath = zoomPath;
-			outPath += x;
-			outPath += '/';
+/// <summary>
+/// Pyramid with heights in meters (no elevation mapping),
+/// encoded as Terrain-RGB or 16-bit greyscale PNG
+/// </summary>
+/// <param name="outputDir">output directory</param>
+/// <param name="encoding">tile encoding</param>
+void CreateElevationMapsPyramid(const MyStringAnsi & outputDir, TILE_ENCODING encoding)
+{
+	DEMData<short, Projections::Mercator> dd({ "E://DEM_Voidfill//", "E://DEM_srtm//" });
 
-			OSUtils::Instance()->CreateDir(outPath);
+	dd.SetVerboseEnabled(false);
 
+	printf("Data inited\n");
 
-			for (auto & tFiles : tDir.second)
-			{
-				auto & t = tFiles.second;
-				uint8_t * data = dd.BuildMap(t.width, t.height, t.GetCorner(0), t.GetCorner(3), false);
-
-				if (data == nullptr)
-				{
-					//empty - all is water probably
-					continue;
-				}
-
-				//br.SetData(t.width, t.height, data);
-				//br.DrawBorders(t.GetCorner(0), t.GetCorner(3), false);
-
-				//y is swapped
-				int y = tFiles.first;//
-				//int y = tDir.second.size() - tFiles.first - 1;
-
-				MyStringAnsi filePath = outPath;
-				filePath += y;
-				filePath += ".png";
-
-				uint32_t error = lodepng::encode(filePath.c_str(), data, t.width, t.height, LodePNGColorType::LCT_GREY, 8);
-
-				/*
-				MyStringAnsi ss = "D://T//DEM//";
-
-				ss += "tile_";
-				ss += int(t.minLat.deg() * 10) / 10.0;
-				ss += "_";
-				ss += int(t.minLon.deg() * 10) / 10.0;
-				ss += "_";
-				ss += int(t.GetCorner(3).lat.deg() * 10) / 10.0;
-				ss += "_";
-				ss += int(t.GetCorner(3).lon.deg() * 10) / 10.0;
-				*/
-
-				/*
-				MyStringAnsi ss = "D://T//DEM//";
-				ss += "tile_";
-				ss += tDir.first;
-				ss += "_";
-				ss += tFiles.first;
-				ss += ".png";
-				uint32_t error = lodepng::encode(ss.c_str(), data, t.width, t.height, LodePNGColorType::LCT_GREY, 8);
-				*/
-
-				SAFE_DELETE_ARRAY(data);
-			}
+	dd.SetElevationMappingEnabled(false);
+
+	TileGeneratorSettings settings;
+	settings.minZoom = 3;
+	settings.maxZoom = 9;
+	settings.tileSize = 512;
+	settings.min = { GeoCoordinate::deg(-180.0), GeoCoordinate::deg(MERCATOR_MIN) };
+	settings.max = { GeoCoordinate::deg(180.0), GeoCoordinate::deg(MERCATOR_MAX) };
+
+	TileGenerator<short, Projections::Mercator> generator(&dd, settings);
+	generator.SetVerboseEnabled(true);
+
+	PNGEncoder png;
+	DirectoryTileWriter writer(outputDir);
+
+	generator.Generate([&](int z, int x, int y, int w, int h, const short * data) {
+		std::vector<uint8_t> file;
+
+		bool ok = (encoding == TILE_ENCODING::TERRAIN_RGB) ?
+			png.EncodeTerrainRGB(w, h, data, file) :
+			png.EncodeGrey16(w, h, data, file);
+
+		if (ok)
+		{
+			writer.Write(z, x, y, file);
 		}
+	});
+}
+
+
+void RunVFSBenchmark(const MyStringAnsi & workDir)
+{
+	VFSBenchmarkSettings settings;
+	settings.workDir = workDir;
+
+	VFSBenchmark benchmark(settings);
+	auto results = benchmark.Run();
+
+	MyStringAnsi csvFile = workDir;
+	csvFile += "vfs_benchmark.csv";
+
+	MyStringAnsi jsonFile = workDir;
+	jsonFile += "vfs_benchmark.json";
+
+	VFSBenchmark::PrintResults(results);
+	VFSBenchmark::SaveCSV(results, csvFile);
+	VFSBenchmark::SaveJSON(results, jsonFile);
+}
+
+void RunBuildMapBenchmark(const MyStringAnsi & workDir, const MyStringAnsi & baselineFile)
+{
+	BuildMapBenchmarkSettings settings;
+	settings.workDir = workDir;
+
+	BuildMapBenchmark benchmark(settings);
+	auto results = benchmark.Run();
+
+	BuildMapBenchmark::PrintResults(results);
+
+	MyStringAnsi csvFile = workDir;
+	csvFile += "build_map_benchmark.csv";
+	BuildMapBenchmark::SaveCSV(results, csvFile);
+
+	auto baseline = BuildMapBenchmark::LoadCSV(baselineFile);
+	if (baseline.empty() == false)
+	{
+		BuildMapBenchmark::CompareBaseline(results, baseline);
 	}
 }
 
+/// <summary>
+/// Compare DEM tile loads of all tile orders for zoom levels
+/// of CreateBackgroundMaps (diagnostics only, no tiles are built)
+/// </summary>
+void RunTileOrderStats()
+{
+	DEMData<uint8_t, Projections::Mercator> dd({ "E://DEM_Voidfill//", "E://DEM_srtm//" });
+
+	for (int zoomLevel = 3; zoomLevel <= 9; zoomLevel++)
+	{
+		int tilesCountX = std::pow(2, zoomLevel);
+		int tilesCountY = std::pow(2, zoomLevel);
+
+		printf("Zoom %d\n", zoomLevel);
+
+		//16GB tiles cache holds ~650 SRTM1 tiles
+		dd.PrintTileOrderStats(512 * tilesCountX, 512 * tilesCountY,
+			tilesCountX, tilesCountY,
+			{ GeoCoordinate::deg(-180.0), GeoCoordinate::deg(MERCATOR_MIN) },
+			{ GeoCoordinate::deg(180.0), GeoCoordinate::deg(MERCATOR_MAX) },
+			650);
+	}
+}
 
 
 static std::string * uint16_tToString = new std::string[10000];
@@ -244,7 +365,18 @@ int main(int argc, char * argv[])
 
 	OSUtils::Init(info);
 	
-	CreateBackgroundMaps();
+	//RunVFSBenchmark("D://vfs_benchmark//");
+	//return 0;
+
+	//RunBuildMapBenchmark("D://build_map_benchmark//", "D://build_map_benchmark_baseline.csv");
+	//return 0;
+
+	//RunTileOrderStats();
+	//return 0;
+
+	//CreateBackgroundMaps();
+	CreateBackgroundMapsPyramid();
+	//CreateElevationMapsPyramid("F:/DEM_terrain_rgb/", TILE_ENCODING::TERRAIN_RGB);
 
 	return 0;
 
@@ -293,6 +425,9 @@ int main(int argc, char * argv[])
 
 	//dd.SetMinMaxElevation(0, 9000);
 
+	//most of the globe is sea, tiles without DEM are not processed
+	dd.SetSkipEmptyTilesEnabled(true);
+
 	//VFS::GetInstance()->ExportStructure("d://vfs.txt");
 
 	//dd.ExportTileList("D://tile_list.xml");
@@ -333,11 +468,14 @@ int main(int argc, char * argv[])
 	double stepLon = 0.0025 * 64;// (180.0 - -180.0) / (std::pow(2.0, zoomLevel));
 
 	
-	dd.ProcessTileMap(64, 64,
+	//tiles are built in parallel, single DB connection is shared
+	std::mutex psqlLock;
+
+	dd.ProcessTileMapParallel(64, 64,
 	{ GeoCoordinate::deg(-180.0), GeoCoordinate::deg(-90.0) },
 	{ GeoCoordinate::deg(180.0), GeoCoordinate::deg(90.0) },
 	{ GeoCoordinate::deg(stepLon), GeoCoordinate::deg(stepLat)},
-		[&](TileInfo & t, size_t x, size_t y) {
+		[&](TileInfo & t, size_t x, size_t y, DEMRequestContext<Projections::Equirectangular> & ctx) {
 
 		double latDeg = t.GetCorner(0).lat.deg();
 		double lonDeg = t.GetCorner(0).lon.deg();
@@ -351,7 +489,7 @@ int main(int argc, char * argv[])
 			printf("Lon: %f Lat: %f\n", lonDeg, latDeg);
 		}
 
-		uint16_t * data = dd.BuildMap(t.width, t.height, t.GetCorner(0), t.GetCorner(3), false);
+		uint16_t * data = dd.BuildMap(ctx, t.width, t.height, t.GetCorner(0), t.GetCorner(3), false);
 		//uint16_t * data = new uint16_t[t.width * t.height];
 		//memset(data, 0, t.width * t.height * sizeof(uint16_t));
 
@@ -394,10 +532,14 @@ int main(int argc, char * argv[])
 			") "
 			")";
 
-			psql.RunQuery(q);
+			{
+				std::lock_guard<std::mutex> lock(psqlLock);
+				psql.RunQuery(q);
+			}
 
 			SAFE_DELETE_ARRAY(data);
-		}
+		},
+		TILE_ORDER::HILBERT
 	);
 
 	delete[] uint16_tToString;